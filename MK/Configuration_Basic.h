@@ -76,9 +76,15 @@
 
 // Some particular clients re-start sending commands only after receiving a 'wait' when there is a bad serial-connection.
 //#define NO_TIMEOUTS 1000 // Milliseconds
-// Uncomment to include more info in ok command
+// Uncomment to include more info in ok command: the line number, the free planner blocks (P)
+// and the free command buffer slots (B). The host can turn it off and on with M124 S0/S1.
 //#define ADVANCED_OK
 
+// Catch M108, M112 and M410 in the serial interrupt as soon as they are received,
+// even when the command buffer is full or a long command is running.
+// They are still queued as usual. Not available with EXTERNALSERIAL.
+//#define EMERGENCY_PARSER
+
 //
 // Host Keepalive
 //
@@ -86,6 +92,14 @@
 // every couple of seconds when it can't accept commands.
 #define HOST_KEEPALIVE_FEATURE        // Disable this if your host doesn't like keepalive messages
 #define DEFAULT_KEEPALIVE_INTERVAL 2  // Number of seconds between "busy" messages. Set with M113.
+
+//
+// Auto Report
+//
+// The host can ask for the temperatures (M155 S<seconds>) and the position (M154 S<seconds>)
+// to be sent at regular intervals, instead of polling them with M105 and M114.
+#define AUTO_REPORT_TEMPERATURES
+#define AUTO_REPORT_POSITION
 /***********************************************************************/
 
 
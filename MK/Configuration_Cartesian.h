@@ -513,6 +513,8 @@
  * Hysteresis:                                                                           *
  * These are the extra distances that are performed when an axis changes direction       *
  * to compensate for any mechanical hysteresis your printer has.                         *
+ * The extra steps go out with the move that reverses the axis, spread over the          *
+ * first HYSTERESIS_SMOOTHING_MM of its travel, so no extra move slows the print down.   *
  * Set the parameters width M99 X<in mm> Y<in mm> Z<in mm> E<in mm>                      *
  *                                                                                       *
  * ZWobble:                                                                              *
@@ -533,6 +535,7 @@
 //define ZWOBBLE
 
 #define DEFAULT_HYSTERESIS_MM   0, 0, 0, 0  // X, Y, Z, E hysteresis in mm.
+#define HYSTERESIS_SMOOTHING_MM 2           // Axis travel in mm over which the hysteresis is taken up.
 #define DEFAULT_ZWOBBLE         0, 0, 0     // A, W, P
 /*****************************************************************************************/
 
@@ -36,6 +36,7 @@
  * - Multiextruder new MKR6
  * - Multiextruder NPr2
  * - Multiextruder DONDOLO
+ * - Tool change preheat
  * - Extruder idle oozing prevention
  * - Extruder run-out prevention
  * - Bowden Filament management
@@ -77,6 +78,7 @@
  * - Stepper auto deactivation
  * - Low speed stepper
  * - High speed stepper
+ * - Input shaping
  * - Microstepping
  * - Motor's current
  * - I2C DIGIPOT
@@ -87,6 +89,7 @@
  * - Buffer stuff
  * - G20/G21 Inch mode support
  * - Report JSON-style response
+ * - Idle task scheduler
  * - Whatchdog
  * - Start / Stop Gcode
  *
@@ -219,6 +222,12 @@
 
 // Use the Virtual Tool method with M163 and M164
 #define MIXING_VIRTUAL_TOOLS 16
+
+// Gradient programs with M166, the mix goes from one virtual tool
+// to another over a Z range or over the filament fed.
+// The mix is computed for each move, with no extra G-code.
+//#define MIXING_GRADIENT
+#define MIXING_GRADIENTS 4 // Number of gradient programs stored
 /***********************************************************************/
 
 
@@ -302,6 +311,45 @@
 /***********************************************************************/
 
 
+/***********************************************************************
+ ************************ Tool change preheat **************************
+ ***********************************************************************
+ *                                                                     *
+ * Look ahead in the command buffer and, when printing from SD, in     *
+ * the file for the next T commands, so the next hotend is brought     *
+ * back to its print temperature TOOL_PREHEAT_TIME seconds before it   *
+ * is selected, instead of stalling the print on its M109.             *
+ * After a tool change the previous hotend is lowered by               *
+ * TOOL_STANDBY_DROP degrees, unless it is needed again soon.          *
+ * The time is estimated from the length and feedrate of the moves.    *
+ *                                                                     *
+ * Uncomment TOOL_CHANGE_PREHEAT to enable this feature                *
+ *                                                                     *
+ ***********************************************************************/
+//#define TOOL_CHANGE_PREHEAT
+#define TOOL_PREHEAT_TIME 30  // (s) Time to heat a hotend from standby to print temperature
+#define TOOL_STANDBY_DROP 50  // (degC) Lower the idle hotends by this, 0 to leave them hot
+/***********************************************************************/
+
+
+/***********************************************************************
+ ************************ Planned tool offset **************************
+ ***********************************************************************
+ *                                                                     *
+ * Apply the hotend offset of a T command in the planner, without      *
+ * waiting for the moves in flight to finish. The stepper positions    *
+ * follow when the first move of the new tool starts, so the print     *
+ * keeps its speed through the tool change.                            *
+ * The moves are still drained for DUAL X CARRIAGE, DONDOLO and        *
+ * EXT SOLENOID, that need the old tool stopped.                       *
+ *                                                                     *
+ * Uncomment PLANNED_TOOL_OFFSET to enable this feature                *
+ *                                                                     *
+ ***********************************************************************/
+//#define PLANNED_TOOL_OFFSET
+/***********************************************************************/
+
+
 /***********************************************************************
  **************** Extruder idle oozing prevention **********************
  ***********************************************************************
@@ -404,6 +452,21 @@
 /*****************************************************************************************/
 
 
+/*****************************************************************************************
+ ******************************* Advance E step spacing **********************************
+ *****************************************************************************************
+ *                                                                                       *
+ * With ADVANCE or ADVANCE_LPC the extruder interrupt spreads the pending E steps        *
+ * evenly over each stepper interval, one step per interrupt.                            *
+ * ADVANCE_E_MIN_INTERVAL is the shortest time between two E steps in timer 0 ticks (4us)*
+ * Steps that don't fit are deferred to the next interval and counted (see M905).        *
+ * Raise it if the extruder driver loses steps with high advance factors.                *
+ *                                                                                       *
+ *****************************************************************************************/
+#define ADVANCE_E_MIN_INTERVAL 8
+/*****************************************************************************************/
+
+
 /**************************************************************************
  *************************** Filament exchange ****************************
  **************************************************************************
@@ -661,6 +724,9 @@
 //    Mode 2: Duplication mode. The firmware will transparently make the second x-carriage and extruder copy all
 //                           actions of the first x-carriage. This allows the printer to print 2 arbitrary items at
 //                           once. (2nd extruder x offset and temp offset are set using: M605 S2 [Xnnn] [Rmmm])
+//    Mode 3: Mirrored mode. Like duplication, but the second x-carriage moves opposite to the first, mirrored
+//                           about a line at X=nnn, to print a part and its mirror image at once. The moves
+//                           are limited to keep the carriages apart and the second one in its travel. (M605 S3 [Xnnn] [Rmmm])
 
 // This is the default power-up mode which can be later using M605.
 #define DEFAULT_DUAL_X_CARRIAGE_MODE 0
@@ -940,10 +1006,33 @@
 // using:
 //#define MENU_ADDAUTOSTART
 
+// Keep an index of the working directory to browse big folders quickly on the LCD.
+// Folders with more files than SD_DIR_INDEX_SIZE are indexed every few files and are not sorted.
+//#define SD_DIR_INDEX
+#define SD_DIR_INDEX_SIZE 64              // Files in the index, 2 bytes each (6 bytes each when sorted)
+//#define SD_DIR_INDEX_SORT_NAME          // Sort by name, folders first
+//#define SD_DIR_INDEX_SORT_DATE          // Sort by date, folders first
+
+// Keep the G-code metadata of the selected files (slicer, heights, filament, layers, print time)
+// in a small index file in each folder, so every file is parsed only once. Needs JSON_OUTPUT.
+// On the LCD, a file already parsed shows its metadata before the print starts.
+//#define SD_METADATA_CACHE
+#define SD_METADATA_FILE "GCODEMET.IDX"
+
+// Index the layers of the G-code files in <name>.LIX, while printing them the first time
+// or on demand, to start a print from a layer or height with M34 L<layer> or M34 Z<height>.
+//#define SD_LAYER_INDEX
+
 // This enable the firmware to write some configuration that require frequent update, on the SD card
 //#define SD_SETTINGS                     // Uncomment to enable
 #define SD_CFG_SECONDS        300         // seconds between update
 #define CFG_SD_FILE           "INFO.CFG"  // name of the configuration file
+
+// This enable a binary journal on the SD card, written while printing from SD,
+// so a print interrupted by a power cut can be resumed with M413 R
+//#define POWER_LOSS_RECOVERY             // Uncomment to enable
+#define POWER_LOSS_JOURNAL_SECONDS  10    // seconds between journal updates
+#define POWER_LOSS_JOURNAL_FILE "RESTART.BIN" // name of the journal file, in the root directory
 /*****************************************************************************************/
 
 
@@ -1237,6 +1326,65 @@
 /***********************************************************************/
 
 
+/***********************************************************************
+ ************************ Stepper ISR statistics ***********************
+ ***********************************************************************
+ *                                                                     *
+ * Measure the stepper interrupt with timer 1 and report it with M930: *
+ * ISR duration, double/quad stepping, steprate clamps, planner        *
+ * underruns and block start latency. M930 R resets the counters.      *
+ * Costs about 1us per stepper interrupt.                              *
+ *                                                                     *
+ * Uncomment STEPPER_ISR_STATS to enable this feature                  *
+ *                                                                     *
+ ***********************************************************************/
+//#define STEPPER_ISR_STATS
+#define STEPPER_ISR_UNDERRUN_MS 250  // A block starting within this time after the planner ran empty is an underrun
+/***********************************************************************/
+
+
+/***********************************************************************
+ **************************** Input shaping ****************************
+ ***********************************************************************
+ *                                                                     *
+ * Cancel the ringing of the X and Y axes. Every step is split in two  *
+ * or three impulses, the later ones delayed by a fraction of the      *
+ * ringing period, so the vibrations they start cancel each other.     *
+ * Measure the frequency from the ripples of a test print:             *
+ * frequency = speed (mm/s) / distance between ripples (mm).           *
+ *                                                                     *
+ * Shaper types: 0 = None, 1 = ZV, 2 = ZVD, 3 = MZV                    *
+ * ZV has the shortest delay, ZVD and MZV tolerate a wrong frequency   *
+ * better at the cost of a longer smoothing.                           *
+ * Set with M593, stored in EEPROM.                                    *
+ *                                                                     *
+ * SHAPING_QUEUE steps are remembered per axis for the delayed         *
+ * impulses, 2 bytes each. It must hold the steps of the longest delay:*
+ * steps/s at max speed / frequency (ZVD and MZV) or half that (ZV).   *
+ * A queue too short for the max feedrate is reported at start and by  *
+ * M593, as are the overflows. scripts/shaping_sim.py simulates the    *
+ * residual vibration and the queue needed.                            *
+ *                                                                     *
+ * SHAPING_DIR_DELAY is the setup time of the drivers from a direction *
+ * change to the step pulse.                                           *
+ *                                                                     *
+ * Not for DELTA, SCARA or DUAL_X_CARRIAGE.                            *
+ *                                                                     *
+ * Uncomment INPUT_SHAPING to enable this feature                      *
+ *                                                                     *
+ ***********************************************************************/
+//#define INPUT_SHAPING
+#define SHAPING_TYPE_X 1      // 0 = None, 1 = ZV, 2 = ZVD, 3 = MZV
+#define SHAPING_FREQ_X 40.0   // (Hz) Ringing frequency, 10 Hz minimum
+#define SHAPING_ZETA_X 0.1    // Damping ratio, 0.0 to 0.5
+#define SHAPING_TYPE_Y 1
+#define SHAPING_FREQ_Y 40.0
+#define SHAPING_ZETA_Y 0.1
+#define SHAPING_QUEUE 256     // Steps per axis, power of 2, 1024 max
+#define SHAPING_DIR_DELAY 1   // (us) 0 for TMC drivers, 1 for A4988 and DRV8825, 5 for TB6600
+/***********************************************************************/
+
+
 /***********************************************************************
  *************************** Microstepping *****************************
  ***********************************************************************
@@ -1444,6 +1592,10 @@
 #define MAX_CMD_SIZE  96
 #define BUFSIZE        4
 
+// The serial output is sent by the serial interrupt from this buffer, so printing
+// doesn't wait for each character to be transmitted. Power of 2 up to 128, 0 to disable.
+#define TX_BUFFER_SIZE 32
+
 // Defines the number of memory slots for saving/restoring position (G60/G61)
 // The values should not be less than 1
 #define NUM_POSITON_SLOTS 2
@@ -1490,6 +1642,21 @@
 /*****************************************************************************************/
 
 
+/*****************************************************************************************
+ ********************************* Idle task scheduler ***********************************
+ *****************************************************************************************
+ *                                                                                       *
+ * idle() runs its tasks from a table. The critical ones (temperature, command fetching, *
+ * inactivity checks, keepalive) run on every pass, the background ones (LCD, reports,   *
+ * print counter) one per pass, so a slow LCD redraw delays the critical ones only once. *
+ * M123 reports the runs, the late runs and the CPU time of every task, M123 R resets.   *
+ *                                                                                       *
+ *****************************************************************************************/
+//#define IDLE_SCHEDULER
+#define IDLE_TASK_MAX_LATENCY 50  // (ms) A task run later than this after it was due is counted as late
+/*****************************************************************************************/
+
+
 /*****************************************************************************************
  *************************************** Whatchdog ***************************************
  *****************************************************************************************
@@ -38,7 +38,7 @@
 
 #include "base.h"
 
-#define EEPROM_VERSION "MKV28"
+#define EEPROM_VERSION "MKV30"
 #define EEPROM_OFFSET 100
 
 /**
@@ -111,6 +111,12 @@
  * PIDTEMPCOOLER
  *  M306      PID         coolerKp, coolerKi, coolerKd (float x3)
  *
+ * MPCTEMP:
+ *  M307  H0  PCRAFM      mpc_settings[0] (float x6)
+ *  M307  H1  PCRAFM      mpc_settings[1] (float x6)
+ *  M307  H2  PCRAFM      mpc_settings[2] (float x6)
+ *  M307  H3  PCRAFM      mpc_settings[3] (float x6)
+ *
  * DOGLCD:
  *  M250  C               lcd_contrast (int)
  *
@@ -133,6 +139,9 @@
  *
  *  M???  S               IDLE_OOZING_enabled
  *
+ * INPUT_SHAPING:
+ *  M593  XY  TFD         shaping_settings type, frequency, zeta (uint8_t, float x2 per axis)
+ *
  * ALLIGATOR:
  *  M906  XYZ T0-4 E      Motor current (float x7)
  *
@@ -187,6 +196,10 @@ void Config_Postprocess() {
   #endif
 
   calculate_volumetric_multipliers();
+
+  #if ENABLED(INPUT_SHAPING)
+    shaping_refresh();
+  #endif
 }
 
 #if ENABLED(EEPROM_SETTINGS)
@@ -307,6 +320,10 @@ void Config_StoreSettings() {
     EEPROM_WRITE(coolerKd);
   #endif
 
+  #if ENABLED(MPCTEMP)
+    EEPROM_WRITE(mpc_settings);
+  #endif
+
   #if HASNT(LCD_CONTRAST)
     const int lcd_contrast = 32;
   #endif
@@ -347,6 +364,10 @@ void Config_StoreSettings() {
     EEPROM_WRITE(IDLE_OOZING_enabled);
   #endif
 
+  #if ENABLED(INPUT_SHAPING)
+    EEPROM_WRITE(shaping_settings);
+  #endif
+
   #if MB(ALLIGATOR)
     EEPROM_WRITE(motor_current);
   #endif
@@ -483,6 +504,10 @@ void Config_RetrieveSettings() {
       EEPROM_READ(coolerKd);
     #endif
 
+    #if ENABLED(MPCTEMP)
+      EEPROM_READ(mpc_settings);
+    #endif
+
     #if HASNT(LCD_CONTRAST)
       int lcd_contrast;
     #endif
@@ -520,6 +545,10 @@ void Config_RetrieveSettings() {
       EEPROM_READ(IDLE_OOZING_enabled);
     #endif
 
+    #if ENABLED(INPUT_SHAPING)
+      EEPROM_READ(shaping_settings);
+    #endif
+
     #if MB(ALLIGATOR)
       EEPROM_READ(motor_current);
     #endif
@@ -679,6 +708,23 @@ void Config_ResetDefault() {
     coolerKd = scalePID_d(DEFAULT_coolerKd);
   #endif
 
+  #if ENABLED(MPCTEMP)
+    const float mpc_power[] = MPC_HEATER_POWER,
+                mpc_capacity[] = MPC_BLOCK_HEAT_CAPACITY,
+                mpc_responsiveness[] = MPC_SENSOR_RESPONSIVENESS,
+                mpc_coeff_fan0[] = MPC_AMBIENT_XFER_COEFF,
+                mpc_coeff_fan255[] = MPC_AMBIENT_XFER_COEFF_FAN255,
+                mpc_filament[] = MPC_FILAMENT_HEAT_CAPACITY_PERMM;
+    for (int8_t h = 0; h < HOTENDS; h++) {
+      mpc_settings[h].heater_power = mpc_power[h];
+      mpc_settings[h].block_heat_capacity = mpc_capacity[h];
+      mpc_settings[h].sensor_responsiveness = mpc_responsiveness[h];
+      mpc_settings[h].ambient_xfer_coeff_fan0 = mpc_coeff_fan0[h];
+      mpc_settings[h].fan255_adjustment = mpc_coeff_fan255[h] - mpc_coeff_fan0[h];
+      mpc_settings[h].filament_heat_capacity_permm = mpc_filament[h];
+    }
+  #endif
+
   #if ENABLED(FWRETRACT)
     autoretract_enabled = false;
     retract_length = RETRACT_LENGTH;
@@ -700,6 +746,15 @@ void Config_ResetDefault() {
     IDLE_OOZING_enabled = true;
   #endif
 
+  #if ENABLED(INPUT_SHAPING)
+    shaping_settings[X_AXIS].type = SHAPING_TYPE_X;
+    shaping_settings[X_AXIS].frequency = SHAPING_FREQ_X;
+    shaping_settings[X_AXIS].zeta = SHAPING_ZETA_X;
+    shaping_settings[Y_AXIS].type = SHAPING_TYPE_Y;
+    shaping_settings[Y_AXIS].frequency = SHAPING_FREQ_Y;
+    shaping_settings[Y_AXIS].zeta = SHAPING_ZETA_Y;
+  #endif
+
   Config_Postprocess();
 
   ECHO_LM(DB, "Hardcoded Default Settings Loaded");
@@ -908,6 +963,19 @@ void Config_PrintSettings(bool forReplay) {
     #endif
   #endif
 
+  #if ENABLED(MPCTEMP)
+    CONFIG_ECHO_START("MPC settings: P=Power (W) C=Heat capacity (J/K) R=Sensor responsiveness A=Ambient loss (W/K) F=Loss with fan (W/K) M=Filament (J/K/mm)");
+    for (int8_t h = 0; h < HOTENDS; h++) {
+      ECHO_SMV(CFG, "  M307 H", h);
+      ECHO_MV(" P", mpc_settings[h].heater_power);
+      ECHO_MV(" C", mpc_settings[h].block_heat_capacity);
+      ECHO_MV(" R", mpc_settings[h].sensor_responsiveness, 4);
+      ECHO_MV(" A", mpc_settings[h].ambient_xfer_coeff_fan0, 4);
+      ECHO_MV(" F", mpc_settings[h].ambient_xfer_coeff_fan0 + mpc_settings[h].fan255_adjustment, 4);
+      ECHO_EMV(" M", mpc_settings[h].filament_heat_capacity_permm, 4);
+    }
+  #endif
+
   #if ENABLED(FWRETRACT)
     CONFIG_ECHO_START("Retract: S=Length (mm) F:Speed (mm/m) Z: ZLift (mm)");
     ECHO_SMV(CFG, "  M207 S", retract_length);
@@ -946,6 +1014,16 @@ void Config_PrintSettings(bool forReplay) {
   else
     CONFIG_ECHO_START("  M200 D0");
 
+  #if ENABLED(INPUT_SHAPING)
+    CONFIG_ECHO_START("Input shaping: T=Type (0 None, 1 ZV, 2 ZVD, 3 MZV) F=Frequency (Hz) D=Damping ratio");
+    ECHO_SMV(CFG, "  M593 X T", shaping_settings[X_AXIS].type);
+    ECHO_MV(" F", shaping_settings[X_AXIS].frequency);
+    ECHO_EMV(" D", shaping_settings[X_AXIS].zeta);
+    ECHO_SMV(CFG, "  M593 Y T", shaping_settings[Y_AXIS].type);
+    ECHO_MV(" F", shaping_settings[Y_AXIS].frequency);
+    ECHO_EMV(" D", shaping_settings[Y_AXIS].zeta);
+  #endif
+
   #if MB(ALLIGATOR)
     CONFIG_ECHO_START("Motor current:");
     ECHO_SMV(CFG, "  M906 X", motor_current[X_AXIS]);
@@ -33,6 +33,7 @@
  * - Redundant thermistor
  * - Temperature status LEDs
  * - PID Settings - HOTEND
+ * - MPC Settings - HOTEND
  * - PID Settings - BED
  * - PID Settings - CHAMBER
  * - PID Settings - COOLER
@@ -149,6 +150,12 @@
 #define TEMP_COOLER_HYSTERESIS 1        // (degC) range of +/- temperatures considered "close" to the target one
 #define TEMP_COOLER_WINDOW     1        // (degC) Window around target to start the residency timer x degC early.
 
+// M109 and M190 only set the target and return, their wait is done before the first command
+// that needs the temperature (extruding moves, tool change and the like).
+// Homing, probing, leveling and travel moves run while the heaters ramp up.
+// The bed may still expand while it is probed, disable this if your leveling needs a stable bed.
+//#define DEFERRED_HEATUP_WAIT
+
 // When temperature exceeds max temp, your heater will be switched off.
 // When temperature exceeds max temp, your cooler cannot be activaed.
 // This feature exists to protect your hotend from overheating accidentally, but *NOT* from thermistor short/failure!
@@ -233,6 +240,25 @@
 /***********************************************************************/
 
 
+/***********************************************************************
+ ********************* ADC interrupt sampling **************************
+ ***********************************************************************
+ *                                                                     *
+ * Read the temperature sensors with the ADC conversion complete       *
+ * interrupt instead of one sensor every other temperature tick.       *
+ * Every ADC_SWEEP_TICKS ticks (1.024ms each) the timer ISR starts a   *
+ * sweep and the ADC ISR chains the conversions of all the sensors.    *
+ * Temperatures update about 7 times faster and the timer ISR only     *
+ * manages PWM.                                                        *
+ * ADC_SWEEP_TICKS must give time to convert all the sensors,          *
+ * about 0.104ms each.                                                 *
+ *                                                                     *
+ ***********************************************************************/
+//#define ADC_INTERRUPT_SAMPLING
+#define ADC_SWEEP_TICKS 2
+/***********************************************************************/
+
+
 /***********************************************************************
  ********************* Temperature status LEDs *************************
  ***********************************************************************
@@ -281,6 +307,41 @@
 /***********************************************************************/
 
 
+/***********************************************************************
+ ********************** MPC Settings - HOTEND **************************
+ ***********************************************************************
+ *                                                                     *
+ * Model Predictive Control of the hotends, in place of PIDTEMP.       *
+ * A thermal model of the heater block predicts the temperature and    *
+ * plans the power to reach the target, including the heat taken by    *
+ * the print fan and by the filament of the queued moves.              *
+ * Measure the values of your hotend with M307 T and save with M500.   *
+ *                                                                     *
+ ***********************************************************************/
+//#define MPCTEMP
+
+#define MPC_MAX BANG_MAX                            // Limits current to nozzle; 255=full current
+#define MPC_HEATER_POWER { 40.0, 40.0, 40.0, 40.0 } // (W) Heater cartridge power of H0, H1, H2, H3
+
+// Model values, measured by M307 T
+#define MPC_BLOCK_HEAT_CAPACITY { 16.7, 16.7, 16.7, 16.7 }          // (J/K) Heat capacity of the heater block
+#define MPC_SENSOR_RESPONSIVENESS { 0.22, 0.22, 0.22, 0.22 }        // (K/s per K) Speed of the sensor in following the block
+#define MPC_AMBIENT_XFER_COEFF { 0.068, 0.068, 0.068, 0.068 }       // (W/K) Heat lost to the ambient with the fan off
+#define MPC_AMBIENT_XFER_COEFF_FAN255 { 0.097, 0.097, 0.097, 0.097 } // (W/K) Heat lost to the ambient with the fan at 255
+
+// Heat taken by the filament, (J/K/mm) = density * specific heat * section
+// 0.0056 is 1.75mm PLA, 0.0142 is 2.85mm PLA
+#define MPC_FILAMENT_HEAT_CAPACITY_PERMM { 0.0056, 0.0056, 0.0056, 0.0056 }
+#define MPC_FEEDFORWARD_TIME 2.0  // (s) Queued moves averaged for the filament heat
+
+#define MPC_SMOOTHING_FACTOR 0.5      // (0.0...1.0) How quickly the model follows the measured temperature
+#define MPC_MIN_AMBIENT_CHANGE 1.0    // (K/s) Modeled ambient temperature rate of change, when correcting model inaccuracies
+#define MPC_STEADYSTATE 0.5           // (K/s) Temperature change rate for steady state logic to be enforced
+
+#define MPC_AUTOTUNE_TEMP 200         // (C) Temperature of the M307 T measurements
+/***********************************************************************/
+
+
 /***********************************************************************
  ************************ PID Settings - BED ***************************
  ***********************************************************************
@@ -119,6 +119,8 @@
  * M120 - Enable endstop detection
  * M121 - Disable endstop detection
  * M122 - S<1=true/0=false> Enable or disable check software endstop
+ * M123 - Report the runs, late runs and CPU time of the idle tasks, R resets them. Requires IDLE_SCHEDULER.
+ * M124 - S<1=true/0=false> Add line number, free planner blocks and free command slots to "ok". Requires ADVANCED_OK.
  * M126 - Solenoid Air Valve Open (BariCUDA support by jmil)
  * M127 - Solenoid Air Valve Closed (BariCUDA vent to atmospheric pressure by jmil)
  * M128 - EtoP Open (BariCUDA EtoP = electricity to air pressure transducer by jmil)
@@ -129,9 +131,12 @@
  * M145 - Set the heatup state H<hotend> B<bed> F<fan speed> for S<material> (0=PLA, 1=ABS)
  * M149 - Set temperature units
  * M150 - Set BlinkM Color Output R: Red<0-255> U(!): Green<0-255> B: Blue<0-255> over i2c, G for green does not work.
+ * M154 - S<seconds> Send the position to the host every S seconds, S0 to stop. Requires AUTO_REPORT_POSITION.
+ * M155 - S<seconds> Send the temperatures to the host every S seconds, S0 to stop. Requires AUTO_REPORT_TEMPERATURES.
  * M163 - Set a single proportion for a mixing extruder. Requires COLOR_MIXING_EXTRUDER.
  * M164 - Save the mix as a virtual extruder. Requires COLOR_MIXING_EXTRUDER and MIXING_VIRTUAL_TOOLS.
  * M165 - Set the proportions for a mixing extruder. Use parameters ABCDHI to set the mixing factors. Requires COLOR_MIXING_EXTRUDER.
+ * M166 - Set a mix gradient program. P<program> A<start> Z<end> I<start tool> J<end tool> E1 over the filament fed, S1 to run it, S0 to stop it. Requires MIXING_GRADIENT.
  * M190 - Sxxx Wait for bed current temp to reach target temp. Waits only when heating
  *        Rxxx Wait for bed current temp to reach target temp. Waits when heating and cooling
  * M191 - Sxxx Wait for chamber current temp to reach target temp. Waits only when heating
@@ -159,10 +164,11 @@
  * M300 - Play beep sound S<frequency Hz> P<duration ms>
  * M301 - Set PID parameters P I D and C
  * M302 - Allow cold extrudes, or set the minimum extrude S<temperature>.
- * M303 - PID relay autotune S<temperature> sets the target temperature (default target temperature = 150C). H<hotend> C<cycles> U<Apply result>
+ * M303 - PID relay autotune S<temperature> sets the target temperature (default target temperature = 150C). H<hotend> C<cycles> U<Apply result>. Runs in the background, S0 stops it
  * M304 - Set hot bed PID parameters P I and D
  * M305 - Set hot chamber PID parameters P I and D
  * M306 - Set cooler PID parameters P I and D
+ * M307 - Set or measure (T) the MPC model of a hotend: H P C R A F M
  * M350 - Set microstepping mode.
  * M351 - Toggle MS1 MS2 pins directly.
  * M380 - Activate solenoid on active extruder
@@ -185,9 +191,10 @@
  * M503 - Print the current settings (from memory not from EEPROM). Use S0 to leave off headings.
  * M522 - Read or Write on card. M522 T<extruders> R<read> or W<write> L<list>
  * M540 - Use S[0|1] to enable or disable the stop print on endstop hit (requires ABORT_ON_ENDSTOP_HIT_FEATURE_ENABLED)
+ * M593 - Set input shaping [X|Y] T<type> F<frequency> D<damping> (requires INPUT_SHAPING)
  * M595 - Set hotend AD595 O<offset> and S<gain>
  * M600 - Pause for filament change X[pos] Y[pos] Z[relative lift] E[initial retract] L[later retract distance for removal]
- * M605 - Set dual x-carriage movement mode: S<mode> [ X<duplication x-offset> R<duplication temp offset> ]
+ * M605 - Set dual x-carriage movement mode: S<mode> [ X<duplication x-offset or mirror line> R<duplication temp offset> ]
  * M649 - laser set options
  * M666 - Set z probe offset or Endstop and delta geometry adjustment
  * M906 - Set motor currents XYZ T0-4 E
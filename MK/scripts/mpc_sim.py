@@ -0,0 +1,205 @@
+#!/usr/bin/python3
+
+# Host simulation of the model predictive hotend control (MPCTEMP)
+#
+# The plant is a heater block with a heat capacity, heated by the cartridge,
+# losing heat to the ambient (more with the fan) and to the filament, and a
+# sensor that follows the block with a lag. The firmware side is a port of
+# get_mpc_output() and of the M307 T state machine of temperature.cpp,
+# called at each reading like manage_temp_controller does.
+#
+#  - M307 T on the plant: the measured model against the real one.
+#  - Heat-up to the target with the measured model: overshoot and time.
+#  - A flow step while printing: largest sag, with and without the
+#    filament feed forward of the queued moves.
+#
+# usage: mpc_sim.py [-P 40] [-C 16.7] [-R 0.22] [-A 0.068] [-F 0.097] [-t 210] [-f 15]
+#        mpc_sim.py -h for all the options
+
+import argparse
+import math
+
+F_CPU = 16000000.0
+OVERSAMPLENR = 16
+
+# Configuration_Temperature.h
+MPC_SMOOTHING_FACTOR = 0.5
+MPC_MIN_AMBIENT_CHANGE = 1.0
+MPC_STEADYSTATE = 0.5
+MPC_AUTOTUNE_TEMP = 200
+MAX_POWER = 255
+
+parser = argparse.ArgumentParser(description="MPC hotend control on a simulated heater block")
+parser.add_argument('-P', '--power', type=float, default=40.0, help='heater power in W (default 40)')
+parser.add_argument('-C', '--capacity', type=float, default=16.7, help='block heat capacity in J/K (default 16.7)')
+parser.add_argument('-R', '--responsiveness', type=float, default=0.22, help='sensor responsiveness in K/s per K (default 0.22)')
+parser.add_argument('-A', '--ambient-coeff', type=float, default=0.068, help='loss to the ambient with the fan off in W/K (default 0.068)')
+parser.add_argument('-F', '--fan-coeff', type=float, default=0.097, help='loss to the ambient with the fan at 255 in W/K (default 0.097)')
+parser.add_argument('-M', '--filament', type=float, default=0.0056, help='filament heat capacity in J/K/mm (default 0.0056)')
+parser.add_argument('-a', '--ambient', type=float, default=25.0, help='ambient temperature in C (default 25)')
+parser.add_argument('-t', '--target', type=float, default=210.0, help='print temperature in C (default 210)')
+parser.add_argument('-f', '--flow', type=float, default=15.0, help='filament speed of the flow step in mm/s (default 15)')
+parser.add_argument('-s', '--sweep', type=int, default=2, help='ADC_SWEEP_TICKS, 0 without ADC_INTERRUPT_SAMPLING (default 2)')
+args = parser.parse_args()
+
+DT = OVERSAMPLENR * (args.sweep if args.sweep else 14.0) / (F_CPU / 64.0 / 256.0)
+
+
+class Plant:
+    def __init__(self):
+        self.block = self.sensor = args.ambient
+        self.fan = 0          # 0-255
+        self.e_speed = 0.0    # mm/s of filament
+
+    def step(self, output):
+        coeff = args.ambient_coeff + (args.fan_coeff - args.ambient_coeff) * self.fan / 255.0
+        heat = output * args.power / 255.0 - (self.block - args.ambient) * coeff \
+            - self.e_speed * args.filament * (self.block - args.ambient)
+        self.block += heat * DT / args.capacity
+        self.sensor += (self.block - self.sensor) * args.responsiveness * DT
+        # ADC resolution of the thermistor tables, about 0.25 degree
+        return round(self.sensor * 4) / 4
+
+
+class Model:
+    # get_mpc_output() and mpc_ambient_xfer_coeff()
+    def __init__(self, P, C, R, A, F, M):
+        self.P, self.C, self.R, self.A, self.F, self.M = P, C, R, A, F - A, M
+        self.ready = False
+        self.output = 0
+
+    def run(self, temp, target, fan, e_speed):
+        if not self.ready:
+            self.block = self.sensor = temp
+            self.ambient = min(30.0, temp)
+            self.ready = True
+        coeff = self.A + self.F * fan / 255.0 + e_speed * self.M
+        blocktempdelta = (self.output * self.P / 255.0 + (self.ambient - self.block) * coeff) * DT / self.C
+        self.block += blocktempdelta
+        self.sensor += (self.block - self.sensor) * self.R * DT
+        delta = (temp - self.sensor) * MPC_SMOOTHING_FACTOR
+        self.block += delta
+        self.sensor += delta
+        if (0 < self.output < MAX_POWER) or abs(blocktempdelta + delta) < MPC_STEADYSTATE * DT:
+            self.ambient += max(delta, MPC_MIN_AMBIENT_CHANGE * DT) if delta > 0 else min(delta, -MPC_MIN_AMBIENT_CHANGE * DT)
+        if target <= 0:
+            out = 0
+        else:
+            power = (target - self.block) * self.C / 2.0 - (self.ambient - self.block) * coeff
+            out = int(min(max(power * 255.0 / self.P, 0), MAX_POWER) + 0.5)
+        self.output = out
+        return out
+
+
+def autotune(plant):
+    # The M307 T phases of mpc_autotune_output(), one call per reading
+    model = Model(args.power, 1, 1, 1, 1, 0)
+    plant.fan = 255
+    n, temp = 0, plant.sensor
+    ms = lambda: int(n * DT * 1000)
+    last_temp, next_test = temp, 10000
+    while True:  # Cooling
+        temp = plant.step(0)
+        n += 1
+        if ms() >= next_test:
+            if temp >= last_temp - 0.1:
+                break
+            last_temp, next_test = temp, next_test + 10000
+    plant.fan = 0
+    ambient = temp
+    samples, distance, t1_time = [], 1, 0.0
+    start = next_test = ms()
+    while True:  # Heating
+        temp = plant.step(MAX_POWER)
+        n += 1
+        if ms() < next_test:
+            continue
+        if temp >= (ambient + MPC_AUTOTUNE_TEMP) / 2:
+            if len(samples) == 16:
+                samples, distance = samples[::2], distance * 2
+            if not samples:
+                t1_time = (ms() - start) / 1000.0
+            samples.append(temp)
+        next_test += 1000 * distance
+        if temp >= MPC_AUTOTUNE_TEMP:
+            break
+    if len(samples) % 2 == 0:
+        samples.pop()
+    t1, t2, t3 = samples[0], samples[len(samples) // 2], samples[-1]
+    interval = distance * (len(samples) // 2)
+    heat_power = args.power
+
+    def fit(asymp, coeff):
+        br = -math.log((t2 - asymp) / (t1 - asymp)) / interval
+        return coeff / br, br / (1.0 - (ambient - asymp) * math.exp(-br * t1_time) / (t1 - asymp))
+
+    asymp = (t2 * t2 - t1 * t3) / (2 * t2 - t1 - t3)
+    model.A = heat_power / (asymp - ambient)
+    model.C, model.R = fit(asymp, model.A)
+    model.block = model.sensor = temp
+    model.ambient, model.ready = ambient, True
+
+    coeffs = []
+    for fan in (0, 255):  # Hold, fan off then at full speed
+        plant.fan = fan
+        total_power = total_temp = 0.0
+        count, measure, end = 0, ms() + 60000, ms() + 120000
+        out = model.run(temp, MPC_AUTOTUNE_TEMP, fan, 0)
+        while ms() < end:
+            temp = plant.step(out)
+            n += 1
+            out = model.run(temp, MPC_AUTOTUNE_TEMP, fan, 0)
+            if ms() >= measure:
+                total_power += out * args.power / 255.0
+                total_temp += temp
+                count += 1
+        coeffs.append(total_power / (total_temp - ambient * count))
+        if fan == 0:
+            model.A = coeffs[0]
+    plant.fan = 0
+    asymp = ambient + heat_power / coeffs[0]
+    if asymp > t3:
+        model.C, model.R = fit(asymp, coeffs[0])
+    return model.C, model.R, coeffs[0], coeffs[1], n * DT
+
+
+def run(model, plant, seconds, target, e_speed=0.0, feedforward=True, on_step=None):
+    temp, curve = plant.sensor, []
+    out = 0
+    for n in range(int(seconds / DT)):
+        if on_step:
+            e_speed = on_step(n * DT)
+        plant.e_speed = e_speed
+        out = model.run(temp, target, plant.fan, e_speed if feedforward else 0.0)
+        temp = plant.step(out)
+        curve.append((n * DT, temp))
+    return curve
+
+
+C, R, A, F, tune_time = autotune(Plant())
+print("PID_dT %.4f s" % DT)
+print("M307 T in %.0f s:" % tune_time)
+print("          real      measured")
+for name, real, measured in (("C J/K", args.capacity, C), ("R K/s/K", args.responsiveness, R),
+                             ("A W/K", args.ambient_coeff, A), ("F W/K", args.fan_coeff, F)):
+    print("%-8s %8.4f  %8.4f  (%+.1f%%)" % (name, real, measured, 100 * (measured / real - 1)))
+
+# Heat-up with the measured model
+plant = Plant()
+curve = run(Model(args.power, C, R, A, F, args.filament), plant, 300, args.target)
+peak = max(t for _, t in curve)
+reached = next((s for s, t in curve if t >= args.target - 1), None)
+print()
+print("Heat-up to %.0f C: within 1 C after %s s, overshoot %.2f C"
+      % (args.target, "%.1f" % reached if reached is not None else "never", peak - args.target))
+
+# Flow step from 0 to the print flow, after settling
+for feedforward in (True, False):
+    plant = Plant()
+    model = Model(args.power, C, R, A, F, args.filament)
+    run(model, plant, 300, args.target)
+    curve = run(model, plant, 60, args.target, feedforward=feedforward,
+                on_step=lambda s: args.flow if s >= 10 else 0.0)
+    sag = args.target - min(t for s, t in curve if s >= 10)
+    print("Flow step to %.1f mm/s %s feed forward: largest sag %.2f C"
+          % (args.flow, "with" if feedforward else "without", sag))
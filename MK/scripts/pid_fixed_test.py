@@ -0,0 +1,228 @@
+#!/usr/bin/python3
+
+# Host test of the fixed point PID of temperature.cpp against the float PID
+#
+# Both controllers drive the same first-order heater model. The fixed point
+# one is a port of pid_set_gains(), pid_temp(), pid_derivative() and
+# pid_compute() with 32 bit integers and arithmetic shifts; the float one is
+# the former get_pid_output(). They are compared on the same temperatures
+# (output difference in PWM steps) and in closed loop (temperature curves).
+# The gains are the defaults of Configuration_Temperature.h, for both the
+# ADC interrupt sampling and the plain sampling PID_dT.
+#
+# usage: pid_fixed_test.py [-c ../Configuration_Temperature.h] [-o 3] [-t 0.5]
+#        exits with 1 when a difference is over its tolerance
+
+import argparse
+import os
+import re
+import sys
+
+F_CPU = 16000000.0
+OVERSAMPLENR = 16
+
+PID_TEMP_SHIFT = 4
+PID_ERROR_MAX = 2047
+PID_DELTA_MAX = 1023
+PID_TERM_MAX = 0x3FFFFF
+PID_KP_MAX = 4095.0
+PID_KI_MAX = 15.99
+PID_KD_MAX = 131071.0
+
+parser = argparse.ArgumentParser(description="Fixed point PID against the float PID")
+parser.add_argument('-c', '--config', default=os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Configuration_Temperature.h'),
+                    help='Configuration_Temperature.h to read the gains from')
+parser.add_argument('-o', '--output', type=int, default=3, help='output tolerance in PWM steps (default 3)')
+parser.add_argument('-t', '--temperature', type=float, default=0.5, help='temperature tolerance in degC (default 0.5)')
+args = parser.parse_args()
+
+
+def define(text, name, default=None):
+    m = re.search(r'^\s*#define\s+' + name + r'\s+(\{[^}]*\}|\S+)', text, re.M)
+    if not m:
+        if default is None:
+            sys.exit("missing %s in %s" % (name, args.config))
+        return default
+    value = m.group(1).strip('{}').split(',')[0].strip()
+    if re.match(r'^[A-Za-z_]\w*$', value):
+        return define(text, value, default)  # defined as another setting
+    return float(value)
+
+
+with open(args.config, encoding='latin-1') as f:
+    config = f.read()
+
+K1 = define(config, 'K1')
+BANG_MAX = define(config, 'BANG_MAX')
+ADC_SWEEP_TICKS = define(config, 'ADC_SWEEP_TICKS', 2)
+PID_FUNCTIONAL_RANGE = define(config, 'PID_FUNCTIONAL_RANGE')
+PID_K1 = int(K1 * 256 + 0.5)
+PID_K2 = 256 - PID_K1
+
+
+def i32(x):
+    assert -(1 << 31) <= x < (1 << 31), "32 bit overflow: %d" % x
+    return x
+
+
+def constrain(x, lo, hi):
+    return lo if x < lo else hi if x > hi else x
+
+
+def trunc(x):
+    # float to integer conversion of C
+    return int(x)
+
+
+class FixedPID:
+    def __init__(self, p, i, d, i_max, hotend, start):
+        self.Kp = trunc(constrain(p, 0, PID_KP_MAX) * 256.0)
+        self.Ki = trunc(constrain(i, 0, PID_KI_MAX) * 65536.0)
+        self.Kd = trunc(constrain(d, 0, PID_KD_MAX) * 16.0)
+        self.iMax = trunc(i_max * 65536.0)
+        self.limited = p > PID_KP_MAX or i > PID_KI_MAX or d > PID_KD_MAX
+        self.iTerm = self.dTerm = 0
+        self.last = self.temp(start)
+        self.hotend = hotend
+        self.reset = True
+
+    @staticmethod
+    def temp(t):
+        return trunc(t * (1 << PID_TEMP_SHIFT) + (-0.5 if t < 0 else 0.5))
+
+    def derivative(self, temp):
+        delta = constrain(temp - self.last, -PID_DELTA_MAX, PID_DELTA_MAX)
+        d_raw = constrain(i32(delta * self.Kd), -PID_TERM_MAX, PID_TERM_MAX)
+        self.dTerm = i32(PID_K2 * d_raw + PID_K1 * self.dTerm) >> 8
+        self.last = temp
+
+    def compute(self, error, max_output):
+        err = constrain(error, -PID_ERROR_MAX, PID_ERROR_MAX)
+        i_step = i32(err * self.Ki) >> PID_TEMP_SHIFT
+        iTerm = constrain(i32(self.iTerm + i_step), 0, self.iMax)
+        max_q8 = max_output << 8
+        self.pTerm = i32(err * self.Kp) >> PID_TEMP_SHIFT
+        output = i32(self.pTerm + (iTerm >> 8) - self.dTerm)
+        if output > max_q8:
+            if i_step <= 0:
+                self.iTerm = iTerm
+            return max_output
+        if output < 0:
+            if i_step >= 0:
+                self.iTerm = iTerm
+            return 0
+        self.iTerm = iTerm
+        return output >> 8
+
+    def output(self, current, target, max_output):
+        temp = self.temp(current)
+        error = self.temp(target) - temp
+        self.derivative(temp)
+        if self.hotend:
+            if error > self.temp(PID_FUNCTIONAL_RANGE):
+                self.reset = True
+                return int(BANG_MAX)
+            if error < -self.temp(PID_FUNCTIONAL_RANGE) or target == 0:
+                self.reset = True
+                return 0
+            if self.reset:
+                self.iTerm = 0
+                self.reset = False
+        return self.compute(error, int(max_output))
+
+
+class FloatPID:
+    def __init__(self, p, i, d, i_max, hotend, start):
+        self.Kp, self.Ki, self.Kd = p, i, d
+        self.iState_max = i_max / i
+        self.iState = self.dTerm = 0.0
+        self.dState = start
+        self.hotend = hotend
+        self.reset = True
+
+    def output(self, current, target, max_output):
+        error = target - current
+        self.dTerm = (1.0 - K1) * self.Kd * (current - self.dState) + K1 * self.dTerm
+        self.dState = current
+        if self.hotend:
+            if error > PID_FUNCTIONAL_RANGE:
+                self.reset = True
+                return int(BANG_MAX)
+            if error < -PID_FUNCTIONAL_RANGE or target == 0:
+                self.reset = True
+                return 0
+            if self.reset:
+                self.iState = 0.0
+                self.reset = False
+        self.iState = constrain(self.iState + error, 0.0, self.iState_max)
+        out = self.Kp * error + self.Ki * self.iState - self.dTerm
+        if out > max_output:
+            if error > 0:
+                self.iState -= error  # conditional un-integration
+            out = max_output
+        elif out < 0:
+            if error < 0:
+                self.iState -= error
+            out = 0
+        return int(out)
+
+
+class Heater:
+    # First-order heater: power in W at full PWM, loss in W/K, heat capacity in J/K
+    def __init__(self, power, loss, capacity, ambient=25.0):
+        self.power, self.loss, self.capacity = power, loss, capacity
+        self.ambient = self.temp = ambient
+
+    def step(self, pwm, dt):
+        heat = self.power * pwm / 255.0 - self.loss * (self.temp - self.ambient)
+        self.temp += heat * dt / self.capacity
+        # ADC resolution of the thermistor tables, about 0.25 degree
+        return round(self.temp * 4) / 4
+
+
+def run(name, hotend, Kp, Ki, Kd, i_max, max_output, dt, heater, target, seconds):
+    p, i, d = Kp, Ki * dt, Kd / dt
+    # Both start from the ambient, the D term of the first reading is not compared
+    plant = Heater(*heater)
+    fixed, flt = FixedPID(p, i, d, i_max, hotend, plant.ambient), FloatPID(p, i, d, i_max, hotend, plant.ambient)
+
+    # Same temperatures for both: outputs side by side
+    current, worst_out = plant.ambient, 0
+    for n in range(int(seconds / dt)):
+        out_float = flt.output(current, target, max_output)
+        out_fixed = fixed.output(current, target, max_output)
+        worst_out = max(worst_out, abs(out_float - out_fixed))
+        current = plant.step(out_float, dt)
+
+    # Each in its own loop: temperature curves
+    runs = []
+    for pid in (FixedPID(p, i, d, i_max, hotend, plant.ambient), FloatPID(p, i, d, i_max, hotend, plant.ambient)):
+        plant, curve = Heater(*heater), []
+        current = plant.ambient
+        for n in range(int(seconds / dt)):
+            current = plant.step(pid.output(current, target, max_output), dt)
+            curve.append(plant.temp)
+        runs.append(curve)
+    worst_temp = max(abs(a - b) for a, b in zip(*runs))
+
+    ok = worst_out <= args.output and worst_temp <= args.temperature and not fixed.limited
+    print("%-28s dT %.4f  Kd/dT %9.1f  output %3d PWM  temp %.3f C  final %.1f C  %s"
+          % (name, dt, d, worst_out, worst_temp, runs[0][-1], "ok" if ok else "FAIL"))
+    return ok
+
+
+adc_dt = OVERSAMPLENR * ADC_SWEEP_TICKS / (F_CPU / 64.0 / 256.0)
+plain_dt = OVERSAMPLENR * 14.0 / (F_CPU / 64.0 / 256.0)
+
+hotend = (define(config, 'DEFAULT_Kp'), define(config, 'DEFAULT_Ki'), define(config, 'DEFAULT_Kd'),
+          define(config, 'PID_INTEGRAL_DRIVE_MAX', BANG_MAX), define(config, 'PID_MAX', BANG_MAX))
+bed = (define(config, 'DEFAULT_bedKp'), define(config, 'DEFAULT_bedKi'), define(config, 'DEFAULT_bedKd'),
+       define(config, 'PID_BED_INTEGRAL_DRIVE_MAX', 255), define(config, 'MAX_BED_POWER', 255))
+
+ok = True
+for dt in (plain_dt, adc_dt):
+    ok &= run("hotend 200C", True, *hotend, dt, (40.0, 0.12, 12.0), 200.0, 600)
+    ok &= run("bed 60C", False, *bed, dt, (250.0, 1.5, 600.0), 60.0, 1200)
+ok &= run("bed 60C Kd 1900", False, bed[0], bed[1], 1900.0, bed[3], bed[4], plain_dt, (250.0, 1.5, 600.0), 60.0, 1200)
+
+sys.exit(0 if ok else 1)
@@ -0,0 +1,158 @@
+#!/usr/bin/python3
+
+# Host simulation of the input shaping of the stepper ISR (INPUT_SHAPING)
+#
+# Steps of a trapezoidal move go through the same shaper as the firmware:
+# amplitudes in 1/256 steps, delays in 4us ticks, a queue of SHAPING_QUEUE
+# steps and whole output steps. The output drives a toolhead modeled as a
+# mass on a spring with the ringing frequency and damping of the printer.
+# The residual vibration is the largest distance between the toolhead and
+# the motor position once the move is over, with and without the shaper,
+# also when the real ringing frequency differs from the configured one.
+#
+# usage: shaping_sim.py [-t zv|zvd|mzv] [-f 40] [-z 0.1] [-a 3000] [-v 150] ...
+#        shaping_sim.py -h for all the options
+
+import argparse
+import math
+
+TICK = 4e-6  # Shaper time unit, 4us
+
+parser = argparse.ArgumentParser(description="Residual vibration with and without input shaping")
+parser.add_argument('-t', '--type', default='zv', choices=['zv', 'zvd', 'mzv'], help='shaper type (default zv)')
+parser.add_argument('-f', '--frequency', type=float, default=40.0, help='configured ringing frequency in Hz (default 40)')
+parser.add_argument('-z', '--zeta', type=float, default=0.1, help='configured damping ratio (default 0.1)')
+parser.add_argument('-a', '--acceleration', type=float, default=3000.0, help='acceleration in mm/s^2 (default 3000)')
+parser.add_argument('-v', '--speed', type=float, default=150.0, help='move speed in mm/s (default 150)')
+parser.add_argument('-d', '--distance', type=float, default=40.0, help='move length in mm (default 40)')
+parser.add_argument('-s', '--steps', type=float, default=80.0, help='steps per mm (default 80)')
+parser.add_argument('-q', '--queue', type=int, default=256, help='SHAPING_QUEUE (default 256)')
+args = parser.parse_args()
+
+
+# Impulses as computed by shaping_refresh() in stepper.cpp
+def shaper_impulses(kind, frequency, zeta):
+    damped = math.sqrt(1.0 - zeta * zeta)
+    period = 1.0 / (frequency * damped)
+    K = math.exp(-zeta * math.pi / damped)
+    if kind == 'zv':
+        amp, at = [1.0, K], [0.0, 0.5]
+    elif kind == 'zvd':
+        amp, at = [1.0, 2.0 * K, K * K], [0.0, 0.5, 1.0]
+    else:
+        Km, a = K ** 0.75, 1.0 - math.sqrt(0.5)
+        amp, at = [a, (math.sqrt(2.0) - 1.0) * Km, a * Km * Km], [0.0, 0.375, 0.75]
+    total = sum(amp)
+    amplitude, delay = [256], [0]
+    for i in range(1, len(amp)):
+        amplitude.append(int(amp[i] * 256.0 / total + 0.5))
+        amplitude[0] -= amplitude[-1]
+        delay.append(int(at[i] * period * 250000.0 + 0.5))
+    return amplitude, delay
+
+
+# Times in 4us ticks of the steps of a trapezoidal move
+def move_steps(distance, speed, accel, steps_per_mm):
+    t_acc = speed / accel
+    d_acc = 0.5 * accel * t_acc * t_acc
+    if 2 * d_acc > distance:
+        t_acc = math.sqrt(distance / accel)
+        d_acc = distance / 2
+        speed = accel * t_acc
+    t_cruise = (distance - 2 * d_acc) / speed
+    times = []
+    for n in range(1, int(distance * steps_per_mm) + 1):
+        d = n / steps_per_mm
+        if d <= d_acc:
+            t = math.sqrt(2 * d / accel)
+        elif d <= distance - d_acc:
+            t = t_acc + (d - d_acc) / speed
+        else:
+            left = distance - d
+            t = 2 * t_acc + t_cruise - math.sqrt(2 * left / accel)
+        times.append(int(t / TICK))
+    return times
+
+
+# The shaper of the ISR: output step times and queue overflows
+def shape(times, amplitude, delay, queue_size):
+    impulses = len(amplitude)
+    queue, tails, error, out, overflows = [], [0] * impulses, 0, [], 0
+
+    def output(now):
+        nonlocal error
+        while error >= 128:
+            error -= 256
+            out.append(now)
+
+    def due(until):
+        # Delayed impulses up to the time of the next input step
+        nonlocal error
+        while True:
+            nxt = None
+            for i in range(1, impulses):
+                if tails[i] < len(queue):
+                    t = queue[tails[i]] + delay[i]
+                    if nxt is None or t < nxt[0]:
+                        nxt = (t, i)
+            if nxt is None or (until is not None and nxt[0] > until):
+                return
+            error += amplitude[nxt[1]]
+            tails[nxt[1]] += 1
+            output(nxt[0])
+
+    for now in times:
+        due(now)
+        error += amplitude[0]
+        if impulses > 1:
+            if len(queue) - tails[impulses - 1] >= queue_size - 1:
+                # Queue full, the oldest step gives its impulses now
+                oldest = tails[impulses - 1]
+                for i in range(1, impulses):
+                    if tails[i] == oldest:
+                        error += amplitude[i]
+                        tails[i] += 1
+                overflows += 1
+            queue.append(now)
+        output(now)
+    due(None)
+    return out, overflows
+
+
+# Largest toolhead to motor distance in mm after the last step
+def residual(steps, steps_per_mm, frequency, zeta):
+    w = 2 * math.pi * frequency
+    dt = 5e-6
+    x = v = 0.0
+    k, t, end = 0, 0.0, steps[-1] * TICK
+    worst = 0.0
+    while t < end + 5.0 / frequency:
+        while k < len(steps) and steps[k] * TICK <= t:
+            k += 1
+        motor = k / steps_per_mm
+        a = -w * w * (x - motor) - 2 * zeta * w * v
+        v += a * dt
+        x += v * dt
+        t += dt
+        if t > end:
+            worst = max(worst, abs(x - motor))
+    return worst
+
+
+amplitude, delay = shaper_impulses(args.type, args.frequency, args.zeta)
+steps = move_steps(args.distance, args.speed, args.acceleration, args.steps)
+shaped, overflows = shape(steps, amplitude, delay, args.queue)
+
+print("Shaper %s at %.1f Hz, zeta %.2f: amplitudes %s/256, delays %s x 4us"
+      % (args.type.upper(), args.frequency, args.zeta, amplitude, delay))
+need = int(min(args.speed * args.steps, 1e9) * delay[-1] * TICK) + 1
+print("Queue: %d steps needed at %.0f mm/s, %d overflows with %d"
+      % (need, args.speed, overflows, args.queue))
+print()
+print("real Hz   unshaped um   shaped um   reduction")
+for ratio in (0.8, 0.9, 1.0, 1.1, 1.2):
+    f = args.frequency * ratio
+    plain = residual(steps, args.steps, f, args.zeta) * 1000
+    with_shaper = residual(shaped, args.steps, f, args.zeta) * 1000
+    print("%7.1f   %11.2f   %9.2f   %8.0f%%"
+          % (f, plain, with_shaper, 100 * (1 - with_shaper / plain) if plain else 0))
@@ -0,0 +1,162 @@
+#!/usr/bin/python3
+
+# Reference G-code streamer for the ADVANCED_OK responses (M124 S1)
+#
+# Instead of waiting for each "ok" before sending the next line, it keeps the
+# command buffer of the firmware full: as many lines in flight as BUFSIZE,
+# learned from the first "ok ... B<free>" answer, and never more bytes waiting in
+# the serial receive buffer than it can hold. Each ok names the line it answers
+# (N), so a line is acknowledged by its own ok and any other ok is ignored.
+#
+# stream_gcode_test.py runs the Streamer against a model of the firmware queue.
+#
+# usage: stream_gcode.py <port> <file.gcode> [-b 115200]
+# needs pyserial
+
+import argparse
+import time
+from collections import deque
+
+# Must match RX_BUFFER_SIZE in src/HAL/HardwareSerial.h
+RX_BUFFER_SIZE = 128
+
+
+# strip comments and blank lines
+def read_gcode(name):
+    lines = []
+    with open(name) as f:
+        for line in f:
+            line = line.split(';')[0].strip()
+            if line:
+                lines.append(line)
+    return lines
+
+
+# add the line number and the checksum
+def numbered(n, line):
+    line = "N%d %s" % (n, line)
+    checksum = 0
+    for char in line:
+        checksum ^= ord(char)
+    return ("%s*%d\n" % (line, checksum)).encode()
+
+
+# value of a field of the ok, "ok N12 P15 B3" -> field B = 3
+def ok_field(reply, field):
+    for word in reply.split()[1:]:
+        if word[0] == field:
+            return int(word[1:])
+    return None
+
+
+class Streamer:
+    def __init__(self, gcode, write, bufsize, rx_buffer_size=RX_BUFFER_SIZE, echo=print):
+        self.gcode = gcode
+        self.write = write
+        self.echo = echo           # other answers of the firmware
+        self.bufsize = bufsize
+        self.rx_buffer_size = rx_buffer_size
+        self.in_flight = deque()   # (line number, bytes) sent and not acknowledged yet
+        self.next_line = 0         # index in gcode of the next line to send
+        self.min_planner = None    # lowest P seen while streaming
+        self.resend_line = None    # line asked by the last Resend
+        self.resend_repeats = 0    # Resends of that line still expected for the lines sent after it
+
+    def done(self):
+        return self.next_line >= len(self.gcode) and not self.in_flight
+
+    # Fill the command buffer, the first line in flight is already out of the receive buffer
+    def fill(self):
+        while self.next_line < len(self.gcode) and len(self.in_flight) < self.bufsize:
+            data = numbered(self.next_line + 1, self.gcode[self.next_line])
+            waiting = sum(len(d) for n, d in list(self.in_flight)[1:])
+            if self.in_flight and waiting + len(data) >= self.rx_buffer_size:
+                break
+            self.write(data)
+            self.in_flight.append((self.next_line + 1, data))
+            self.next_line += 1
+
+    # Send again from line n, the lines sent after it are dropped or rejected
+    def resend(self, n):
+        self.resend_line = n
+        self.resend_repeats = sum(1 for k, d in self.in_flight if k > n)
+        self.in_flight = deque((k, d) for k, d in self.in_flight if k < n)
+        self.next_line = n - 1
+
+    def handle(self, reply):
+        if reply.startswith("ok"):
+            # The ok that follows a Resend may name no line, or a line that is
+            # still queued: only an ok for a line in flight acknowledges it.
+            n = ok_field(reply, 'N')
+            if n is not None and any(k == n for k, d in self.in_flight):
+                while self.in_flight and self.in_flight[0][0] <= n:
+                    self.in_flight.popleft()
+                if self.resend_line is not None and n >= self.resend_line:
+                    self.resend_line = None
+                    self.resend_repeats = 0
+            planner = ok_field(reply, 'P')
+            if planner is not None and self.next_line < len(self.gcode):
+                self.min_planner = planner if self.min_planner is None else min(self.min_planner, planner)
+        elif reply.startswith("Resend"):
+            n = int(reply.split(':')[1])
+            if n == self.resend_line and self.resend_repeats:
+                # A line sent after the asked one, rejected on its way in
+                self.resend_repeats -= 1
+            else:
+                self.resend(n)
+        elif reply:
+            self.echo(reply)
+
+    # No answer for a while: a Resend taken for a repeat was the real one
+    def timeout(self):
+        if self.resend_line is not None and self.resend_repeats:
+            self.resend(self.resend_line)
+            self.resend_repeats = 0
+
+
+def main():
+    import serial
+
+    parser = argparse.ArgumentParser(description="Stream a G-code file with the advanced ok")
+    parser.add_argument('port', help='serial port of the printer')
+    parser.add_argument('file', help='G-code file to print')
+    parser.add_argument('-b', '--baudrate', type=int, default=115200, help='baudrate (default 115200)')
+    args = parser.parse_args()
+
+    ser = serial.Serial(args.port, args.baudrate, timeout=10)
+    readline = lambda: ser.readline().decode(errors='replace').strip()
+    time.sleep(2)  # the board resets when the port is opened
+    ser.reset_input_buffer()
+
+    # Turn on the advanced ok
+    ser.write(b"M124 S1\n")
+    while not readline().startswith("ok"):
+        pass
+
+    # Reset the line numbers, only the M110 is queued when its ok is sent
+    ser.write(numbered(0, "M110"))
+    bufsize = None
+    while bufsize is None:
+        reply = readline()
+        if reply.startswith("ok"):
+            bufsize = ok_field(reply, 'B') + 1
+
+    gcode = read_gcode(args.file)
+    streamer = Streamer(gcode, ser.write, bufsize)
+    start = time.time()
+    while not streamer.done():
+        streamer.fill()
+        reply = readline()
+        if reply:
+            streamer.handle(reply)
+        else:
+            streamer.timeout()
+
+    print("%d lines in %.1f s, command buffer %d" % (len(gcode), time.time() - start, bufsize))
+    if streamer.min_planner is not None:
+        print("fewest free planner blocks: %d" % streamer.min_planner)
+    ser.close()
+
+
+if __name__ == '__main__':
+    main()
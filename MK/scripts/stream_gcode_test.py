@@ -0,0 +1,232 @@
+#!/usr/bin/python3
+
+# Host test of stream_gcode.py against a model of the firmware command queue
+#
+# The model is a port of get_serial_commands(), gcode_line_error(),
+# FlushSerialRequestResend() and ok_to_send() of MK_Main.cpp: a receive buffer
+# of RX_BUFFER_SIZE - 1 bytes, BUFSIZE queue slots with their send_ok flags,
+# the line number and checksum checks, and the flush and Resend on an error.
+# The serial wire moves the bytes at the baudrate, and each command takes its
+# execution time before its ok.
+#
+#  - After each ok the host refills to exactly BUFSIZE lines held by the
+#    firmware (queue, receive buffer and wire), never more. Fewer only when
+#    the next line would not fit the receive buffer, as with long lines or
+#    a large BUFSIZE. Without errors the receive buffer never overflows.
+#  - Corrupted bytes on the wire: every line runs once and in order, the
+#    Resends are answered without waiting for an ok after them. The lines
+#    sent after a bad one may still overflow the receive buffer, the next
+#    Resend recovers them.
+#
+# usage: stream_gcode_test.py [-B 4] [-l 2000] [-s 1]
+#        exits with 1 when a check fails
+
+import argparse
+import os
+import random
+import sys
+from collections import deque
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from stream_gcode import Streamer, numbered, ok_field, RX_BUFFER_SIZE
+
+BLOCK_BUFFER_SIZE = 16
+BAUDRATE = 115200
+TICK = 1e-4  # s
+
+parser = argparse.ArgumentParser(description="ADVANCED_OK streaming against a model of the firmware queue")
+parser.add_argument('-B', '--bufsize', type=int, default=4, help='BUFSIZE of the firmware (default 4)')
+parser.add_argument('-l', '--lines', type=int, default=2000, help='lines of each G-code file (default 2000)')
+parser.add_argument('-s', '--seed', type=int, default=1, help='random seed (default 1)')
+args = parser.parse_args()
+
+
+# strtol(s, NULL, 10) of the leading digits
+def strtol(s):
+    digits = ""
+    for char in s.lstrip():
+        if not char.isdigit():
+            break
+        digits += char
+    return int(digits) if digits else 0
+
+
+class Firmware:
+    def __init__(self, bufsize, rng, corrupt=0.0):
+        self.bufsize = bufsize
+        self.rng = rng
+        self.corrupt = corrupt
+        self.wire = deque()          # bytes on the way to the receive buffer
+        self.rx = deque()
+        self.rx_overflows = 0
+        self.line = bytearray()      # serial_line_buffer
+        self.queue = [""] * bufsize  # command_queue
+        self.send_ok = [True] * bufsize
+        self.r = self.w = self.count = 0
+        self.last_n = 0
+        self.busy_until = None       # end of the command being executed
+        self.replies = deque()
+        self.executed = []           # line numbers in the order they ran
+
+    def write(self, data):
+        data = bytearray(data)
+        if self.rng.random() < self.corrupt:
+            i = self.rng.randrange(len(data) - 1)  # not the newline
+            data[i] = ord('#') if data[i] != ord('#') else ord('%')
+        self.wire.extend(data)
+
+    def ok_to_send(self):
+        if not self.send_ok[self.r]:
+            return
+        reply, cmd = "ok", self.queue[self.r]
+        if cmd.startswith('N'):
+            reply += " " + cmd.split()[0]
+        self.replies.append("%s P%d B%d" % (reply, BLOCK_BUFFER_SIZE - 1, self.bufsize - self.count))
+
+    def line_error(self, err, flush=True):
+        self.replies.append("Error:%s%d" % (err, self.last_n))
+        if flush:
+            self.rx.clear()
+            self.replies.append("Resend:%d" % (self.last_n + 1))
+            self.ok_to_send()
+        self.line = bytearray()
+
+    def parse(self, command):
+        if command.startswith('N'):
+            n = strtol(command[1:])
+            m110 = "M110" in command
+            if n != self.last_n + 1 and not m110:
+                return self.line_error("Line Number is not Last Line Number+1, Last Line: ")
+            if '*' not in command:
+                return self.line_error("No Checksum with line number, Last Line: ")
+            body, checksum = command.rsplit('*', 1)
+            value = 0
+            for char in body:
+                value ^= ord(char)
+            if strtol(checksum) != value:
+                return self.line_error("checksum mismatch, Last Line: ")
+            self.last_n = n
+        elif '*' in command:
+            return self.line_error("No Line Number with checksum, Last Line: ", False)
+        self.queue[self.w] = command
+        self.send_ok[self.w] = True
+        self.w = (self.w + 1) % self.bufsize
+        self.count += 1
+
+    def get_serial_commands(self):
+        while self.rx and self.count < self.bufsize:
+            char = self.rx.popleft()
+            if char in b"\n\r":
+                if self.line:
+                    command = self.line.decode(errors='replace').strip()
+                    self.line = bytearray()
+                    self.parse(command)
+                    if self.replies and self.replies[-1].startswith("Resend"):
+                        return
+            else:
+                self.line.append(char)
+
+    def step(self, now):
+        for i in range(min(len(self.wire), int(BAUDRATE / 10 * TICK + 0.5))):
+            char = self.wire.popleft()
+            if len(self.rx) < RX_BUFFER_SIZE - 1:
+                self.rx.append(char)
+            else:
+                self.rx_overflows += 1
+        if self.busy_until is not None:
+            if now < self.busy_until:
+                return
+            # process_next_command() done: ok, then the slot is freed
+            cmd = self.queue[self.r]
+            if cmd.startswith('N') and "M110" not in cmd:
+                self.executed.append(strtol(cmd[1:]))
+            self.ok_to_send()
+            self.count -= 1
+            self.r = (self.r + 1) % self.bufsize
+            self.busy_until = None
+        if self.count < self.bufsize:
+            self.get_serial_commands()
+        if self.count:
+            self.busy_until = now + self.rng.choice((0.0002, 0.001, 0.004, 0.02))
+
+
+def run(name, gcode, corrupt):
+    rng = random.Random(args.seed)
+    fw = Firmware(args.bufsize, rng)
+    sent = []
+
+    def write(data):
+        sent.append(data)
+        fw.write(data)
+
+    # M110, its ok gives the free slots
+    write(numbered(0, "M110"))
+    now, bufsize = 0.0, None
+    while bufsize is None:
+        fw.step(now)
+        now += TICK
+        while fw.replies:
+            reply = fw.replies.popleft()
+            if reply.startswith("ok"):
+                bufsize = ok_field(reply, 'B') + 1
+
+    fw.corrupt = corrupt
+    errors = []
+    streamer = Streamer(gcode, write, bufsize, echo=errors.append)
+    ok = bufsize == args.bufsize
+    worst, refills, full, limited, short, resends, idle = 0, 0, 0, 0, 0, 0, 0.0
+    streamer.fill()
+    while not streamer.done() and now < 3600:
+        fw.step(now)
+        now += TICK
+        if not fw.replies:
+            idle += TICK
+            if idle >= 1.0:
+                streamer.timeout()
+                streamer.fill()
+                idle = 0.0
+            continue
+        idle = 0.0
+        while fw.replies:
+            reply = fw.replies.popleft()
+            resends += reply.startswith("Resend")
+            streamer.handle(reply)
+        streamer.fill()
+        # Lines the firmware still has to answer: without errors each line
+        # is written once and answered when it has run
+        held = len(streamer.in_flight) if corrupt else len(sent) - 1 - len(fw.executed)
+        worst = max(worst, held)
+        if streamer.next_line < len(gcode):
+            refills += 1
+            if held == bufsize:
+                full += 1
+            else:
+                # Only the receive buffer may hold the next line back
+                waiting = sum(len(d) for n, d in list(streamer.in_flight)[1:])
+                data = numbered(streamer.next_line + 1, gcode[streamer.next_line])
+                if waiting + len(data) >= RX_BUFFER_SIZE:
+                    limited += 1
+                else:
+                    short += 1
+
+    done = streamer.done() and fw.executed == list(range(1, len(gcode) + 1))
+    ok &= done and worst <= bufsize
+    if not corrupt:
+        ok &= short == 0 and fw.rx_overflows == 0
+    print("%-20s %5d lines %6.1f s  in flight max %d, after %4d refills: %4d full %4d rx limited %3d short,"
+          " %3d resends, %3d rx overflows  %s"
+          % (name, len(gcode), now, worst, refills, full, limited, short, resends, fw.rx_overflows, "ok" if ok else "FAIL"))
+    return ok
+
+
+rng = random.Random(args.seed)
+short_lines = ["G1 X%d Y%d" % (rng.randrange(200), rng.randrange(200)) for i in range(args.lines)]
+long_lines = ["G1 X%.3f Y%.3f Z%.3f E%.5f F%d" % (rng.uniform(0, 200), rng.uniform(0, 200), rng.uniform(0, 200),
+                                                  rng.uniform(0, 1000), rng.randrange(1000, 9000)) for i in range(args.lines)]
+
+ok = run("short lines", short_lines, 0.0)
+ok &= run("long lines", long_lines, 0.0)
+ok &= run("short lines, errors", short_lines, 0.02)
+ok &= run("long lines, errors", long_lines, 0.02)
+
+sys.exit(0 if ok else 1)
@@ -71,6 +71,9 @@
     #define MKSERIAL MKSerial
   #else
     #define MKSERIAL Serial
+    #if ENABLED(EMERGENCY_PARSER)
+      #error CONFLICT ERROR: EMERGENCY_PARSER needs the MK serial, it is not available with EXTERNALSERIAL
+    #endif
   #endif
 
   #define PACK
@@ -29,8 +29,63 @@
     ring_buffer rx_buffer  =  { { 0 }, 0, 0 };
   #endif
 
+  #if ENABLED(EMERGENCY_PARSER)
+
+    enum EmergencyParserState {
+      EP_RESET,   // Start of a line
+      EP_N,       // Line number
+      EP_M,
+      EP_M1,
+      EP_M10,
+      EP_M11,
+      EP_M4,
+      EP_M41,
+      EP_M108,
+      EP_M112,
+      EP_M410,
+      EP_IGNORE   // Up to the end of the line
+    };
+
+    /**
+     * Follow the received characters to act on M108, M112 and M410
+     * at once, without waiting for room in the command buffer.
+     * M112 and M410 are done by idle(): kill() and quick_stop()
+     * can't run in an interrupt.
+     */
+    FORCE_INLINE void emergency_parser(const unsigned char c) {
+      static EmergencyParserState state = EP_RESET;
+
+      if (c == '\n' || c == '\r' || c == ' ' || c == '*' || c == ';') {
+        switch (state) {
+          case EP_M108: wait_for_heatup = false; break;
+          case EP_M112: emergency_kill = true; break;
+          case EP_M410: emergency_stop = true; break;
+          default: break;
+        }
+        if (c == '\n' || c == '\r')
+          state = EP_RESET;
+        else if (c != ' ' || state > EP_M)
+          state = EP_IGNORE;
+        return;
+      }
+
+      switch (state) {
+        case EP_RESET: state = c == 'N' ? EP_N : c == 'M' ? EP_M : EP_IGNORE; break;
+        case EP_N:     if (!NUMERIC_SIGNED(c)) state = c == 'M' ? EP_M : EP_IGNORE; break;
+        case EP_M:     state = c == '1' ? EP_M1 : c == '4' ? EP_M4 : EP_IGNORE; break;
+        case EP_M1:    state = c == '0' ? EP_M10 : c == '1' ? EP_M11 : EP_IGNORE; break;
+        case EP_M10:   state = c == '8' ? EP_M108 : EP_IGNORE; break;
+        case EP_M11:   state = c == '2' ? EP_M112 : EP_IGNORE; break;
+        case EP_M4:    state = c == '1' ? EP_M41 : EP_IGNORE; break;
+        case EP_M41:   state = c == '0' ? EP_M410 : EP_IGNORE; break;
+        default:       state = EP_IGNORE; break;
+      }
+    }
+
+  #endif // EMERGENCY_PARSER
+
   FORCE_INLINE void store_char(unsigned char c) {
-    int i = (unsigned int)(rx_buffer.head + 1) % RX_BUFFER_SIZE;
+    const uint8_t i = (rx_buffer.head + 1) % RX_BUFFER_SIZE;
     if (i != rx_buffer.tail) {
       rx_buffer.buffer[rx_buffer.head] = c;
       rx_buffer.head = i;
@@ -40,10 +95,69 @@
   #if defined(M_USARTx_RX_vect)
     SIGNAL(M_USARTx_RX_vect) {
       unsigned char c  =  M_UDRx;
+      #if ENABLED(EMERGENCY_PARSER)
+        emergency_parser(c);
+      #endif
       store_char(c);
     }
   #endif
 
+  #if TX_BUFFER_SIZE > 0
+
+    tx_ring_buffer tx_buffer = { { 0 }, 0, 0 };
+
+    // Send the next buffered character, the interrupt is disabled once the buffer is empty
+    FORCE_INLINE void tx_udr_empty_irq(void) {
+      M_UDRx = tx_buffer.buffer[tx_buffer.tail];
+      tx_buffer.tail = (tx_buffer.tail + 1) & (TX_BUFFER_SIZE - 1);
+      if (tx_buffer.head == tx_buffer.tail) clear_bit(M_UCSRxB, M_UDRIEx);
+    }
+
+    #if defined(M_USARTx_UDRE_vect)
+      SIGNAL(M_USARTx_UDRE_vect) {
+        tx_udr_empty_irq();
+      }
+    #endif
+
+    /**
+     * Reserve the slot and store the character in one critical section,
+     * so a write() from an interrupt can't take the same slot.
+     * When the buffer is full, send the oldest character from here:
+     * the interrupt can't run with interrupts off or inside another one.
+     */
+    void MKHardwareSerial::write(uint8_t c) {
+      for (;;) {
+        CRITICAL_SECTION_START;
+          // Nothing buffered and the data register is free: send it at once
+          if (tx_buffer.head == tx_buffer.tail && TEST(M_UCSRxA, M_UDREx)) {
+            M_UDRx = c;
+            CRITICAL_SECTION_END;
+            return;
+          }
+
+          const uint8_t i = (tx_buffer.head + 1) & (TX_BUFFER_SIZE - 1);
+          if (i != tx_buffer.tail) {
+            tx_buffer.buffer[tx_buffer.head] = c;
+            tx_buffer.head = i;
+            set_bit(M_UCSRxB, M_UDRIEx);
+            CRITICAL_SECTION_END;
+            return;
+          }
+
+          if (TEST(M_UCSRxA, M_UDREx)) tx_udr_empty_irq();
+        CRITICAL_SECTION_END;
+      }
+    }
+
+    // Wait until every buffered character is sent
+    void MKHardwareSerial::flushTX(void) {
+      while (tx_buffer.head != tx_buffer.tail) {
+        if (!TEST(SREG, SREG_I) && TEST(M_UCSRxA, M_UDREx)) tx_udr_empty_irq();
+      }
+    }
+
+  #endif // TX_BUFFER_SIZE > 0
+
   // Constructors
   MKHardwareSerial::MKHardwareSerial() { }
 
@@ -77,6 +191,7 @@
   }
 
   void MKHardwareSerial::end() {
+    flushTX();
     clear_bit(M_UCSRxB, M_RXENx);
     clear_bit(M_UCSRxB, M_TXENx);
     clear_bit(M_UCSRxB, M_RXCIEx);
@@ -97,7 +212,7 @@
     }
     else {
       unsigned char c = rx_buffer.buffer[rx_buffer.tail];
-      rx_buffer.tail = (unsigned int)(rx_buffer.tail + 1) % RX_BUFFER_SIZE;
+      rx_buffer.tail = (rx_buffer.tail + 1) % RX_BUFFER_SIZE;
       return c;
     }
   }
@@ -69,12 +69,14 @@
   #define M_RXENx SERIAL_REGNAME(RXEN,SERIAL_PORT,)    
   #define M_TXENx SERIAL_REGNAME(TXEN,SERIAL_PORT,)    
   #define M_RXCIEx SERIAL_REGNAME(RXCIE,SERIAL_PORT,)    
+  #define M_UDRIEx SERIAL_REGNAME(UDRIE,SERIAL_PORT,)
   #define M_UDREx SERIAL_REGNAME(UDRE,SERIAL_PORT,)    
   #define M_UDRx SERIAL_REGNAME(UDR,SERIAL_PORT,)  
   #define M_UBRRxH SERIAL_REGNAME(UBRR,SERIAL_PORT,H)
   #define M_UBRRxL SERIAL_REGNAME(UBRR,SERIAL_PORT,L)
   #define M_RXCx SERIAL_REGNAME(RXC,SERIAL_PORT,)
   #define M_USARTx_RX_vect SERIAL_REGNAME(USART,SERIAL_PORT,_RX_vect)
+  #define M_USARTx_UDRE_vect SERIAL_REGNAME(USART,SERIAL_PORT,_UDRE_vect)
   #define M_U2Xx SERIAL_REGNAME(U2X,SERIAL_PORT,)
 
   #define DEC 10
@@ -85,16 +87,28 @@
 
   #define RX_BUFFER_SIZE 128
 
+  // Filled by the RX interrupt. Single byte indexes keep head and tail atomic.
   struct ring_buffer {
     unsigned char buffer[RX_BUFFER_SIZE];
-    int head;
-    int tail;
+    volatile uint8_t head;
+    volatile uint8_t tail;
   };
 
   #if UART_PRESENT(SERIAL_PORT)
     extern ring_buffer rx_buffer;
   #endif
 
+  #if TX_BUFFER_SIZE > 0
+    // Emptied by the data register empty interrupt
+    struct tx_ring_buffer {
+      unsigned char buffer[TX_BUFFER_SIZE];
+      volatile uint8_t head;
+      volatile uint8_t tail;
+    };
+
+    extern tx_ring_buffer tx_buffer;
+  #endif
+
   class MKHardwareSerial {
     public:
       MKHardwareSerial();
@@ -108,21 +122,16 @@
         return (unsigned int)(RX_BUFFER_SIZE + rx_buffer.head - rx_buffer.tail) % RX_BUFFER_SIZE;
       }
 
-      FORCE_INLINE void write(uint8_t c) {
-        while (!TEST(M_UCSRxA, M_UDREx));
-        M_UDRx = c;
-      }
-
-      FORCE_INLINE void checkRx(void) {
-        if (TEST(M_UCSRxA, M_RXCx)) {
-          unsigned char c  =  M_UDRx;
-          int i = (unsigned int)(rx_buffer.head + 1) % RX_BUFFER_SIZE;
-          if (i != rx_buffer.tail) {
-            rx_buffer.buffer[rx_buffer.head] = c;
-            rx_buffer.head = i;
-          }
+      #if TX_BUFFER_SIZE > 0
+        void write(uint8_t c);
+        void flushTX(void);
+      #else
+        FORCE_INLINE void write(uint8_t c) {
+          while (!TEST(M_UCSRxA, M_UDREx));
+          M_UDRx = c;
         }
-      }
+        FORCE_INLINE void flushTX(void) { }
+      #endif
 
     private:
       void printNumber(unsigned long, uint8_t);
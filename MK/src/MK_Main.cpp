@@ -123,6 +123,10 @@ static bool relative_mode = false;
 static bool home_all_axis = true;
 
 volatile bool wait_for_heatup = true;
+#if ENABLED(EMERGENCY_PARSER)
+  volatile bool emergency_kill = false, // M112 received by the serial interrupt
+                emergency_stop = false; // M410 received by the serial interrupt
+#endif
 
 static int serial_count = 0;
 
@@ -216,6 +220,7 @@ bool software_endstops = true;
 
 #if MECH(DELTA)
   float delta[3];
+  float delta_cartesian_z = 0; // Logical Z of the last inverse_kinematics
   float cartesian_position[3] = { 0 };
   float endstop_adj[3] = { 0 };
   float diagrod_adj[3] = { 0 };
@@ -298,10 +303,23 @@ bool software_endstops = true;
   #if MIXING_VIRTUAL_TOOLS  > 1
     float mixing_virtual_tool_mix[MIXING_VIRTUAL_TOOLS][DRIVER_EXTRUDERS];
   #endif
+  #if ENABLED(MIXING_GRADIENT)
+    struct MixGradient {
+      float start, end;                 // Z height or filament fed (mm)
+      uint8_t start_vtool, end_vtool;   // Virtual tools with the mix at start and end
+      bool by_e;                        // Over the filament fed instead of Z
+    };
+    static MixGradient mixing_gradient[MIXING_GRADIENTS];
+    static int8_t mixing_gradient_active = -1;  // The gradient program in use, -1 for the fixed mix
+    static float mixing_gradient_e = 0.0,       // Filament fed since the gradient started
+                 mixing_gradient_factor[DRIVER_EXTRUDERS];
+  #endif
 #endif
 
 #if ENABLED(SDSUPPORT)
   static bool fromsd[BUFSIZE];
+  static uint32_t cmd_sdpos[BUFSIZE];   // SD file position of each queued command
+  uint32_t command_sdpos = 0;           // SD file position of the last SD command processed
 #endif
 
 #if ENABLED(IDLE_OOZING_PREVENT)
@@ -328,6 +346,10 @@ bool software_endstops = true;
 
 static bool send_ok[BUFSIZE];
 
+#if ENABLED(ADVANCED_OK)
+  static bool advanced_ok = true; // Set with M124
+#endif
+
 #if HAS(SERVOS)
   Servo servo[NUM_SERVOS];
   #define MOVE_SERVO(I, P) servo[I].move(P)
@@ -356,6 +378,16 @@ static bool send_ok[BUFSIZE];
   #define KEEPALIVE_STATE(n) ;
 #endif // HOST_KEEPALIVE_FEATURE
 
+#if ENABLED(AUTO_REPORT_TEMPERATURES)
+  static uint8_t auto_report_temp_interval = 0;   // Seconds, 0 = off. Set with M155.
+  static millis_t next_temp_report_ms = 0;
+#endif
+
+#if ENABLED(AUTO_REPORT_POSITION)
+  static uint8_t auto_report_pos_interval = 0;    // Seconds, 0 = off. Set with M154.
+  static millis_t next_pos_report_ms = 0;
+#endif
+
 /**
  * ***************************************************************************
  * ******************************** FUNCTIONS ********************************
@@ -368,6 +400,9 @@ void get_available_commands();
 void process_next_command();
 void prepare_move_to_destination();
 void set_current_from_steppers_for_axis(AxisEnum axis);
+#if MECH(DELTA)
+  void set_cartesian_from_steppers();
+#endif
 
 #if MECH(DELTA) || MECH(SCARA)
   inline void sync_plan_position_delta();
@@ -389,6 +424,11 @@ void safe_delay(millis_t ms) {
 void tool_change(const uint8_t tmp_extruder, const float fr_mm_m = 0.0, bool no_move = false);
 static void report_current_position();
 
+#if ENABLED(IDLE_SCHEDULER)
+  void idle_stats_reset();
+  void idle_stats_report();
+#endif
+
 // PRINT XYZ for DEBUG
 void print_xyz(const char* prefix, const char* suffix, const float x, const float y, const float z) {
   ECHO_PS(prefix);
@@ -504,6 +544,9 @@ inline void _commit_command(bool say_ok) {
 inline bool _enqueuecommand(const char* cmd, bool say_ok = false) {
   if (*cmd == ';' || commands_in_queue >= BUFSIZE) return false;
   strcpy(command_queue[cmd_queue_index_w], cmd);
+  #if ENABLED(SDSUPPORT)
+    fromsd[cmd_queue_index_w] = false;
+  #endif
   _commit_command(say_ok);
   return true;
 }
@@ -846,8 +889,10 @@ void loop() {
           ok_to_send();
         }
       }
-      else
+      else {
+        if (fromsd[cmd_queue_index_r]) command_sdpos = cmd_sdpos[cmd_queue_index_r];
         process_next_command();
+      }
 
     #else
 
@@ -971,9 +1016,11 @@ inline void get_serial_commands() {
       }
 
       // If command was e-stop process now
-      if (strcmp(command, "M108") == 0) wait_for_heatup = false;
-      if (strcmp(command, "M112") == 0) kill(PSTR(MSG_KILLED));
-      if (strcmp(command, "M410") == 0) { quickstop_stepper(); }
+      #if DISABLED(EMERGENCY_PARSER)
+        if (strcmp(command, "M108") == 0) wait_for_heatup = false;
+        if (strcmp(command, "M112") == 0) kill(PSTR(MSG_KILLED));
+        if (strcmp(command, "M410") == 0) { quickstop_stepper(); }
+      #endif
 
       #if defined(NO_TIMEOUTS) && NO_TIMEOUTS > 0
         last_command_time = ms;
@@ -1001,6 +1048,31 @@ inline void get_serial_commands() {
   } // queue has space, serial has data
 }
 
+#if ENABLED(POWER_LOSS_RECOVERY) || ENABLED(AUTO_REPORT_POSITION)
+  /**
+   * Logical XYZE position of the steppers, where the moves really are.
+   * current_position is the end of the last planned move instead.
+   */
+  void get_stepper_position(float pos[NUM_AXIS]) {
+    #if MECH(DELTA)
+      set_cartesian_from_steppers();
+      LOOP_XYZ(i) pos[i] = LOGICAL_POSITION(cartesian_position[i], i);
+    #elif MECH(SCARA)
+      // delta[] holds the segment the planner may be waiting to queue
+      float planned_delta[3], angles[3] = { st_get_axis_position_mm(X_AXIS), st_get_axis_position_mm(Y_AXIS), 0 };
+      LOOP_XYZ(i) planned_delta[i] = delta[i];
+      forward_kinematics_SCARA(angles);
+      pos[X_AXIS] = LOGICAL_X_POSITION(delta[X_AXIS] / axis_scaling[X_AXIS]);
+      pos[Y_AXIS] = LOGICAL_Y_POSITION(delta[Y_AXIS] / axis_scaling[Y_AXIS]);
+      pos[Z_AXIS] = LOGICAL_Z_POSITION(st_get_axis_position_mm(Z_AXIS));
+      LOOP_XYZ(i) delta[i] = planned_delta[i];
+    #else
+      LOOP_XYZ(i) pos[i] = LOGICAL_POSITION(st_get_axis_position_mm((AxisEnum)i), i);
+    #endif
+    pos[E_AXIS] = st_get_position(E_AXIS) / planner.axis_steps_per_mm[E_AXIS + active_extruder];
+  }
+#endif
+
 #if ENABLED(SDSUPPORT)
   inline void get_sdcard_commands() {
     static bool stop_buffering = false,
@@ -1044,6 +1116,7 @@ inline void get_serial_commands() {
         command_queue[cmd_queue_index_w][sd_count] = '\0'; // terminate string
         sd_count = 0; // clear buffer
 
+        fromsd[cmd_queue_index_w] = true;
         _commit_command(false);
       }
       else if (sd_count >= MAX_CMD_SIZE - 1) {
@@ -1054,10 +1127,64 @@ inline void get_serial_commands() {
       }
       else {
         if (sd_char == ';') sd_comment_mode = true;
-        if (!sd_comment_mode) command_queue[cmd_queue_index_w][sd_count++] = sd_char;
+        if (!sd_comment_mode) {
+          if (!sd_count) cmd_sdpos[cmd_queue_index_w] = card.sdpos;
+          command_queue[cmd_queue_index_w][sd_count++] = sd_char;
+        }
       }
     }
   }
+
+  /**
+   * Fill a resume point with the state needed to restart the SD print.
+   *
+   *  stepper_pos = false: planned position and first SD command not yet processed,
+   *                       for a controlled stop from the running command (M33).
+   *  stepper_pos = true:  position of the steppers and the command of the block
+   *                       being executed, for the power-loss journal.
+   */
+  void get_resume_point(resume_point_t &rp, const bool stepper_pos) {
+    memset(&rp, 0, sizeof(rp));
+    rp.version = RESUME_POINT_VERSION;
+
+    bool found = false;
+
+    #if ENABLED(POWER_LOSS_RECOVERY)
+      if (stepper_pos) {
+        CRITICAL_SECTION_START;
+        if (planner.blocks_queued()) {
+          rp.sdpos = planner.block_buffer[planner.block_buffer_tail].sdpos;
+          found = true;
+        }
+        CRITICAL_SECTION_END;
+      }
+    #endif
+
+    // The running command is already done when called from the command itself
+    for (uint8_t i = stepper_pos ? 0 : 1, r = (cmd_queue_index_r + i) % BUFSIZE; !found && i < commands_in_queue; i++, r = (r + 1) % BUFSIZE) {
+      if (fromsd[r]) {
+        rp.sdpos = cmd_sdpos[r];
+        found = true;
+      }
+    }
+    if (!found) rp.sdpos = card.sdpos;
+
+    #if ENABLED(POWER_LOSS_RECOVERY)
+      if (stepper_pos) {
+        // The position of the steppers, somewhere in the move of the command at sdpos
+        get_stepper_position(rp.position);
+      }
+      else
+    #endif
+        LOOP_XYZE(i) rp.position[i] = current_position[i];
+
+    rp.feedrate_mm_m = feedrate_mm_m;
+    for (uint8_t h = 0; h < HOTENDS; h++) rp.target_temperature[h] = degTargetHotend(h);
+    rp.target_temperature_bed = degTargetBed();
+    rp.fan_speed = fanSpeed;
+    rp.active_extruder = active_extruder;
+    rp.relative_e = axis_relative_modes[E_AXIS];
+  }
 #endif // SDSUPPORT
 
 /**
@@ -1250,9 +1377,18 @@ XYZ_CONSTS_FROM_CONFIG(signed char, home_dir,  HOME_DIR);
   #define DXC_FULL_CONTROL_MODE 0
   #define DXC_AUTO_PARK_MODE    1
   #define DXC_DUPLICATION_MODE  2
+  #define DXC_MIRRORED_MODE     3
+
+  // Space X2 needs from X1, the parked X1 is at X_MIN_POS
+  #define DXC_CARRIAGE_GAP (X2_MIN_POS - X_MIN_POS)
 
   static int dual_x_carriage_mode = DEFAULT_DUAL_X_CARRIAGE_MODE;
 
+  // Both carriages print, the second copies or mirrors the first
+  inline bool dxc_is_duplicating() {
+    return dual_x_carriage_mode == DXC_DUPLICATION_MODE || dual_x_carriage_mode == DXC_MIRRORED_MODE;
+  }
+
   static float x_home_pos(int extruder) {
     if (extruder == 0)
       return base_home_pos(X_AXIS) + home_offset[X_AXIS];
@@ -1273,8 +1409,10 @@ XYZ_CONSTS_FROM_CONFIG(signed char, home_dir,  HOME_DIR);
   static float raised_parked_position[NUM_AXIS]; // used in mode 1
   static millis_t delayed_move_time = 0; // used in mode 1
   static float duplicate_hotend_x_offset = DEFAULT_DUPLICATION_X_OFFSET; // used in mode 2
-  static float duplicate_hotend_temp_offset = 0; // used in mode 2
-  bool hotend_duplication_enabled = false; // used in mode 2
+  static float duplicate_hotend_temp_offset = 0; // used in mode 2 & 3
+  static float mirror_hotend_x_center = (X_MIN_POS + X2_MAX_POS) * 0.5; // used in mode 3
+  bool hotend_duplication_enabled = false; // used in mode 2 & 3
+  bool hotend_mirror_enabled = false; // used in mode 3
 
 #endif //DUAL_X_CARRIAGE
 
@@ -1304,6 +1442,12 @@ static void update_software_endstops(AxisEnum axis) {
         sw_endstop_max[X_AXIS] = min(base_max_pos(X_AXIS), dual_max_x - duplicate_hotend_x_offset) + offs;
         return;
       }
+      else if (dual_x_carriage_mode == DXC_MIRRORED_MODE) {
+        // X2 is at 2 * center - X1: keep it in its travel and the carriages apart
+        sw_endstop_min[X_AXIS] = max(base_min_pos(X_AXIS), 2 * mirror_hotend_x_center - dual_max_x) + offs;
+        sw_endstop_max[X_AXIS] = min(base_max_pos(X_AXIS), mirror_hotend_x_center - (DXC_CARRIAGE_GAP) * 0.5) + offs;
+        return;
+      }
     }
     else
   #endif
@@ -1356,7 +1500,7 @@ static void set_axis_is_at_home(AxisEnum axis) {
   position_shift[axis] = 0;
 
   #if ENABLED(DUAL_X_CARRIAGE)
-    if (axis == X_AXIS && (active_extruder != 0 || dual_x_carriage_mode == DXC_DUPLICATION_MODE)) {
+    if (axis == X_AXIS && (active_extruder != 0 || dxc_is_duplicating())) {
       if (active_extruder != 0)
         current_position[X_AXIS] = x_home_pos(active_extruder);
       else
@@ -1487,6 +1631,23 @@ inline void sync_plan_position() {
   #define SYNC_PLAN_POSITION_KINEMATIC() sync_plan_position()
 #endif
 
+#if ENABLED(PLANNED_TOOL_OFFSET)
+  /**
+   * shift_plan_position
+   * Set the planner to the current_position like SYNC_PLAN_POSITION_KINEMATIC,
+   * without waiting for the moves in flight. The steppers follow on the next move.
+   */
+  inline void shift_plan_position() {
+    if (DEBUGGING(INFO)) DEBUG_INFO_POS("shift_plan_position", current_position);
+    #if MECH(DELTA) || MECH(SCARA)
+      inverse_kinematics(current_position);
+      planner.shift_position_mm(delta[TOWER_1], delta[TOWER_2], delta[TOWER_3], current_position[E_AXIS]);
+    #else
+      planner.shift_position_mm(current_position[X_AXIS], current_position[Y_AXIS], current_position[Z_AXIS], current_position[E_AXIS]);
+    #endif
+  }
+#endif
+
 inline void sync_plan_position_e() { planner.set_e_position_mm(current_position[E_AXIS]); }
 inline void set_current_to_destination() { memcpy(current_position, destination, sizeof(current_position)); }
 inline void set_destination_to_current() { memcpy(destination, current_position, sizeof(destination)); }
@@ -2266,6 +2427,8 @@ void do_blocking_move_to_z(float z, float fr_mm_m/*=0.0*/) {
                          - sq(delta_tower3_x - cartesian[X_AXIS])
                          - sq(delta_tower3_y - cartesian[Y_AXIS])
                          ) + cartesian[Z_AXIS];
+
+    delta_cartesian_z = in_cartesian[Z_AXIS];
   }
 
   float delta_safe_distance_from_top() {
@@ -3144,6 +3307,37 @@ void set_current_from_steppers_for_axis(AxisEnum axis) {
     }
     normalize_mix();
   }
+
+  #if ENABLED(MIXING_GRADIENT)
+    /**
+     * Mix factors for a new move, called by the planner.
+     * The active gradient blends its two virtual tools by the
+     * Z height of the move, or by the filament fed so far.
+     *
+     *   z      Z height of the move
+     *   e_mm   Filament fed by the move
+     *
+     * Without a gradient the fixed mix is returned.
+     */
+    const float* mixing_gradient_mix(const float &z, const float &e_mm) {
+      if (mixing_gradient_active < 0) return mixing_factor;
+
+      const MixGradient &g = mixing_gradient[mixing_gradient_active];
+      float pos = z;
+      if (g.by_e) {
+        if (e_mm > 0) mixing_gradient_e += e_mm;
+        pos = mixing_gradient_e;
+      }
+
+      float ratio = (pos - g.start) / (g.end - g.start);
+      ratio = constrain(ratio, 0.0, 1.0);
+      for (uint8_t i = 0; i < DRIVER_EXTRUDERS; i++) {
+        const float from = mixing_virtual_tool_mix[g.start_vtool][i];
+        mixing_gradient_factor[i] = from + (mixing_virtual_tool_mix[g.end_vtool][i] - from) * ratio;
+      }
+      return mixing_gradient_factor;
+    }
+  #endif
 #endif
 
 #if ENABLED(IDLE_OOZING_PREVENT)
@@ -3477,6 +3671,83 @@ inline void wait_heater(bool no_wait_for_cooling = true) {
   }
 #endif // HAS(TEMP_BED)
 
+#if ENABLED(DEFERRED_HEATUP_WAIT)
+  /**
+   * Pending waits of M109 and M190, one bit per hotend.
+   * They are done before the first command that needs the temperature.
+   */
+  static uint8_t heatup_wait_hotends = 0,
+                 heatup_wait_hotends_cooling = 0;  // Also wait for cooling (M109 R)
+  #if HAS(TEMP_BED)
+    static bool heatup_wait_bed = false,
+                heatup_wait_bed_cooling = false;   // Also wait for cooling (M190 R)
+  #endif
+
+  inline bool heatup_wait_pending() {
+    return heatup_wait_hotends
+      #if HAS(TEMP_BED)
+        || heatup_wait_bed
+      #endif
+    ;
+  }
+
+  void heatup_wait_cancel() {
+    heatup_wait_hotends = heatup_wait_hotends_cooling = 0;
+    #if HAS(TEMP_BED)
+      heatup_wait_bed = false;
+    #endif
+  }
+
+  // Do the pending waits, the bed first as it takes longer. M108 cancels them all.
+  void heatup_wait_finish() {
+    #if HAS(TEMP_BED)
+      if (heatup_wait_bed) {
+        heatup_wait_bed = false;
+        wait_bed(!heatup_wait_bed_cooling);
+        if (!wait_for_heatup) heatup_wait_hotends = 0;
+      }
+    #endif
+    const uint8_t old_target_extruder = target_extruder;
+    for (uint8_t h = 0; h < HOTENDS && heatup_wait_hotends; h++) {
+      if (TEST(heatup_wait_hotends, h)) {
+        target_extruder = h;
+        wait_heater(!TEST(heatup_wait_hotends_cooling, h));
+        if (!wait_for_heatup) break;
+      }
+    }
+    target_extruder = old_target_extruder;
+    heatup_wait_cancel();
+  }
+
+  /**
+   * Commands that don't depend on the temperature and can run while
+   * the heaters ramp up: travel moves, homing, probing, leveling,
+   * positioning modes, temperature and fan settings, reports.
+   * M108 is one of them, so a queued M108 cancels the pending waits
+   * instead of running them first.
+   */
+  static bool heatup_wait_deferrable(const char command_code, const uint16_t codenum) {
+    switch (command_code) {
+      case 'G': switch (codenum) {
+        case 0: case 1: case 2: case 3:
+          return !code_seen('E');
+        case 4: case 20: case 21: case 28: case 29: case 30: case 90: case 91: case 92:
+          return true;
+      }
+      break;
+
+      case 'M': switch (codenum) {
+        case 108: // Cancel the waits
+        case 17: case 82: case 83: case 104: case 105: case 106: case 107: case 109: case 110:
+        case 114: case 115: case 117: case 140: case 190: case 220: case 400:
+          return true;
+      }
+      break;
+    }
+    return false;
+  }
+#endif // DEFERRED_HEATUP_WAIT
+
 #if HAS(TEMP_CHAMBER)
   inline void wait_chamber(bool no_wait_for_heating = true) {
     #if TEMP_CHAMBER_RESIDENCY_TIME > 0
@@ -3634,7 +3905,7 @@ inline void wait_heater(bool no_wait_for_cooling = true) {
 
     #if ENABLED(DUAL_X_CARRIAGE)
       int x_axis_home_dir = x_home_dir(active_extruder);
-      extruder_duplication_enabled = false;
+      hotend_duplication_enabled = false;
     #else
       int x_axis_home_dir = home_dir(X_AXIS);
     #endif
@@ -3758,6 +4029,276 @@ void unknown_command_error() {
 
 #endif //HOST_KEEPALIVE_FEATURE
 
+#if ENABLED(AUTO_REPORT_TEMPERATURES) || ENABLED(AUTO_REPORT_POSITION)
+  /**
+   * Send the reports asked with M155 and M154, called by idle().
+   * One short line each, without "ok", so the host doesn't have to poll.
+   */
+  void auto_report() {
+    const millis_t ms = millis();
+
+    #if ENABLED(AUTO_REPORT_TEMPERATURES) && (HAS(TEMP_0) || HAS(TEMP_BED) || ENABLED(HEATER_0_USES_MAX6675))
+      if (auto_report_temp_interval && ELAPSED(ms, next_temp_report_ms)) {
+        next_temp_report_ms = ms + auto_report_temp_interval * 1000UL;
+        print_heaterstates();
+        ECHO_E;
+      }
+    #endif
+
+    #if ENABLED(AUTO_REPORT_POSITION)
+      if (auto_report_pos_interval && ELAPSED(ms, next_pos_report_ms)) {
+        next_pos_report_ms = ms + auto_report_pos_interval * 1000UL;
+        float pos[NUM_AXIS];
+        get_stepper_position(pos);
+        ECHO_MV( "X:", pos[X_AXIS], 2);
+        ECHO_MV(" Y:", pos[Y_AXIS], 2);
+        ECHO_MV(" Z:", pos[Z_AXIS], 2);
+        ECHO_EMV(" E:", pos[E_AXIS], 2);
+      }
+    #endif
+  }
+#endif
+
+#if ENABLED(TOOL_CHANGE_PREHEAT)
+
+  static int16_t toolchange_print_temp[HOTENDS] = { 0 };  // Target of each hotend before its standby
+  static float toolchange_exec_time = 0;                 // Estimated time of the processed moves (s)
+
+  // Estimated time of a move, the acceleration is ignored
+  static float toolchange_move_time(const float from[NUM_AXIS], const float to[NUM_AXIS], const float fr_mm_m) {
+    if (fr_mm_m <= 0) return 0;
+    float dx = to[X_AXIS] - from[X_AXIS],
+          dy = to[Y_AXIS] - from[Y_AXIS],
+          dz = to[Z_AXIS] - from[Z_AXIS],
+          length = sqrt(sq(dx) + sq(dy) + sq(dz));
+    if (length < 0.001) length = fabs(to[E_AXIS] - from[E_AXIS]);
+    return length * 60.0 / fr_mm_m;
+  }
+
+  #if ENABLED(ARC_SUPPORT) && NOMECH(SCARA)
+    // Estimated time of an arc, its length as plan_arc() measures it
+    static float toolchange_arc_time(const float from[NUM_AXIS], const float to[NUM_AXIS], const float offset[2], const bool clockwise, const float fr_mm_m) {
+      if (fr_mm_m <= 0) return 0;
+      float r_X = -offset[X_AXIS],
+            r_Y = -offset[Y_AXIS],
+            rt_X = to[X_AXIS] - from[X_AXIS] - offset[X_AXIS],
+            rt_Y = to[Y_AXIS] - from[Y_AXIS] - offset[Y_AXIS],
+            angular_travel = atan2(r_X * rt_Y - r_Y * rt_X, r_X * rt_X + r_Y * rt_Y);
+      if (angular_travel < 0) angular_travel += RADIANS(360);
+      if (clockwise) angular_travel -= RADIANS(360);
+      if (from[X_AXIS] == to[X_AXIS] && from[Y_AXIS] == to[Y_AXIS] && angular_travel == 0)
+        angular_travel += RADIANS(360);
+      return hypot(angular_travel * hypot(offset[X_AXIS], offset[Y_AXIS]), to[Z_AXIS] - from[Z_AXIS]) * 60.0 / fr_mm_m;
+    }
+  #endif
+
+  // Skip the spaces and the line number
+  static char* toolchange_command(char* cmd) {
+    while (*cmd == ' ') cmd++;
+    if (*cmd == 'N') {
+      while (*cmd && *cmd != ' ') cmd++;
+      while (*cmd == ' ') cmd++;
+    }
+    return cmd;
+  }
+
+  // Hotend selected by a T command, -1 for other commands
+  static int8_t toolchange_command_tool(char* cmd) {
+    cmd = toolchange_command(cmd);
+    return (*cmd == 'T' && NUMERIC(cmd[1])) ? atoi(cmd + 1) : -1;
+  }
+
+  // Bring a hotend back to the temperature it had before its standby
+  static void toolchange_preheat(const int8_t h) {
+    if (h < 0 || h >= HOTENDS || !toolchange_print_temp[h]) return;
+    if (toolchange_print_temp[h] > degTargetHotend(h))
+      setTargetHotend(toolchange_print_temp[h], h); // Also starts the heating watch, as for M104
+    toolchange_print_temp[h] = 0;
+  }
+
+  /**
+   * Forget the standby of the hotends: their targets were switched off,
+   * or the print is over. Called by disable_all_heaters() and at the end
+   * of the SD print.
+   */
+  void toolchange_preheat_reset() {
+    memset(toolchange_print_temp, 0, sizeof(toolchange_print_temp));
+  }
+
+  #if ENABLED(SDSUPPORT)
+
+    /**
+     * Look-ahead in the printed file. It borrows the file of the print,
+     * saving and restoring the position of both without a seek, and reads
+     * only while it is less than TOOL_PREHEAT_TIME ahead of the processed
+     * moves. It keeps its own position, feedrate and modes to estimate
+     * the time of the moves.
+     */
+    static FatPos_t toolchange_file_pos;
+    static bool toolchange_scanning = false,
+                toolchange_scan_relative,
+                toolchange_scan_relative_e,
+                toolchange_in_comment;
+    static uint32_t toolchange_last_sdpos = 0;
+    static float toolchange_scan_pos[NUM_AXIS],
+                 toolchange_scan_fr_mm_m,
+                 toolchange_scan_time;
+    static uint8_t toolchange_scan_tool,
+                   toolchange_pending[HOTENDS],           // T found by the look-ahead and not processed yet
+                   toolchange_line_len;
+    static char toolchange_line[MAX_CMD_SIZE];
+
+    static void toolchange_scan_start() {
+      card.file.getpos(&toolchange_file_pos);
+      memcpy(toolchange_scan_pos, current_position, sizeof(toolchange_scan_pos));
+      toolchange_scan_fr_mm_m = feedrate_mm_m;
+      toolchange_scan_relative = relative_mode;
+      toolchange_scan_relative_e = axis_relative_modes[E_AXIS];
+      toolchange_scan_time = toolchange_exec_time;
+      toolchange_scan_tool = active_extruder;
+      toolchange_line_len = 0;
+      toolchange_in_comment = false;
+      memset(toolchange_pending, 0, sizeof(toolchange_pending));
+      toolchange_scanning = true;
+    }
+
+    static void toolchange_scan_line() {
+      char* p = toolchange_command(toolchange_line);
+      const char letter = *p++;
+      if (!NUMERIC(*p)) return;
+      const int codenum = strtol(p, &p, 10);
+
+      if (letter == 'T') {
+        if (codenum < HOTENDS && codenum != toolchange_scan_tool) {
+          toolchange_scan_tool = codenum;
+          if (toolchange_pending[codenum] < 255) toolchange_pending[codenum]++;
+          toolchange_preheat(codenum);
+        }
+      }
+      else if (letter == 'G') {
+        switch (codenum) {
+          case 0: case 1: case 2: case 3: case 92: {
+            bool relative = toolchange_scan_relative, relative_e = toolchange_scan_relative_e;
+            #if ENABLED(SF_ARC_FIX)
+              if (codenum == 2 || codenum == 3) relative = relative_e = true;
+            #endif
+            float to[NUM_AXIS];
+            memcpy(to, toolchange_scan_pos, sizeof(to));
+            for (uint8_t i = X_AXIS; i <= E_AXIS; i++) {
+              char* v = strchr(p, axis_codes[i]);
+              if (v) to[i] = strtod(v + 1, NULL) + (codenum != 92 && (i == E_AXIS ? relative_e : relative) ? toolchange_scan_pos[i] : 0);
+            }
+            if (codenum != 92) {
+              char* f = strchr(p, 'F');
+              if (f) toolchange_scan_fr_mm_m = strtod(f + 1, NULL);
+              #if ENABLED(ARC_SUPPORT) && NOMECH(SCARA)
+                if (codenum == 2 || codenum == 3) {
+                  char *i = strchr(p, 'I'), *j = strchr(p, 'J');
+                  const float offset[2] = { i ? strtod(i + 1, NULL) : 0, j ? strtod(j + 1, NULL) : 0 };
+                  toolchange_scan_time += toolchange_arc_time(toolchange_scan_pos, to, offset, codenum == 2, toolchange_scan_fr_mm_m);
+                }
+                else
+              #endif
+                  toolchange_scan_time += toolchange_move_time(toolchange_scan_pos, to, toolchange_scan_fr_mm_m);
+            }
+            memcpy(toolchange_scan_pos, to, sizeof(to));
+          } break;
+          case 4: {
+            char *ms = strchr(p, 'P'), *sec = strchr(p, 'S');
+            if (sec) toolchange_scan_time += strtod(sec + 1, NULL);
+            else if (ms) toolchange_scan_time += strtod(ms + 1, NULL) / 1000.0;
+          } break;
+          case 90: toolchange_scan_relative = toolchange_scan_relative_e = false; break;
+          case 91: toolchange_scan_relative = toolchange_scan_relative_e = true; break;
+        }
+      }
+      else if (letter == 'M') {
+        if (codenum == 82) toolchange_scan_relative_e = false;
+        else if (codenum == 83) toolchange_scan_relative_e = true;
+      }
+    }
+
+    // Read up to 64 characters of the file per call
+    static void toolchange_scan_file() {
+      if (!card.sdprinting || !card.isFileOpen()) {
+        toolchange_scanning = false;
+        return;
+      }
+
+      // Restart after a new file, a jump in the file, or when overtaken by the print
+      if (!toolchange_scanning || card.sdpos < toolchange_last_sdpos || toolchange_file_pos.position < card.sdpos)
+        toolchange_scan_start();
+      toolchange_last_sdpos = card.sdpos;
+
+      if (toolchange_scan_time - toolchange_exec_time > TOOL_PREHEAT_TIME) return;
+
+      FatPos_t print_pos;
+      card.file.getpos(&print_pos);
+      card.file.setpos(&toolchange_file_pos);
+
+      for (uint8_t n = 64; n--;) {
+        if (toolchange_scan_time - toolchange_exec_time > TOOL_PREHEAT_TIME) break;
+        const int16_t c = card.file.read();
+        if (c < 0) break;
+        if (c == '\n' || c == '\r') {
+          toolchange_line[toolchange_line_len] = '\0';
+          if (toolchange_line_len) toolchange_scan_line();
+          toolchange_line_len = 0;
+          toolchange_in_comment = false;
+        }
+        else if (c == ';')
+          toolchange_in_comment = true;
+        else if (!toolchange_in_comment && toolchange_line_len < MAX_CMD_SIZE - 1)
+          toolchange_line[toolchange_line_len++] = c;
+      }
+
+      card.file.getpos(&toolchange_file_pos);
+      card.file.setpos(&print_pos);
+    }
+
+  #endif // SDSUPPORT
+
+  /**
+   * Preheat the hotends of the T commands in the command buffer
+   * and, when printing from SD, in the file. Called by manage_inactivity().
+   */
+  void toolchange_preheat_manage() {
+    for (uint8_t i = 0; i < commands_in_queue; i++)
+      toolchange_preheat(toolchange_command_tool(command_queue[(cmd_queue_index_r + i) % BUFSIZE]));
+    #if ENABLED(SDSUPPORT)
+      toolchange_scan_file();
+    #endif
+  }
+
+  // Is the hotend selected again by a command in the buffer or found by the look-ahead?
+  static bool toolchange_needed_soon(const uint8_t h) {
+    #if ENABLED(SDSUPPORT)
+      if (toolchange_scanning && toolchange_pending[h]) return true;
+    #endif
+    for (uint8_t i = 1; i < commands_in_queue; i++)
+      if (toolchange_command_tool(command_queue[(cmd_queue_index_r + i) % BUFSIZE]) == h) return true;
+    return false;
+  }
+
+  /**
+   * Called by tool_change() before a hotend change: heat the new hotend if
+   * the look-ahead missed it, put the old one in standby if it isn't needed soon
+   */
+  static void toolchange_standby(const uint8_t old_hotend, const uint8_t new_hotend) {
+    #if ENABLED(SDSUPPORT)
+      if (toolchange_pending[new_hotend]) toolchange_pending[new_hotend]--;
+    #endif
+    toolchange_preheat(new_hotend);
+
+    const float target = degTargetHotend(old_hotend);
+    if (TOOL_STANDBY_DROP > 0 && target > 0 && !toolchange_needed_soon(old_hotend)) {
+      toolchange_print_temp[old_hotend] = target;
+      setTargetHotend(max(target - (TOOL_STANDBY_DROP), 0), old_hotend);
+    }
+  }
+
+#endif // TOOL_CHANGE_PREHEAT
+
 /**
  * G0, G1: Coordinated movement of X Y Z E axes
  */
@@ -3791,6 +4332,14 @@ inline void gcode_G0_G1(bool lfire) {
       }
     #endif
 
+    #if ENABLED(SD_LAYER_INDEX)
+      if (card.sdprinting && fromsd[cmd_queue_index_r]) card.layerIndexMove(current_position, destination);
+    #endif
+
+    #if ENABLED(TOOL_CHANGE_PREHEAT)
+      toolchange_exec_time += toolchange_move_time(current_position, destination, feedrate_mm_m);
+    #endif
+
     prepare_move_to_destination();
 
     #if ENABLED(LASERBEAM) && ENABLED(LASER_FIRE_G1)
@@ -3836,6 +4385,10 @@ inline void gcode_G0_G1(bool lfire) {
         code_seen('J') ? code_value_axis_units(Y_AXIS) : 0
       };
 
+      #if ENABLED(TOOL_CHANGE_PREHEAT)
+        toolchange_exec_time += toolchange_arc_time(current_position, destination, arc_offset, clockwise, feedrate_mm_m);
+      #endif
+
       // Send an arc to the planner
       plan_arc(destination, arc_offset, clockwise);
 
@@ -3858,6 +4411,10 @@ inline void gcode_G4() {
   if (code_seen('P')) codenum = code_value_millis(); // milliseconds to wait
   if (code_seen('S')) codenum = code_value_millis_from_seconds(); // seconds to wait
 
+  #if ENABLED(TOOL_CHANGE_PREHEAT)
+    toolchange_exec_time += codenum / 1000.0;
+  #endif
+
   st_synchronize();
   refresh_cmd_timeout();
   codenum += previous_cmd_ms;  // keep track of when we started waiting
@@ -5493,6 +6050,12 @@ inline void gcode_M31() {
 
   /**
    * M34: Select file and start SD print
+   *
+   *  S<pos>      Start from file position
+   *  F<mm/m>     Feedrate to start with
+   *  L<layer>    Start from layer, counted from 0 (SD_LAYER_INDEX)
+   *  Z<height>   Start from the first layer at or above height (SD_LAYER_INDEX)
+   *  @<filename> File to print
    */
   inline void gcode_M34() {
     if (card.sdprinting)
@@ -5504,14 +6067,24 @@ inline void gcode_M31() {
         namestartpos = current_command_args ; // default name position
       }
       else
-        namestartpos++; // to skip the '@'
+        *namestartpos++ = '\0'; // parameters end at the '@'
 
       ECHO_SMT(DB, "Open file: ", namestartpos);
       ECHO_EM(" and start print.");
       card.selectFile(namestartpos);
+
+      #if ENABLED(SD_LAYER_INDEX)
+        if (namestartpos != current_command_args && (code_seen('L') || code_seen('Z'))) {
+          const int16_t layer = code_seen('L') ? code_value_int() : -1;
+          const float z = code_seen('Z') ? code_value_axis_units(Z_AXIS) : 0;
+          card.printFromLayer(layer, z);
+          return;
+        }
+      #endif
+
       if(code_seen('S')) card.setIndex(code_value_long());
 
-      feedrate_mm_m = 1200.0;   // 20 units/sec
+      feedrate_mm_m = code_seen('F') ? code_value_float() : 1200.0;   // 20 units/sec
       feedrate_percentage = 100;	 // 100% feedrate_mm_m
       card.startPrint();
       print_job_counter.start();
@@ -5530,6 +6103,25 @@ inline void gcode_M31() {
     }
   #endif
 
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    /**
+     * M413: Power-loss recovery
+     *
+     *  S<bool> Enable or disable the power-loss journal
+     *  R       Resume the print saved in the journal
+     */
+    inline void gcode_M413() {
+      if (code_seen('S')) {
+        card.journal_enabled = code_value_bool();
+        if (!card.journal_enabled) card.discardJournal();
+      }
+      if (code_seen('R'))
+        card.resumeJournal();
+      else
+        ECHO_LMT(DB, "Power-loss recovery: ", card.journal_enabled ? "on" : "off");
+    }
+  #endif
+
 #endif // SDSUPPORT
 
 /**
@@ -6200,8 +6792,11 @@ inline void gcode_M104() {
 
   if (code_seen('S')) {
     setTargetHotend(code_value_temp_abs(), target_extruder);
+    #if ENABLED(TOOL_CHANGE_PREHEAT)
+      toolchange_print_temp[target_extruder] = 0; // Set explicitly, no longer in standby
+    #endif
     #if ENABLED(DUAL_X_CARRIAGE)
-      if (dual_x_carriage_mode == DXC_DUPLICATION_MODE && target_extruder == 0)
+      if (dxc_is_duplicating() && target_extruder == 0)
         setTargetHotend(code_value_temp_abs() == 0.0 ? 0.0 : code_value_temp_abs() + duplicate_hotend_temp_offset, 1);
     #endif
 
@@ -6269,8 +6864,14 @@ inline void gcode_M105() {
 
 /**
  * M108: Cancel heatup and wait for the hotend and bed, this G-code is asynchronously handled in the get_serial_commands() parser
+ *       or, with EMERGENCY_PARSER, in the serial interrupt
  */
-inline void gcode_M108() { wait_for_heatup = false; }
+inline void gcode_M108() {
+  wait_for_heatup = false;
+  #if ENABLED(DEFERRED_HEATUP_WAIT)
+    heatup_wait_cancel();
+  #endif
+}
 
 /**
  * M109: Sxxx Wait for hotend(s) to reach temperature. Waits only when heating.
@@ -6287,8 +6888,11 @@ inline void gcode_M109() {
   bool no_wait_for_cooling = code_seen('S');
   if (no_wait_for_cooling || code_seen('R')) {
     setTargetHotend(code_value_temp_abs(), target_extruder);
+    #if ENABLED(TOOL_CHANGE_PREHEAT)
+      toolchange_print_temp[target_extruder] = 0; // Set explicitly, no longer in standby
+    #endif
     #if ENABLED(DUAL_X_CARRIAGE)
-      if (dual_x_carriage_mode == DXC_DUPLICATION_MODE && target_extruder == 0)
+      if (dxc_is_duplicating() && target_extruder == 0)
         setTargetHotend(code_value_temp_abs() == 0.0 ? 0.0 : code_value_temp_abs() + duplicate_hotend_temp_offset, 1);
     #endif
 
@@ -6315,7 +6919,16 @@ inline void gcode_M109() {
     planner.autotemp_M109();
   #endif
 
-  wait_heater(no_wait_for_cooling);
+  #if ENABLED(DEFERRED_HEATUP_WAIT)
+    const uint8_t h = HOTENDS > 1 ? target_extruder : 0;
+    SBI(heatup_wait_hotends, h);
+    if (no_wait_for_cooling)
+      CBI(heatup_wait_hotends_cooling, h);
+    else
+      SBI(heatup_wait_hotends_cooling, h);
+  #else
+    wait_heater(no_wait_for_cooling);
+  #endif
 }
 
 /**
@@ -6423,6 +7036,37 @@ inline void gcode_M122() {
   }
 }
 
+#if ENABLED(IDLE_SCHEDULER)
+  /**
+   * M123: Report the idle tasks: period, runs, late runs, longest run and CPU time
+   *
+   *   R Reset the statistics
+   */
+  inline void gcode_M123() {
+    if (code_seen('R'))
+      idle_stats_reset();
+    else
+      idle_stats_report();
+  }
+#endif
+
+#if ENABLED(ADVANCED_OK)
+  /**
+   * M124: Select the "ok" format
+   *
+   *   S0 Bare "ok"
+   *   S1 "ok N<line> P<free planner blocks> B<free command slots>"
+   *
+   * B doesn't count the slot of the acknowledged command, it's freed right after the "ok".
+   */
+  inline void gcode_M124() {
+    if (code_seen('S'))
+      advanced_ok = code_value_bool();
+    else
+      ECHO_LMV(DB, "M124 S", (int)advanced_ok);
+  }
+#endif
+
 #if ENABLED(BARICUDA)
   #if HAS(HEATER_1)
     /**
@@ -6586,6 +7230,39 @@ inline void gcode_M122() {
 
 #endif // BLINKM
 
+#if ENABLED(AUTO_REPORT_POSITION)
+  /**
+   * M154: Set the position auto-report interval. S<seconds>, S0 to stop.
+   *       The position is the one of the steppers, not the end of the planned moves.
+   */
+  inline void gcode_M154() {
+    if (code_seen('S')) {
+      auto_report_pos_interval = code_value_byte();
+      NOMORE(auto_report_pos_interval, 60);
+      next_pos_report_ms = millis() + auto_report_pos_interval * 1000UL;
+    }
+    else {
+      ECHO_LMV(DB, "M154 S", (unsigned long)auto_report_pos_interval);
+    }
+  }
+#endif
+
+#if ENABLED(AUTO_REPORT_TEMPERATURES) && (HAS(TEMP_0) || HAS(TEMP_BED) || ENABLED(HEATER_0_USES_MAX6675))
+  /**
+   * M155: Set the temperature auto-report interval. S<seconds>, S0 to stop.
+   */
+  inline void gcode_M155() {
+    if (code_seen('S')) {
+      auto_report_temp_interval = code_value_byte();
+      NOMORE(auto_report_temp_interval, 60);
+      next_temp_report_ms = millis() + auto_report_temp_interval * 1000UL;
+    }
+    else {
+      ECHO_LMV(DB, "M155 S", (unsigned long)auto_report_temp_interval);
+    }
+  }
+#endif
+
 #if ENABLED(COLOR_MIXING_EXTRUDER)
   /**
    * M163: Set a single mix factor for a mixing extruder
@@ -6632,7 +7309,79 @@ inline void gcode_M122() {
    *   I[factor] Mix factor for extruder stepper 6
    *
    */
-  inline void gcode_M165() { gcode_get_mix(); }
+  inline void gcode_M165() {
+    gcode_get_mix();
+    #if ENABLED(MIXING_GRADIENT)
+      mixing_gradient_active = -1; // A fixed mix ends the gradient
+    #endif
+  }
+
+  #if ENABLED(MIXING_GRADIENT)
+    /**
+     * M166: Set a gradient program for a mixing extruder.
+     *       The mix goes from the start to the end virtual tool
+     *       over a Z range, or over the filament fed since S1.
+     *       The moves get their mix from the planner, no more M163/M164.
+     *
+     *   P[index]   The gradient program (default 0)
+     *   A[float]   Start of the gradient, Z height or filament (mm)
+     *   Z[float]   End of the gradient, Z height or filament (mm)
+     *   I[index]   Virtual tool with the start mix
+     *   J[index]   Virtual tool with the end mix
+     *   E[bool]    1 for the filament fed, 0 for the Z height
+     *   S[bool]    1 to run this program, 0 to go back to the fixed mix
+     *
+     * With no parameter report the gradient programs.
+     */
+    inline void gcode_M166() {
+      if (!*current_command_args) {
+        for (uint8_t p = 0; p < MIXING_GRADIENTS; p++) {
+          const MixGradient &g = mixing_gradient[p];
+          ECHO_SMV(DB, "M166 P", (int)p);
+          ECHO_MV(" A", g.start);
+          ECHO_MV(" Z", g.end);
+          ECHO_MV(" I", (int)g.start_vtool);
+          ECHO_MV(" J", (int)g.end_vtool);
+          ECHO_MV(" E", (int)g.by_e);
+          ECHO_EMV(" S", (int)(mixing_gradient_active == p));
+        }
+        return;
+      }
+
+      const int program = code_seen('P') ? code_value_int() : 0;
+      if (program < 0 || program >= MIXING_GRADIENTS) {
+        ECHO_LM(ER, "M166 invalid gradient program");
+        return;
+      }
+
+      MixGradient &g = mixing_gradient[program];
+      MixGradient n = g;
+      if (code_seen('A')) n.start = code_value_axis_units(Z_AXIS);
+      if (code_seen('Z')) n.end = code_value_axis_units(Z_AXIS);
+      if (code_seen('I')) n.start_vtool = code_value_byte();
+      if (code_seen('J')) n.end_vtool = code_value_byte();
+      if (code_seen('E')) n.by_e = code_value_bool();
+
+      if (n.start_vtool >= MIXING_VIRTUAL_TOOLS || n.end_vtool >= MIXING_VIRTUAL_TOOLS) {
+        ECHO_LM(ER, "M166 invalid virtual tool");
+        return;
+      }
+
+      const bool run = code_seen('S') ? code_value_bool() : mixing_gradient_active == program;
+      if (run && n.end == n.start) {
+        ECHO_LM(ER, "M166 gradient needs A and Z apart");
+        return;
+      }
+
+      g = n;
+      if (run) {
+        if (mixing_gradient_active != program) mixing_gradient_e = 0.0;
+        mixing_gradient_active = program;
+      }
+      else if (mixing_gradient_active == program)
+        mixing_gradient_active = -1;
+    }
+  #endif
 #endif  // COLOR_MIXING_EXTRUDER
 
 #if HAS(TEMP_BED)
@@ -6660,7 +7409,12 @@ inline void gcode_M122() {
       }
     }
 
-    wait_bed(no_wait_for_cooling);
+    #if ENABLED(DEFERRED_HEATUP_WAIT)
+      heatup_wait_bed = true;
+      heatup_wait_bed_cooling = !no_wait_for_cooling;
+    #else
+      wait_bed(no_wait_for_cooling);
+    #endif
   }
 #endif // HAS(TEMP_BED)
 
@@ -7171,13 +7925,17 @@ inline void gcode_M226() {
   }
 #endif // PREVENT_DANGEROUS_EXTRUDE
 
-#if HAS(PID_HEATING) || HAS(PID_COOLING)
+#if ENABLED(PIDTEMP) || ENABLED(PIDTEMPBED) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER)
   /**
    * M303: PID relay autotune
    *       S<temperature> sets the target temperature. (default target temperature = 150C)
    *       H<hotend> (-1 for the bed, -2 for chamber, -3 for cooler) (default 0)
    *       C<cycles>
    *       U<bool> with a non-zero value will apply the result to current settings
+   *
+   * The tuning runs in the background, with the thermal protection on.
+   * Send M303 for each controller to tune them together.
+   * S0, or a new target temperature, stops the tuning of a controller.
    */
   inline void gcode_M303() {
     int h = code_seen('H') ? code_value_int() : 0;
@@ -7188,11 +7946,7 @@ inline void gcode_M226() {
 
     if (h >= 0 && h < HOTENDS) target_extruder = h;
 
-    KEEPALIVE_STATE(NOT_BUSY); // don't send "busy: processing" messages during autotune output
-
     PID_autotune(temp, h, c, u);
-
-    KEEPALIVE_STATE(IN_HANDLER);
   }
 #endif
 
@@ -7238,6 +7992,51 @@ inline void gcode_M226() {
   }
 #endif // PIDTEMPCOOLER
 
+#if ENABLED(MPCTEMP)
+  /**
+   * M307: Set or measure the MPC model of a hotend
+   *
+   *   H[hotend] Hotend, default 0
+   *   T         Measure the model at MPC_AUTOTUNE_TEMP and apply it.
+   *             This runs in the background, a new target stops it.
+   *   P[float]  Heater power (W)
+   *   C[float]  Heater block heat capacity (J/K)
+   *   R[float]  Sensor responsiveness (K/s per K)
+   *   A[float]  Ambient heat transfer coefficient, fan off (W/K)
+   *   F[float]  Ambient heat transfer coefficient, fan at 255 (W/K)
+   *   M[float]  Filament heat capacity (J/K/mm)
+   */
+  inline void gcode_M307() {
+    int h = code_seen('H') ? code_value_int() : 0;
+
+    if (h < 0 || h >= HOTENDS) {
+      ECHO_LM(ER, SERIAL_INVALID_EXTRUDER);
+      return;
+    }
+
+    if (code_seen('T')) {
+      MPC_autotune(h);
+      return;
+    }
+
+    mpc_settings_t &mpc = mpc_settings[h];
+    if (code_seen('P')) mpc.heater_power = code_value_float();
+    if (code_seen('C')) mpc.block_heat_capacity = code_value_float();
+    if (code_seen('R')) mpc.sensor_responsiveness = code_value_float();
+    if (code_seen('A')) mpc.ambient_xfer_coeff_fan0 = code_value_float();
+    if (code_seen('F')) mpc.fan255_adjustment = code_value_float() - mpc.ambient_xfer_coeff_fan0;
+    if (code_seen('M')) mpc.filament_heat_capacity_permm = code_value_float();
+
+    ECHO_SMV(DB, "H", h);
+    ECHO_MV(" P:", mpc.heater_power);
+    ECHO_MV(" C:", mpc.block_heat_capacity);
+    ECHO_MV(" R:", mpc.sensor_responsiveness, 4);
+    ECHO_MV(" A:", mpc.ambient_xfer_coeff_fan0, 4);
+    ECHO_MV(" F:", mpc.ambient_xfer_coeff_fan0 + mpc.fan255_adjustment, 4);
+    ECHO_EMV(" M:", mpc.filament_heat_capacity_permm, 4);
+  }
+#endif // MPCTEMP
+
 #if HAS(MICROSTEPS)
   // M350 Set microstepping mode. Warning: Steps per unit remains unchanged. S code sets stepping mode for all drivers.
   inline void gcode_M350() {
@@ -7620,6 +8419,10 @@ inline void gcode_M400() { st_synchronize(); }
         #if ENABLED(SDSUPPORT)
           if (card.sdprinting) ECHO_V(card.firstlayerHeight);
           else ECHO_M("0");
+          if (card.sdprinting) {
+            ECHO_MV(",\"layerCount\":", card.layerCount);
+            ECHO_MV(",\"estimatedPrintTime\":", card.printTime);
+          }
         #else
           ECHO_M("0");
         #endif
@@ -7881,6 +8684,38 @@ inline void gcode_M503() {
 
 #endif // ABORT_ON_ENDSTOP_HIT_FEATURE_ENABLED
 
+#if ENABLED(INPUT_SHAPING)
+  /**
+   * M593: Set input shaping, X and Y if no axis is given
+   *
+   *  X or Y      Axis to set
+   *  T<type>     0 = None, 1 = ZV, 2 = ZVD, 3 = MZV
+   *  F<hz>       Ringing frequency
+   *  D<zeta>     Damping ratio
+   */
+  inline void gcode_M593() {
+    const bool seen_x = code_seen('X'), seen_y = code_seen('Y'),
+               seen_t = code_seen('T'), seen_f = code_seen('F'), seen_d = code_seen('D');
+
+    for (uint8_t axis = X_AXIS; axis <= Y_AXIS; axis++) {
+      if ((seen_x || seen_y) && !(axis == X_AXIS ? seen_x : seen_y)) continue;
+      if (seen_t && code_seen('T')) shaping_settings[axis].type = code_value_byte();
+      if (seen_f && code_seen('F')) shaping_settings[axis].frequency = code_value_float();
+      if (seen_d && code_seen('D')) shaping_settings[axis].zeta = code_value_float();
+    }
+
+    if (seen_t || seen_f || seen_d) shaping_refresh();
+
+    for (uint8_t axis = X_AXIS; axis <= Y_AXIS; axis++) {
+      ECHO_SMV(DB, "Input shaping ", axis_codes[axis]);
+      ECHO_MV(" T", shaping_settings[axis].type);
+      ECHO_MV(" F", shaping_settings[axis].frequency);
+      ECHO_EMV(" D", shaping_settings[axis].zeta);
+    }
+    ECHO_LMV(DB, "Input shaping queue overflows: ", shaping_overflows);
+  }
+#endif // INPUT_SHAPING
+
 #if HEATER_USES_AD595
   /**
    * M595 - set Hotend AD595 offset & Gain H<hotend_number> O<offset> S<gain>
@@ -8118,6 +8953,9 @@ inline void gcode_M503() {
    *                         units x-offset and an optional differential hotend temperature of
    *                         mmm degrees. E.g., with "M605 S2 X100 R2" the second extruder will duplicate
    *                         the first with a spacing of 100mm in the x direction and 2 degrees hotter.
+   *    M605 S3 [Xnnn] [Rmmm]: Mirrored mode. The second extruder will move opposite to the first,
+   *                         mirrored about the line X=nnn, in the same moves. The default line is
+   *                         halfway between X_MIN_POS and X2_MAX_POS. R as in duplication mode.
    *
    *    Note: the X axis should be homed after changing dual x-carriage mode.
    */
@@ -8134,6 +8972,20 @@ inline void gcode_M503() {
         ECHO_MV(" ", duplicate_hotend_x_offset);
         ECHO_EMV(",", hotend_offset[Y_AXIS][1]);
         break;
+      case DXC_MIRRORED_MODE: {
+        const float center = code_seen('X') ? code_value_axis_units(X_AXIS) : mirror_hotend_x_center;
+        // X1 needs some travel left of the line with X2 on the other side
+        const float dual_max_x = max(hotend_offset[X_AXIS][1], X2_MAX_POS);
+        if (min(base_max_pos(X_AXIS), center - (DXC_CARRIAGE_GAP) * 0.5) <= max(base_min_pos(X_AXIS), 2 * center - dual_max_x)) {
+          ECHO_LMV(ER, "No room for mirrored mode about X", center);
+          dual_x_carriage_mode = DEFAULT_DUAL_X_CARRIAGE_MODE;
+          break;
+        }
+        mirror_hotend_x_center = center;
+        if (code_seen('R')) duplicate_hotend_temp_offset = code_value_temp_diff();
+        ECHO_LMV(DB, "Mirror X", mirror_hotend_x_center);
+        break;
+      }
       case DXC_FULL_CONTROL_MODE:
       case DXC_AUTO_PARK_MODE:
         break;
@@ -8143,7 +8995,9 @@ inline void gcode_M503() {
     }
     active_hotend_parked = false;
     hotend_duplication_enabled = false;
+    hotend_mirror_enabled = dual_x_carriage_mode == DXC_MIRRORED_MODE;
     delayed_move_time = 0;
+    update_software_endstops(X_AXIS);
   }
 #endif // DUAL_X_CARRIAGE
 
@@ -8287,11 +9141,16 @@ inline void gcode_M503() {
 #if ENABLED(ADVANCE_LPC)
   /**
    * M905: Set advance factor
+   *
+   *  K<factor> Advance factor
+   *  R         Reset the deferred advance steps counter
    */
   inline void gcode_M905() {
     st_synchronize();
     if (code_seen('K')) extruder_advance_k = code_value_float();
     ECHO_LMV(DB, "Advance factor = ", extruder_advance_k);
+    ECHO_LMV(DB, "Advance steps deferred = ", advance_deferred);
+    if (code_seen('R')) advance_deferred = 0;
   }
 #endif
 
@@ -8353,6 +9212,18 @@ inline void gcode_M907() {
   }
 #endif // HAS(DIGIPOTSS)
 
+#if ENABLED(STEPPER_ISR_STATS)
+  /**
+   * M930: Report the stepper ISR statistics
+   *
+   *  R Reset the statistics after the report
+   */
+  inline void gcode_M930() {
+    stepper_stats_report();
+    if (code_seen('R')) stepper_stats_reset();
+  }
+#endif
+
 #if ENABLED(NPR2)
   /**
    * M997: Cxx Move Carter xx gradi
@@ -8443,6 +9314,10 @@ void tool_change(const uint8_t tmp_extruder, const float fr_mm_m/*=0.0*/, bool n
         mixing_factor[j] = mixing_virtual_tool_mix[tmp_extruder][j];
       }
 
+      #if ENABLED(MIXING_GRADIENT)
+        mixing_gradient_active = -1; // A fixed mix ends the gradient
+      #endif
+
       ECHO_LMV(DB, SERIAL_ACTIVE_COLOR, (int)tmp_extruder);
 
     #elif ENABLED(NPR2)
@@ -8709,6 +9584,10 @@ void tool_change(const uint8_t tmp_extruder, const float fr_mm_m/*=0.0*/, bool n
     feedrate_mm_m = fr_mm_m > 0.0 ? (old_feedrate_mm_m = fr_mm_m) : XY_PROBE_SPEED;
 
     if (tmp_extruder != active_extruder) {
+      #if ENABLED(TOOL_CHANGE_PREHEAT)
+        toolchange_standby(active_extruder, tmp_extruder);
+      #endif
+
       if (!no_move && axis_unhomed_error(true, true, true)) {
         ECHO_LM(DB, "No move on toolchange");
         no_move = true;
@@ -8723,6 +9602,7 @@ void tool_change(const uint8_t tmp_extruder, const float fr_mm_m/*=0.0*/, bool n
           ECHO_SM(INFO, "Dual X Carriage Mode ");
           switch (dual_x_carriage_mode) {
             case DXC_DUPLICATION_MODE: ECHO_EM("DXC_DUPLICATION_MODE"); break;
+            case DXC_MIRRORED_MODE: ECHO_EM("DXC_MIRRORED_MODE"); break;
             case DXC_AUTO_PARK_MODE: ECHO_EM("DXC_AUTO_PARK_MODE"); break;
             case DXC_FULL_CONTROL_MODE: ECHO_EM("DXC_FULL_CONTROL_MODE"); break;
           }
@@ -8763,29 +9643,32 @@ void tool_change(const uint8_t tmp_extruder, const float fr_mm_m/*=0.0*/, bool n
 
         switch (dual_x_carriage_mode) {
           case DXC_FULL_CONTROL_MODE:
-            current_position[X_AXIS] = LOGICAL_X_POSITION(inactive_extruder_x_pos);
-            inactive_extruder_x_pos = RAW_X_POSITION(destination[X_AXIS]);
+            current_position[X_AXIS] = LOGICAL_X_POSITION(inactive_hotend_x_pos);
+            inactive_hotend_x_pos = RAW_X_POSITION(destination[X_AXIS]);
             break;
           case DXC_DUPLICATION_MODE:
-            active_extruder_parked = (active_extruder == 0); // this triggers the second extruder to move into the duplication position
-            if (active_extruder_parked)
-              current_position[X_AXIS] = LOGICAL_X_POSITION(inactive_extruder_x_pos);
+          case DXC_MIRRORED_MODE:
+            active_hotend_parked = (active_extruder == 0); // this triggers the second extruder to move into the duplication position
+            if (active_hotend_parked)
+              current_position[X_AXIS] = LOGICAL_X_POSITION(inactive_hotend_x_pos);
+            else if (dual_x_carriage_mode == DXC_MIRRORED_MODE)
+              current_position[X_AXIS] = LOGICAL_X_POSITION(2 * mirror_hotend_x_center - RAW_X_POSITION(destination[X_AXIS]));
             else
-              current_position[X_AXIS] = destination[X_AXIS] + duplicate_extruder_x_offset;
-            inactive_extruder_x_pos = RAW_X_POSITION(destination[X_AXIS]);
-            extruder_duplication_enabled = false;
+              current_position[X_AXIS] = destination[X_AXIS] + duplicate_hotend_x_offset;
+            inactive_hotend_x_pos = RAW_X_POSITION(destination[X_AXIS]);
+            hotend_duplication_enabled = false;
             break;
           default:
             // record raised toolhead position for use by unpark
             memcpy(raised_parked_position, current_position, sizeof(raised_parked_position));
             raised_parked_position[Z_AXIS] += TOOLCHANGE_UNPARK_ZLIFT;
-            active_extruder_parked = true;
+            active_hotend_parked = true;
             delayed_move_time = 0;
             break;
         }
 
         if (DEBUGGING(INFO)) {
-          ECHO_LMT(INFO, "Active extruder parked: ", active_extruder_parked ? "yes" : "no");
+          ECHO_LMT(INFO, "Active extruder parked: ", active_hotend_parked ? "yes" : "no");
           DEBUG_INFO_POS("New extruder (parked)", current_position);
         }
 
@@ -8933,7 +9816,11 @@ void tool_change(const uint8_t tmp_extruder, const float fr_mm_m/*=0.0*/, bool n
       if (DEBUGGING(INFO)) DEBUG_INFO_POS("Sync After Toolchange", current_position);
 
       // Tell the planner the new "current position"
-      SYNC_PLAN_POSITION_KINEMATIC();
+      #if ENABLED(PLANNED_TOOL_OFFSET) && DISABLED(DUAL_X_CARRIAGE)
+        shift_plan_position();
+      #else
+        SYNC_PLAN_POSITION_KINEMATIC();
+      #endif
 
       // Move to the "old position" (move the extruder into place)
       if (!no_move && IsRunning()) {
@@ -8943,7 +9830,10 @@ void tool_change(const uint8_t tmp_extruder, const float fr_mm_m/*=0.0*/, bool n
 
     } // (tmp_extruder != active_extruder)
 
-    st_synchronize();
+    // With the offset in the planner drain only for the hardware that needs the old tool stopped
+    #if DISABLED(PLANNED_TOOL_OFFSET) || ENABLED(DUAL_X_CARRIAGE) || ENABLED(EXT_SOLENOID)
+      st_synchronize();
+    #endif
 
     #if ENABLED(EXT_SOLENOID)
       disable_all_solenoids();
@@ -9010,6 +9900,12 @@ void process_next_command() {
 
   KEEPALIVE_STATE(IN_HANDLER);
 
+  #if ENABLED(DEFERRED_HEATUP_WAIT)
+    // Wait for the heaters before a command that needs the temperature
+    if (heatup_wait_pending() && !heatup_wait_deferrable(command_code, codenum))
+      heatup_wait_finish();
+  #endif
+
   // Handle a known G, M, or T
   switch(command_code) {
     case 'G': switch (codenum) {
@@ -9283,6 +10179,16 @@ void process_next_command() {
       case 122: // M122 Disable or enable software endstops
         gcode_M122(); break;
 
+      #if ENABLED(IDLE_SCHEDULER)
+        case 123: // M123 Report the idle tasks
+          gcode_M123(); break;
+      #endif
+
+      #if ENABLED(ADVANCED_OK)
+        case 124: // M124 S<0|1> Select the ok format
+          gcode_M124(); break;
+      #endif
+
       #if ENABLED(BARICUDA)
         // PWM for HEATER_1_PIN
         #if HAS(HEATER_1)
@@ -9321,6 +10227,16 @@ void process_next_command() {
           gcode_M150(); break;
       #endif //BLINKM
 
+      #if ENABLED(AUTO_REPORT_POSITION)
+        case 154: // M154 S<seconds> Position auto-report interval
+          gcode_M154(); break;
+      #endif
+
+      #if ENABLED(AUTO_REPORT_TEMPERATURES) && (HAS(TEMP_0) || HAS(TEMP_BED) || ENABLED(HEATER_0_USES_MAX6675))
+        case 155: // M155 S<seconds> Temperature auto-report interval
+          gcode_M155(); break;
+      #endif
+
       #if ENABLED(COLOR_MIXING_EXTRUDER)
         case 163: // M163 S<int> P<float> set weight for a mixing extruder
           gcode_M163(); break;
@@ -9330,6 +10246,10 @@ void process_next_command() {
         #endif
         case 165: // M165 [ABCDHI]<float> set multiple mix weights
           gcode_M165(); break;
+        #if ENABLED(MIXING_GRADIENT)
+          case 166: // M166 P<int> A<start> Z<end> I<vtool> J<vtool> E<bool> S<bool> set a mix gradient program
+            gcode_M166(); break;
+        #endif
       #endif
 
       #if HAS(TEMP_BED)
@@ -9415,7 +10335,7 @@ void process_next_command() {
           gcode_M302(); break;
       #endif // PREVENT_DANGEROUS_EXTRUDE
 
-      #if HAS(PID_HEATING)
+      #if ENABLED(PIDTEMP) || ENABLED(PIDTEMPBED) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER)
         case 303: // M303 PID autotune
           gcode_M303(); break;
       #endif
@@ -9435,6 +10355,11 @@ void process_next_command() {
           gcode_M306(); break;
       #endif // PIDTEMPCOOLER
 
+      #if ENABLED(MPCTEMP)
+        case 307: // M307 - Set or measure the MPC model of a hotend
+          gcode_M307(); break;
+      #endif // MPCTEMP
+
       #if HAS(MICROSTEPS)
         case 350: // M350 Set microstepping mode. Warning: Steps per unit remains unchanged. S code sets stepping mode for all drivers.
           gcode_M350(); break;
@@ -9486,6 +10411,11 @@ void process_next_command() {
       case 410: // M410 quickstop - Abort all the planned moves.
         gcode_M410(); break;
 
+      #if ENABLED(POWER_LOSS_RECOVERY)
+        case 413: // M413 Power-loss recovery
+          gcode_M413(); break;
+      #endif
+
       #if ENABLED(MESH_BED_LEVELING) && NOMECH(DELTA)
         case 420: // M420 Enable/Disable Mesh Bed Leveling
           gcode_M420(); break;
@@ -9515,6 +10445,11 @@ void process_next_command() {
           gcode_M540(); break;
       #endif
 
+      #if ENABLED(INPUT_SHAPING)
+        case 593: // M593 Set input shaping
+          gcode_M593(); break;
+      #endif
+
       #if HEATER_USES_AD595
         case 595: // M595 set Hotends AD595 offset & gain
           gcode_M595(); break;
@@ -9558,6 +10493,11 @@ void process_next_command() {
           gcode_M908(); break;
       #endif // HAS(DIGIPOTSS)
 
+      #if ENABLED(STEPPER_ISR_STATS)
+        case 930: // M930 Stepper ISR statistics
+          gcode_M930(); break;
+      #endif
+
       #if ENABLED(NPR2)
         case 997: // M997 Cxx Move Carter xx gradi
           gcode_M997(); break;
@@ -9597,6 +10537,10 @@ void ok_to_send() {
   if (!send_ok[cmd_queue_index_r]) return;
   ECHO_S(OK);
   #if ENABLED(ADVANCED_OK)
+    if (!advanced_ok) {
+      ECHO_E;
+      return;
+    }
     char* p = command_queue[cmd_queue_index_r];
     if (*p == 'N') {
       ECHO_C(' ');
@@ -9626,6 +10570,14 @@ void clamp_to_software_endstops(float target[3]) {
       NOMORE(target[Z_AXIS], sw_endstop_max[Z_AXIS]);
     #endif
   }
+
+  #if ENABLED(DUAL_X_CARRIAGE)
+    // Mirrored carriages move toward each other, keep them apart even with M211 S0
+    if (hotend_duplication_enabled && hotend_mirror_enabled) {
+      NOLESS(target[X_AXIS], sw_endstop_min[X_AXIS]);
+      NOMORE(target[X_AXIS], sw_endstop_max[X_AXIS]);
+    }
+  #endif
 }
 
 /**
@@ -9810,10 +10762,21 @@ static void report_current_position() {
 
   inline bool prepare_move_to_destination_dualx() {
     if (active_hotend_parked) {
-      if (dual_x_carriage_mode == DXC_DUPLICATION_MODE && active_extruder == 0) {
+      if (dxc_is_duplicating() && active_extruder == 0) {
+        float x2_pos = current_position[X_AXIS] + duplicate_hotend_x_offset;
+        if (dual_x_carriage_mode == DXC_MIRRORED_MODE) {
+          // First bring X1 to its side of the mirror line, the moves are clamped to it from now on
+          const float x1_max = mirror_hotend_x_center - (DXC_CARRIAGE_GAP) * 0.5;
+          if (RAW_X_POSITION(current_position[X_AXIS]) > x1_max) {
+            current_position[X_AXIS] = LOGICAL_X_POSITION(x1_max);
+            planner.buffer_line(current_position[X_AXIS], current_position[Y_AXIS], current_position[Z_AXIS], current_position[E_AXIS], planner.max_feedrate_mm_s[X_AXIS], 0, 0);
+          }
+          x2_pos = LOGICAL_X_POSITION(2 * mirror_hotend_x_center - RAW_X_POSITION(current_position[X_AXIS]));
+        }
         // move duplicate extruder into correct duplication position.
+        st_synchronize();
         planner.set_position_mm(inactive_hotend_x_pos, current_position[Y_AXIS], current_position[Z_AXIS], current_position[E_AXIS]);
-        planner.buffer_line(current_position[X_AXIS] + duplicate_hotend_x_offset, current_position[Y_AXIS], current_position[Z_AXIS], current_position[E_AXIS], planner.max_feedrate_mm_s[X_AXIS], 1, active_driver);
+        planner.buffer_line(x2_pos, current_position[Y_AXIS], current_position[Z_AXIS], current_position[E_AXIS], planner.max_feedrate_mm_s[X_AXIS], 1, 1);
         sync_plan_position();
         st_synchronize();
         hotend_duplication_enabled = true;
@@ -10199,6 +11162,153 @@ void plan_arc(
 
 #endif
 
+#if ENABLED(IDLE_SCHEDULER)
+
+  #if ENABLED(FILAMENT_CHANGE_FEATURE)
+    static bool idle_no_stepper_sleep = false;
+  #endif
+
+  static void idle_manage_inactivity() {
+    manage_inactivity(
+      #if ENABLED(FILAMENT_CHANGE_FEATURE)
+        idle_no_stepper_sleep
+      #endif
+    );
+  }
+
+  static void idle_print_counter() { print_job_counter.tick(); }
+
+  typedef struct {
+    const char* name;     // PROGMEM
+    void (*run)();
+    uint16_t period_ms;   // 0 = every pass
+    bool background;      // At most one background task runs per pass
+  } idle_task_t;
+
+  typedef struct {
+    millis_t due_ms;
+    uint32_t runs,
+             total_us;    // CPU time
+    uint16_t max_us,
+             late;        // Runs more than IDLE_TASK_MAX_LATENCY after due_ms
+  } idle_task_stats_t;
+
+  static const char idle_name_temperature[] PROGMEM = "temperature";
+  #if ENABLED(FLOWMETER_SENSOR)
+    static const char idle_name_flowmeter[]   PROGMEM = "flowmeter";
+  #endif
+  static const char idle_name_inactivity[]  PROGMEM = "inactivity";
+  #if ENABLED(HOST_KEEPALIVE_FEATURE)
+    static const char idle_name_keepalive[]   PROGMEM = "keepalive";
+  #endif
+  #if ENABLED(AUTO_REPORT_TEMPERATURES) || ENABLED(AUTO_REPORT_POSITION)
+    static const char idle_name_auto_report[] PROGMEM = "auto report";
+  #endif
+  #if ENABLED(LASERBEAM)
+    static const char idle_name_laser_log[]   PROGMEM = "laser log";
+  #endif
+  static const char idle_name_lcd[]         PROGMEM = "lcd";
+  static const char idle_name_counter[]     PROGMEM = "print counter";
+
+  // Critical tasks first, in the order they run
+  static const idle_task_t idle_tasks[] = {
+    { idle_name_temperature, manage_temp_controller,   0, false },
+    #if ENABLED(FLOWMETER_SENSOR)
+      { idle_name_flowmeter, flowrate_manage,          0, false },
+    #endif
+    { idle_name_inactivity,  idle_manage_inactivity,   0, false },  // Also fetches the commands
+    #if ENABLED(HOST_KEEPALIVE_FEATURE)
+      { idle_name_keepalive, host_keepalive,           0, false },
+    #endif
+    #if ENABLED(AUTO_REPORT_TEMPERATURES) || ENABLED(AUTO_REPORT_POSITION)
+      { idle_name_auto_report, auto_report,          100, true },
+    #endif
+    #if ENABLED(LASERBEAM)
+      { idle_name_laser_log, laser_log_flush,        100, true },
+    #endif
+    { idle_name_lcd,         lcd_update,               0, true },
+    { idle_name_counter,     idle_print_counter,     250, true }
+  };
+
+  #define IDLE_TASKS COUNT(idle_tasks)
+
+  static idle_task_stats_t idle_stats[IDLE_TASKS];
+  static uint8_t idle_next_background = 0;
+  static millis_t idle_stats_start_ms = 0;
+  static uint32_t idle_last_pass_us = 0;
+  static uint16_t idle_max_gap_us = 0;    // Longest time between two passes
+
+  void idle_stats_reset() {
+    memset(idle_stats, 0, sizeof(idle_stats));
+    idle_stats_start_ms = millis();
+    idle_last_pass_us = micros();
+    idle_max_gap_us = 0;
+  }
+
+  static void idle_run_task(const uint8_t t, const millis_t now) {
+    const idle_task_t &task = idle_tasks[t];
+    idle_task_stats_t &stats = idle_stats[t];
+
+    if (now - stats.due_ms > IDLE_TASK_MAX_LATENCY && stats.runs && stats.late < 0xFFFF) stats.late++;
+    stats.due_ms += task.period_ms;
+    if (!task.period_ms || PENDING(stats.due_ms, now)) stats.due_ms = now + task.period_ms;
+
+    const uint32_t start_us = micros();
+    task.run();
+    const uint32_t took_us = micros() - start_us;
+
+    stats.runs++;
+    stats.total_us += took_us;
+    if (took_us > stats.max_us) stats.max_us = took_us > 0xFFFF ? 0xFFFF : took_us;
+  }
+
+  /**
+   * Run the critical tasks that are due, then the next due background task
+   */
+  static void idle_scheduler() {
+    const uint32_t pass_us = micros(),
+                   gap_us = pass_us - idle_last_pass_us;
+    idle_last_pass_us = pass_us;
+    if (gap_us > idle_max_gap_us) idle_max_gap_us = gap_us > 0xFFFF ? 0xFFFF : gap_us;
+
+    const millis_t now = millis();
+
+    for (uint8_t t = 0; t < IDLE_TASKS; t++)
+      if (!idle_tasks[t].background && ELAPSED(now, idle_stats[t].due_ms))
+        idle_run_task(t, now);
+
+    for (uint8_t i = 0; i < IDLE_TASKS; i++) {
+      const uint8_t t = idle_next_background;
+      if (++idle_next_background >= IDLE_TASKS) idle_next_background = 0;
+      if (idle_tasks[t].background && ELAPSED(now, idle_stats[t].due_ms)) {
+        idle_run_task(t, now);
+        break;
+      }
+    }
+  }
+
+  /**
+   * Output the idle task statistics, for M123
+   */
+  void idle_stats_report() {
+    const millis_t elapsed_ms = millis() - idle_stats_start_ms;
+    ECHO_SMV(DB, "Idle tasks for ", elapsed_ms / 1000UL);
+    ECHO_MV("s, longest gap between passes ", idle_max_gap_us);
+    ECHO_EM("us");
+    for (uint8_t t = 0; t < IDLE_TASKS; t++) {
+      ECHO_S(DB);
+      ECHO_PS(idle_tasks[t].name);
+      ECHO_MV(" period:", idle_tasks[t].period_ms);
+      ECHO_MV("ms runs:", idle_stats[t].runs);
+      ECHO_MV(" late:", idle_stats[t].late);
+      ECHO_MV(" max:", idle_stats[t].max_us);
+      ECHO_MV("us cpu:", elapsed_ms ? idle_stats[t].total_us / (elapsed_ms * 10.0) : 0.0, 2);
+      ECHO_EM("%");
+    }
+  }
+
+#endif // IDLE_SCHEDULER
+
 /**
  * Standard idle routine keeps the machine alive
  */
@@ -10207,18 +11317,40 @@ void idle(
     bool no_stepper_sleep/*=false*/
   #endif
 ) {
-  manage_temp_controller();
-  #if ENABLED(FLOWMETER_SENSOR)
-    flowrate_manage();
+  #if ENABLED(EMERGENCY_PARSER)
+    if (emergency_kill) kill(PSTR(MSG_KILLED));
+    // Drop the moves now, the queued M410 resyncs the position
+    if (emergency_stop) {
+      emergency_stop = false;
+      quick_stop();
+    }
   #endif
-  manage_inactivity(
+
+  #if ENABLED(IDLE_SCHEDULER)
     #if ENABLED(FILAMENT_CHANGE_FEATURE)
-      no_stepper_sleep
+      idle_no_stepper_sleep = no_stepper_sleep;
+    #endif
+    idle_scheduler();
+  #else
+    manage_temp_controller();
+    #if ENABLED(FLOWMETER_SENSOR)
+      flowrate_manage();
+    #endif
+    manage_inactivity(
+      #if ENABLED(FILAMENT_CHANGE_FEATURE)
+        no_stepper_sleep
+      #endif
+    );
+    host_keepalive();
+    #if ENABLED(AUTO_REPORT_TEMPERATURES) || ENABLED(AUTO_REPORT_POSITION)
+      auto_report();
+    #endif
+    #if ENABLED(LASERBEAM)
+      laser_log_flush();
     #endif
-  );
-  host_keepalive();
-  lcd_update();
-  print_job_counter.tick();
+    lcd_update();
+    print_job_counter.tick();
+  #endif
 }
 
 /**
@@ -10234,6 +11366,8 @@ void idle(
  *  - Check if an idle but hot extruder needs filament extruded (EXTRUDER_RUNOUT_PREVENT)
  *  - Check oozing prevent
  *  - Read o Write Rfid
+ *  - Save the power-loss journal
+ *  - Preheat the next tool
  */
 void manage_inactivity(bool ignore_stepper_queue/*=false*/) {
 
@@ -10456,6 +11590,18 @@ void manage_inactivity(bool ignore_stepper_queue/*=false*/) {
     handle_status_leds();
   #endif
 
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    static millis_t next_journal_ms = 0;
+    if (IS_SD_PRINTING && ELAPSED(ms, next_journal_ms)) {
+      next_journal_ms = ms + (POWER_LOSS_JOURNAL_SECONDS) * 1000UL;
+      card.saveJournal();
+    }
+  #endif
+
+  #if ENABLED(TOOL_CHANGE_PREHEAT)
+    toolchange_preheat_manage();
+  #endif
+
   planner.check_axes_activity();
 }
 
@@ -10463,6 +11609,12 @@ void kill(const char* lcd_msg) {
   ECHO_LM(ER, SERIAL_ERR_KILLED);
 
   #if ENABLED(KILL_METHOD) && KILL_METHOD == 1
+    // Send the buffered error before the reset drops it
+    #ifndef EXTERNALSERIAL
+      MKSERIAL.flushTX();
+    #else
+      MKSERIAL.flush();
+    #endif
     HAL::resetHardware();
   #endif
   #if ENABLED(FLOWMETER_SENSOR) && ENABLED(MINFLOW_PROTECTION)
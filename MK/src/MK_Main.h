@@ -38,6 +38,7 @@ void manage_inactivity(bool ignore_stepper_queue = false);
 
 #if ENABLED(DUAL_X_CARRIAGE)
   extern bool hotend_duplication_enabled;
+  extern bool hotend_mirror_enabled;
 #endif
 
 void FlushSerialRequestResend();
@@ -47,6 +48,7 @@ void ok_to_send();
   void set_delta_constants();
   void inverse_kinematics(const float in_cartesian[3]);
   extern float delta[3];
+  extern float delta_cartesian_z;
   extern float endstop_adj[3];
   extern float diagrod_adj[3];
   extern float tower_adj[6];
@@ -74,6 +76,14 @@ void quickstop_stepper();
   void handle_filament_runout();
 #endif
 
+#if ENABLED(TOOL_CHANGE_PREHEAT)
+  void toolchange_preheat_reset();
+#endif
+
+#if ENABLED(SDSUPPORT)
+  extern uint32_t command_sdpos;
+#endif
+
 extern uint8_t mk_debug_flags;
 
 void clamp_to_software_endstops(float target[3]);
@@ -113,6 +123,9 @@ extern float volumetric_multiplier[EXTRUDERS];  // reciprocal of cross-sectional
 extern bool axis_known_position[3];             // axis[n].is_known
 extern bool axis_homed[3];                      // axis[n].is_homed
 extern volatile bool wait_for_heatup;
+#if ENABLED(EMERGENCY_PARSER)
+  extern volatile bool emergency_kill, emergency_stop;
+#endif
 
 extern float current_position[NUM_AXIS];
 extern float destination[NUM_AXIS];
@@ -261,6 +274,9 @@ extern uint8_t active_driver;
 
 #if ENABLED(COLOR_MIXING_EXTRUDER)
   extern float mixing_factor[DRIVER_EXTRUDERS];
+  #if ENABLED(MIXING_GRADIENT)
+    const float* mixing_gradient_mix(const float &z, const float &e_mm);
+  #endif
 #endif
 
 void calculate_volumetric_multipliers();
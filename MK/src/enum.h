@@ -113,6 +113,17 @@ enum TempState {
   StartupDelay // Startup, delay initial temp reading a tiny bit so the hardware can settle
 };
 
+/**
+ * Temperature
+ * Sensor of a temperature controller
+ */
+enum TempSensorType {
+  SENSOR_NONE,
+  SENSOR_THERMISTOR,
+  SENSOR_AD595,
+  SENSOR_MAX6675
+};
+
 /**
  * States for managing MarlinKimbra and host communication
  * MarlinKimbra sends messages if blocked or busy
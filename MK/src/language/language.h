@@ -150,6 +150,12 @@
 #define SERIAL_SD_DIRECTORY_CREATED             "Directory created"
 #define SERIAL_SD_CREATION_FAILED               "Creation failed"
 #define SERIAL_SD_SLASH                         "/"
+#define SERIAL_JOURNAL_INVALID                  "No valid power-loss journal"
+#define SERIAL_JOURNAL_RESUME                   "Resume file: "
+#define SERIAL_JOURNAL_SDPOS                    " from byte "
+#define SERIAL_LAYER_INDEXING                   "Indexing layers"
+#define SERIAL_LAYER_NOT_FOUND                  "Layer not found"
+#define SERIAL_LAYER_START                      "Start from layer at Z"
 #define SERIAL_SD_MAX_DEPTH                     "trying to call sub-gcode files with too many levels. MAX level is:"
 
 #define SERIAL_STEPPER_TOO_HIGH                 "Steprate too high: "
@@ -174,6 +180,9 @@
 #define SERIAL_PID_TEMP_TOO_HIGH                SERIAL_PID_AUTOTUNE_FAILED " Temperature too high"
 #define SERIAL_PID_TEMP_TOO_LOW                 SERIAL_PID_AUTOTUNE_FAILED " Temperature too low"
 #define SERIAL_PID_TIMEOUT                      SERIAL_PID_AUTOTUNE_FAILED " timeout"
+#define SERIAL_PID_AUTOTUNE_STOPPED             " stopped"
+#define SERIAL_PID_CYCLE                        " cycle: "
+#define SERIAL_PID_GAIN_LIMITED                 "PID gain out of range, limited to Kp 4095, Ki*dT 15.99, Kd/dT 131071"
 #define SERIAL_BIAS                             " bias: "
 #define SERIAL_D                                " d: "
 #define SERIAL_T_MIN                            " min: "
@@ -192,6 +201,17 @@
 #define SERIAL_CAT                              " C@:"
 #define SERIAL_W                                " W:"
 #define SERIAL_PID_AUTOTUNE_FINISHED            SERIAL_PID_AUTOTUNE " finished! Put the last Kp, Ki and Kd constants from above into Configuration.h or send command M500 for save in EEPROM the new value!"
+#define SERIAL_MPC_AUTOTUNE                     "MPC Autotune"
+#define SERIAL_MPC_AUTOTUNE_START               SERIAL_MPC_AUTOTUNE " start for hotend "
+#define SERIAL_MPC_AUTOTUNE_FAILED              SERIAL_MPC_AUTOTUNE " failed!"
+#define SERIAL_MPC_TEMP_TOO_HIGH                SERIAL_MPC_AUTOTUNE_FAILED " Temperature too high"
+#define SERIAL_MPC_TIMEOUT                      SERIAL_MPC_AUTOTUNE_FAILED " timeout"
+#define SERIAL_MPC_BAD_CURVE                    SERIAL_MPC_AUTOTUNE_FAILED " Heating curve not usable"
+#define SERIAL_MPC_COOLING                      "Cooling to ambient"
+#define SERIAL_MPC_HEATING                      "Heating to "
+#define SERIAL_MPC_MEASURING                    "Measuring ambient heat loss"
+#define SERIAL_MPC_MEASURING_FAN                "Measuring ambient heat loss with fan"
+#define SERIAL_MPC_AUTOTUNE_FINISHED            SERIAL_MPC_AUTOTUNE " finished! Send command M500 for save in EEPROM the new values!"
 #define SERIAL_PID_DEBUG                        " PID_DEBUG "
 #define SERIAL_PID_DEBUG_INPUT                  ": Input "
 #define SERIAL_PID_DEBUG_OUTPUT                 " Output "
@@ -235,6 +235,9 @@
 #define MSG_INFO_MIN_TEMP                   "Min Temp"
 #define MSG_INFO_MAX_TEMP                   "Max Temp"
 #define MSG_INFO_PSU                        "Power Supply"
+#define MSG_INFO_LAYERS                     "Layers"
+#define MSG_INFO_HEIGHT                     "Height"
+#define MSG_START_PRINT                     "Start print"
 
 // FILAMENT_CHANGE_FEATURE
 #define MSG_FILAMENT_CHANGE_HEADER          "CHANGE FILAMENT"
@@ -267,8 +267,7 @@
       digitalWrite(LASER_PWR_PIN, LASER_ARM);
     #endif
 
-    if (laser.diagnostics)
-      ECHO_LM(INFO, "Laser fired");
+    if (laser.diagnostics) laser_log(LASER_LOG_FIRED);
   }
 
   void laser_extinguish() {
@@ -284,8 +283,75 @@
 
       laser.time += millis() - (laser.last_firing / 1000);
 
-      if (laser.diagnostics)
-        ECHO_LM(INFO, "Laser extinguished");
+      if (laser.diagnostics) laser_log(LASER_LOG_EXTINGUISHED);
+    }
+  }
+
+  /**
+   * Diagnostics log
+   *
+   * The stepper ISR can't wait for the serial port, so the
+   * diagnostics are queued here and printed by idle().
+   */
+  typedef struct {
+    uint8_t event;
+    long value;
+  } laser_log_t;
+
+  static laser_log_t laser_log_buffer[LASER_LOG_SIZE];
+  static volatile uint8_t laser_log_head = 0,
+                          laser_log_tail = 0,
+                          laser_log_lost = 0;
+
+  static const char laser_log_fired[]       PROGMEM = "Laser fired";
+  static const char laser_log_extinguished[] PROGMEM = "Laser extinguished";
+  static const char laser_log_status_off[]  PROGMEM = "Laser status set to off, in interrupt handler";
+  static const char laser_log_duration[]    PROGMEM = "Laser firing duration elapsed, in interrupt handler";
+  static const char laser_log_duration_fast[] PROGMEM = "Laser firing duration elapsed, in interrupt fast loop";
+  static const char laser_log_x[]           PROGMEM = "X: ";
+  static const char laser_log_y[]           PROGMEM = "Y: ";
+  static const char laser_log_l[]           PROGMEM = "L: ";
+  static const char laser_log_e[]           PROGMEM = "E: ";
+  static const char laser_log_steps[]       PROGMEM = "steps done: ";
+  static const char laser_log_events[]      PROGMEM = "event count: ";
+  static const char laser_log_pixel[]       PROGMEM = "Pixel: ";
+
+  // In the order of LaserLogEvent
+  static const char* const laser_log_msg[] PROGMEM = {
+    laser_log_fired, laser_log_extinguished, laser_log_status_off, laser_log_duration, laser_log_duration_fast,
+    laser_log_x, laser_log_y, laser_log_l, laser_log_e, laser_log_steps, laser_log_events, laser_log_pixel
+  };
+
+  void laser_log(const uint8_t event, const long value/*=0*/) {
+    CRITICAL_SECTION_START;
+      const uint8_t next = (laser_log_head + 1) % LASER_LOG_SIZE;
+      if (next == laser_log_tail) {
+        if (laser_log_lost < 255) laser_log_lost++;
+      }
+      else {
+        laser_log_buffer[laser_log_head].event = event;
+        laser_log_buffer[laser_log_head].value = value;
+        laser_log_head = next;
+      }
+    CRITICAL_SECTION_END;
+  }
+
+  void laser_log_flush() {
+    while (laser_log_tail != laser_log_head) {
+      const laser_log_t &entry = laser_log_buffer[laser_log_tail];
+      ECHO_S(INFO);
+      ECHO_PS((const char*)pgm_read_word(&laser_log_msg[entry.event]));
+      if (entry.event >= LASER_LOG_COUNTER_X) ECHO_V(entry.value);
+      ECHO_E;
+      laser_log_tail = (laser_log_tail + 1) % LASER_LOG_SIZE;
+    }
+
+    if (laser_log_lost) {
+      CRITICAL_SECTION_START;
+        const uint8_t lost = laser_log_lost;
+        laser_log_lost = 0;
+      CRITICAL_SECTION_END;
+      ECHO_LMV(INFO, "Laser diagnostics lost: ", lost);
     }
   }
 
@@ -81,6 +81,28 @@
   void laser_extinguish();
   void laser_update_lifetime();
   void laser_set_mode(int mode);
+
+  // Diagnostics logged from the stepper ISR
+  enum LaserLogEvent {
+    LASER_LOG_FIRED,
+    LASER_LOG_EXTINGUISHED,
+    LASER_LOG_STATUS_OFF,
+    LASER_LOG_DURATION,
+    LASER_LOG_DURATION_FAST,
+    // Events with a value
+    LASER_LOG_COUNTER_X,
+    LASER_LOG_COUNTER_Y,
+    LASER_LOG_COUNTER_L,
+    LASER_LOG_COUNTER_E,
+    LASER_LOG_STEPS_DONE,
+    LASER_LOG_EVENT_COUNT,
+    LASER_LOG_PIXEL
+  };
+
+  #define LASER_LOG_SIZE 16
+
+  void laser_log(const uint8_t event, const long value=0);
+  void laser_log_flush(); // Print the logged diagnostics, called by idle()
   #if ENABLED(LASER_PERIPHERALS)
     bool laser_peripherals_ok();
     void laser_peripherals_on();
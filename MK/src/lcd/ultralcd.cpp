@@ -2266,7 +2266,7 @@ void kill_screen(const char* lcd_msg) {
       for (uint16_t i = 0; i < fileCnt; i++) {
         if (_menuLineNr == _thisItemNr) {
           card.getfilename(
-            #if ENABLED(SDCARD_RATHERRECENTFIRST)
+            #if ENABLED(SDCARD_RATHERRECENTFIRST) && DISABLED(SD_DIR_INDEX_SORT_NAME)
               fileCnt-1 -
             #endif
             i
@@ -2741,7 +2741,7 @@ void kill_screen(const char* lcd_msg) {
 
   #if ENABLED(SDSUPPORT)
 
-    static void menu_action_sdfile(const char* longFilename) {
+    static void lcd_sd_start_print(const char* longFilename) {
       char cmd[30];
       char* c;
       sprintf_P(cmd, PSTR("M23 %s"), longFilename);
@@ -2751,6 +2751,49 @@ void kill_screen(const char* lcd_msg) {
       lcd_return_to_status();
     }
 
+    #if ENABLED(SD_METADATA_CACHE)
+
+      static char sd_selected_name[LONG_FILENAME_LENGTH + 1];
+      static gcode_meta_t sd_selected_meta;
+
+      static void lcd_sdfile_print() { lcd_sd_start_print(sd_selected_name); }
+
+      /**
+       *
+       * "Print from SD" > file, with the metadata cached for the file
+       *
+       */
+      static void lcd_sdfile_info_menu() {
+        char printTime[12], layers[6];
+        sprintf_P(printTime, PSTR("%luh %lum"), sd_selected_meta.printTime / 3600, (sd_selected_meta.printTime / 60) % 60);
+        sprintf_P(layers, PSTR("%u"), sd_selected_meta.layerCount);
+
+        START_MENU();
+        MENU_ITEM(back, MSG_CARD_MENU);
+        MENU_ITEM(function, MSG_START_PRINT, lcd_sdfile_print);
+        STATIC_ITEM(MSG_INFO_PRINT_TIME ": ", false, false, printTime);
+        STATIC_ITEM(MSG_INFO_LAYERS ": ", false, false, layers);
+        STATIC_ITEM(MSG_INFO_HEIGHT ": ", false, false, ftostr52sp(sd_selected_meta.objectHeight));
+        STATIC_ITEM(MSG_FILAMENT ": ", false, false, ftostr52sp(sd_selected_meta.filamentNeeded / 1000));
+        END_MENU();
+      }
+
+    #endif
+
+    static void menu_action_sdfile(const char* longFilename) {
+      #if ENABLED(SD_METADATA_CACHE)
+        // Files already parsed show their metadata before printing
+        if (card.getFileMetadata(sd_selected_meta)) {
+          strncpy(sd_selected_name, longFilename, LONG_FILENAME_LENGTH);
+          sd_selected_name[LONG_FILENAME_LENGTH] = '\0';
+          lcd_save_previous_menu();
+          lcd_goto_screen(lcd_sdfile_info_menu);
+          return;
+        }
+      #endif
+      lcd_sd_start_print(longFilename);
+    }
+
     static void menu_action_sddirectory(const char* longFilename) {
       card.chdir(longFilename);
       encoderPosition = 0;
@@ -593,7 +593,7 @@ static void lcd_implementation_mark_as_selected(uint8_t row, bool isSelected) {
   u8g.setPrintPos((START_COL) * (DOG_CHAR_WIDTH), (row + 1) * (DOG_CHAR_HEIGHT));
 }
 
-#if ENABLED(LCD_INFO_MENU) || ENABLED(FILAMENT_CHANGE_FEATURE)
+#if ENABLED(LCD_INFO_MENU) || ENABLED(FILAMENT_CHANGE_FEATURE) || ENABLED(SD_METADATA_CACHE)
 
   static void lcd_implementation_drawmenu_static(uint8_t row, const char* pstr, bool center=true, bool invert=false, const char* valstr=NULL) {
 
@@ -617,7 +617,7 @@ static void lcd_implementation_mark_as_selected(uint8_t row, bool isSelected) {
     while (n-- > 0) lcd_print(' ');
   }
 
-#endif // LCD_INFO_MENU || FILAMENT_CHANGE_FEATURE
+#endif // LCD_INFO_MENU || FILAMENT_CHANGE_FEATURE || SD_METADATA_CACHE
 
 static void lcd_implementation_drawmenu_generic(bool isSelected, uint8_t row, const char* pstr, char pre_char, char post_char) {
   UNUSED(pre_char);
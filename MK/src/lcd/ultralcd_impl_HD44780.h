@@ -897,7 +897,7 @@ static void lcd_implementation_status_screen() {
   #endif
 }
 
-#if ENABLED(LCD_INFO_MENU) || ENABLED(FILAMENT_CHANGE_FEATURE)
+#if ENABLED(LCD_INFO_MENU) || ENABLED(FILAMENT_CHANGE_FEATURE) || ENABLED(SD_METADATA_CACHE)
 
   static void lcd_implementation_drawmenu_static(uint8_t row, const char* pstr, bool center=true, bool invert=false, const char *valstr=NULL) {
     UNUSED(invert);
@@ -919,7 +919,7 @@ static void lcd_implementation_status_screen() {
     while (n-- > 0) lcd.print(' ');
   }
 
-#endif // LCD_INFO_MENU || FILAMENT_CHANGE_FEATURE
+#endif // LCD_INFO_MENU || FILAMENT_CHANGE_FEATURE || SD_METADATA_CACHE
 
 static void lcd_implementation_drawmenu_generic(bool sel, uint8_t row, const char* pstr, char pre_char, char post_char) {
   char c;
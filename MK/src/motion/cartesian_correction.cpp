@@ -22,7 +22,7 @@
 
 /**
  * cartesian_correction.cpp
- * A class that manages hysteresis by inserting extra planner.buffer_line when necessary
+ * A class that manages hysteresis with take-up steps in the blocks that reverse an axis
  * A class that manages ZWobble
  *
  * Copyright (c) 2012 Neil James Martin
@@ -49,11 +49,11 @@
 #ifdef HYSTERESIS
   //===========================================================================
   Hysteresis hysteresis(DEFAULT_HYSTERESIS_MM);
-  float axis_shift[NUM_AXIS] = { 0.0f, 0.0f, 0.0f, 0.0f };
 
   //===========================================================================
   Hysteresis::Hysteresis(float x_mm, float y_mm, float z_mm, float e_mm) {
     m_prev_direction_bits = 0;
+    for (uint8_t i = 0; i < NUM_AXIS; i++) m_residual_steps[i] = 0;
     Set(x_mm, y_mm, z_mm, e_mm);
   }
 
@@ -63,100 +63,77 @@
     m_hysteresis_mm[Y_AXIS] = y_mm;
     m_hysteresis_mm[Z_AXIS] = z_mm;
     m_hysteresis_mm[E_AXIS] = e_mm;
-
     m_hysteresis_bits = ((m_hysteresis_mm[X_AXIS] != 0.0f) ? (1 << X_AXIS) : 0)
                       | ((m_hysteresis_mm[Y_AXIS] != 0.0f) ? (1 << Y_AXIS) : 0)
                       | ((m_hysteresis_mm[Z_AXIS] != 0.0f) ? (1 << Z_AXIS) : 0)
                       | ((m_hysteresis_mm[E_AXIS] != 0.0f) ? (1 << E_AXIS) : 0);
-
-    calcSteps();
   }
 
   //===========================================================================
   void Hysteresis::SetAxis(uint8_t axis, float mm) {
     m_hysteresis_mm[axis] = mm;
-
     if(mm != 0.0f)  m_hysteresis_bits |=  ( 1 << axis);
     else            m_hysteresis_bits &= ~( 1 << axis);
-
-    calcSteps();
     ReportToSerial();
   }
 
-  //===========================================================================
-  void Hysteresis::calcSteps() {
-    for (uint8_t i = 0; i < NUM_AXIS; i++)
-      m_hysteresis_steps[i] = (long)(m_hysteresis_mm[i] * planner.axis_steps_per_unit[i]);
-  }
-
   //===========================================================================
   void Hysteresis::ReportToSerial() {
     ECHO_SMV(DB, "Hysteresis X", m_hysteresis_mm[X_AXIS]);
     ECHO_MV(" Y", m_hysteresis_mm[Y_AXIS]);
     ECHO_MV(" Z", m_hysteresis_mm[Z_AXIS]);
     ECHO_MV(" E", m_hysteresis_mm[E_AXIS]);
-    ECHO_MV(" SHIFTS: x=", axis_shift[X_AXIS]);
-    ECHO_MV(" y=", axis_shift[Y_AXIS]);
-    ECHO_MV(" z=", axis_shift[Z_AXIS]);
-    ECHO_EMV(" e=", axis_shift[E_AXIS]);
-  }
-
-  //===========================================================================
-  // direction 0: positive, 1: negative
-  uint8_t calc_direction_bits(const long* current_position, const long* destination) {
-    unsigned char direction_bits = 0;
-
-    if (destination[X_AXIS] < current_position[X_AXIS])
-      direction_bits |= (1 << X_AXIS);
-    if (destination[Y_AXIS] < current_position[Y_AXIS])
-      direction_bits |= (1 << Y_AXIS);
-    if (destination[Z_AXIS] < current_position[Z_AXIS])
-      direction_bits |= (1 << Z_AXIS);
-    if (destination[E_AXIS] < current_position[E_AXIS])
-      direction_bits |= (1 << E_AXIS);
-
-    return direction_bits;
-  }
-
-  //===========================================================================
-  uint8_t calc_move_bits(const long* current_position, const long* destination) {
-    uint8_t move_bits = 0;
-
-    if (destination[X_AXIS] != current_position[X_AXIS])
-      move_bits |= (1 << X_AXIS);
-    if (destination[Y_AXIS] != current_position[Y_AXIS])
-      move_bits |= (1 << Y_AXIS);
-    if (destination[Z_AXIS] != current_position[Z_AXIS])
-      move_bits |= (1 << Z_AXIS);
-    if (destination[E_AXIS] != current_position[E_AXIS])
-      move_bits |= (1 << E_AXIS);
-
-    return move_bits;
+    ECHO_MV(" PENDING STEPS: x=", m_residual_steps[X_AXIS]);
+    ECHO_MV(" y=", m_residual_steps[Y_AXIS]);
+    ECHO_MV(" z=", m_residual_steps[Z_AXIS]);
+    ECHO_EMV(" e=", m_residual_steps[E_AXIS]);
   }
 
   //===========================================================================
-  // insert a planner.buffer_line if required to handle any hysteresis
-  void Hysteresis::InsertCorrection(const float x, const float y, const float z, const float e) {
-    long destination[NUM_AXIS] = {x * planner.axis_steps_per_unit[X_AXIS], y * planner.axis_steps_per_unit[Y_AXIS], z * planner.axis_steps_per_unit[Z_AXIS], e * planner.axis_steps_per_unit[E_AXIS + active_extruder]};
-    uint8_t direction_bits = calc_direction_bits(position, destination);
-    uint8_t move_bits = calc_move_bits(position, destination);
-
-    // if the direction has changed in any of the axis that need hysteresis corrections...
-    uint8_t direction_change_bits = (direction_bits ^ m_prev_direction_bits) & move_bits;
-
-    if( (direction_change_bits & m_hysteresis_bits) != 0 ) {
-      // calculate the position to move to that will fix the hysteresis
-      for(uint8_t axis = 0; axis < NUM_AXIS; axis++) {
-        // if this axis changed direction...
-        if(direction_change_bits & (1 << axis)) {
-          long fix = (((direction_bits & (1 << axis)) != 0) ? -m_hysteresis_steps[axis] : m_hysteresis_steps[axis]);
-          //... add the hysteresis: move the current position in the opposite direction so that the next travel move is longer
-          position[axis] -= fix;
-          axis_shift[axis] += fix;
-        }
+  // Called by the planner with the steps of a new block, dm[] is signed.
+  // When an axis reverses, its hysteresis becomes take-up steps of the block.
+  // The stepper ISR gives them with their own counter, over the step events
+  // in which the axis covers its first HYSTERESIS_SMOOTHING_MM, so no extra
+  // block slows the reversal down and steps[] keeps the real move.
+  // A short block takes its share and leaves the rest to the next.
+  void Hysteresis::InsertCorrection(const long dm[NUM_AXIS], block_t* block) {
+    for (uint8_t axis = 0; axis < NUM_AXIS; axis++) {
+      block->hysteresis_steps[axis] = 0;
+      block->hysteresis_events[axis] = 0;
+      if (!dm[axis] || !TEST(m_hysteresis_bits, axis)) continue;
+
+      const bool reverse = dm[axis] < 0;
+      const float steps_per_mm = planner.axis_steps_per_mm[axis < E_AXIS ? axis : E_AXIS + active_extruder];
+
+      // The axis changed direction, the slack is to take up again
+      if (reverse != TEST(m_prev_direction_bits, axis)) {
+        const long hysteresis_steps = lround(m_hysteresis_mm[axis] * steps_per_mm);
+        m_residual_steps[axis] += reverse ? -hysteresis_steps : hysteresis_steps;
+        if (reverse) SBI(m_prev_direction_bits, axis); else CBI(m_prev_direction_bits, axis);
       }
+
+      long correction = m_residual_steps[axis];
+
+      // Slack left from the other direction is taken up when the axis goes back
+      if (!correction || reverse != (correction < 0)) continue;
+
+      // Only the share of the smoothing distance covered by this block,
+      // at most one take-up step for each step of the axis
+      const long axis_steps = labs(dm[axis]),
+                 smoothing_steps = max(1L, lround(HYSTERESIS_SMOOTHING_MM * steps_per_mm)),
+                 span = min(axis_steps, smoothing_steps);
+      if (axis_steps < smoothing_steps)
+        correction = correction * axis_steps / smoothing_steps;
+      correction = constrain(correction, -min(span, 32767L), min(span, 32767L));
+      if (!correction) continue;
+
+      m_residual_steps[axis] -= correction;
+      block->hysteresis_steps[axis] = correction;
+      // The step events in which the axis makes its first span steps
+      block->hysteresis_events[axis] = span < axis_steps
+        ? (unsigned long)((float)block->step_event_count * span / axis_steps) : block->step_event_count;
+      NOLESS(block->hysteresis_events[axis], (unsigned long)labs(correction));
     }
-    m_prev_direction_bits = (direction_bits & move_bits) | (m_prev_direction_bits & ~move_bits);
   }
 
 #endif // HYSTERESIS
@@ -22,7 +22,7 @@
 
 /**
  * cartesian_correction.h
- * A class that manages hysteresis by inserting extra planner.buffer_line when necessary
+ * A class that manages hysteresis with take-up steps in the blocks that reverse an axis
  * A class that manages ZWobble
  *
  * Copyright (c) 2012 Neil James Martin
@@ -55,12 +55,11 @@
       void Set(float x_mm, float y_mm, float z_mm, float e_mm);
       void SetAxis(uint8_t axis, float mm);
       void ReportToSerial();
-      void InsertCorrection(const float x, const float y, const float z, const float e);
+      void InsertCorrection(const long dm[NUM_AXIS], block_t* block);
 
     private:
-      void      calcSteps();
       float     m_hysteresis_mm[NUM_AXIS];
-      long      m_hysteresis_steps[NUM_AXIS];
+      long      m_residual_steps[NUM_AXIS];
       uint8_t   m_prev_direction_bits;
       uint8_t   m_hysteresis_bits;
     };
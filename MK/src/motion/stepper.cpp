@@ -97,6 +97,8 @@ volatile long endstops_stepsTotal, endstops_stepsDone;
 
 #if ENABLED(ADVANCE) || ENABLED(ADVANCE_LPC)
   unsigned char old_OCR0A;
+  volatile unsigned char eISR_Rate = 200; // Keep the ISR at a low rate until needed
+  volatile uint32_t advance_deferred = 0; // Stepper intervals too short for their E steps
   #if ENABLED(ADVANCE)
     static long advance_rate, advance, final_advance = 0;
     static long old_advance = 0;
@@ -104,7 +106,6 @@ volatile long endstops_stepsTotal, endstops_stepsDone;
   #elif ENABLED(ADVANCE_LPC)
     int extruder_advance_k = ADVANCE_LPC_K;
     volatile int e_steps[EXTRUDERS] = ARRAY_BY_EXTRUDERS(0);
-    volatile unsigned char eISR_Rate = 200; // Keep the ISR at a low rate until needed
     static int final_estep_rate;
     static int current_estep_rate[EXTRUDERS]; // Actual extruder speed [steps/s]
     static int current_adv_steps[EXTRUDERS];
@@ -118,6 +119,47 @@ static uint8_t step_loops;
 static uint8_t step_loops_nominal;
 static unsigned short OCR1A_nominal;
 
+#if ENABLED(STEPPER_ISR_STATS)
+  static stepper_stats_t stepper_stats;
+  static bool stepper_starved = false;
+  static uint32_t stepper_starved_us;
+  volatile uint32_t stepper_block_ready_us;
+#endif
+
+#if ENABLED(INPUT_SHAPING)
+
+  #define SHAPING_QUEUE_MASK (SHAPING_QUEUE - 1)
+  #define SHAPING_MIN_FREQ 10.0   // Longer delays don't fit the 16 bit step times
+  #define SHAPING_MIN_TICKS 100   // Don't split a block interval for less than 50us
+  #define SHAPING_NOW() ((uint16_t)(shaping_ticks >> 3)) // 4us ticks
+
+  #if SHAPING_QUEUE > 256
+    typedef uint16_t shaping_index_t;
+  #else
+    typedef uint8_t shaping_index_t;
+  #endif
+
+  typedef struct {
+    uint8_t impulses;               // 1 to 3, the first one is not delayed
+    int16_t amplitude[3];           // 1/256 steps, they sum to 256
+    uint16_t delay[3];              // 4us ticks
+    uint16_t queue[SHAPING_QUEUE];  // Step times in 4us ticks, bit 0 set for a reverse step
+    shaping_index_t head, tail[3];  // tail[i] is the next step the impulse i has to output
+    int16_t error;                  // Shaped position minus output position, 1/256 steps
+    uint8_t dir;                    // Direction pin state: 0 forward, 1 reverse, 2 unknown
+  } shaper_t;
+
+  shaping_settings_t shaping_settings[2] = {
+    { SHAPING_TYPE_X, SHAPING_FREQ_X, SHAPING_ZETA_X },
+    { SHAPING_TYPE_Y, SHAPING_FREQ_Y, SHAPING_ZETA_Y }
+  };
+  volatile uint16_t shaping_overflows = 0;
+
+  static shaper_t shaper[2];
+  static uint32_t shaping_ticks;        // Timer 1 ticks since start
+  static uint16_t shaping_main_ticks;   // Timer 1 ticks left to the next block interrupt, 0 if it's the next one
+#endif
+
 #if PIN_EXISTS(MOTOR_CURRENT_PWM_XY)
   int motor_current_setting[3] = DEFAULT_PWM_MOTOR_CURRENT;
 #endif
@@ -140,7 +182,7 @@ volatile signed char count_direction[NUM_AXIS] = { 1, 1, 1, 1 };
   #define X_APPLY_DIR(v,ALWAYS) \
     if (hotend_duplication_enabled || ALWAYS) { \
       X_DIR_WRITE(v); \
-      X2_DIR_WRITE(v); \
+      X2_DIR_WRITE(hotend_mirror_enabled ? !(v) : (v)); \
     } \
     else { \
       if (current_block->active_driver) X2_DIR_WRITE(v); else X_DIR_WRITE(v); \
@@ -198,6 +240,71 @@ volatile signed char count_direction[NUM_AXIS] = { 1, 1, 1, 1 };
   #define E_APPLY_STEP(v,Q)
 #endif
 
+/**
+ * Step pins sharing an output port are written together. Each step event
+ * sets or clears the bits of all the stepping axes with one write per port.
+ * The ports come from the pins at compile time: a board with all the step
+ * pins on one port gets a single write, a board with every step pin on its
+ * own port gets one write per pin as before.
+ * Layouts with duplicated or switched step pins keep the pin by pin macros.
+ */
+#if DISABLED(DUAL_X_CARRIAGE) && DISABLED(Y_DUAL_STEPPER_DRIVERS) && DISABLED(Z_DUAL_STEPPER_DRIVERS)
+
+  #define STEP_PORTS_GROUPED
+  #if DISABLED(ADVANCE) && DISABLED(ADVANCE_LPC) && DISABLED(COLOR_MIXING_EXTRUDER) && DRIVER_EXTRUDERS == 1
+    #define STEP_PORTS_GROUP_E
+  #endif
+
+  #define _STEP_WPORT(IO) DIO ## IO ## _WPORT
+  #define _STEP_BIT(IO)   MASK(DIO ## IO ## _PIN)
+  #define STEP_WPORT(IO)  _STEP_WPORT(IO)
+  #define STEP_BIT(IO)    _STEP_BIT(IO)
+  #define SAME_STEP_PORT(IO1, IO2) (&STEP_WPORT(IO1) == &STEP_WPORT(IO2))
+
+  // Add the bit of a stepping axis on the port of LEAD
+  #define STEP_PORT_BIT(LEAD, IO, AXIS, INVERT) \
+    if (SAME_STEP_PORT(LEAD, IO) && TEST(axes, AXIS)) { \
+      if (start != INVERT) on |= STEP_BIT(IO); else off |= STEP_BIT(IO); \
+    }
+
+  #if ENABLED(STEP_PORTS_GROUP_E)
+    #define STEP_PORT_BIT_E(LEAD) STEP_PORT_BIT(LEAD, E0_STEP_PIN, E_AXIS, INVERT_E_STEP_PIN)
+  #else
+    #define STEP_PORT_BIT_E(LEAD) NOOP
+  #endif
+
+  // Write the step bits of all the axes on the port of LEAD
+  #define STEP_PORT_WRITE(LEAD) do{ \
+      uint8_t on = 0, off = 0; \
+      STEP_PORT_BIT(LEAD, X_STEP_PIN, X_AXIS, INVERT_X_STEP_PIN); \
+      STEP_PORT_BIT(LEAD, Y_STEP_PIN, Y_AXIS, INVERT_Y_STEP_PIN); \
+      STEP_PORT_BIT(LEAD, Z_STEP_PIN, Z_AXIS, INVERT_Z_STEP_PIN); \
+      STEP_PORT_BIT_E(LEAD); \
+      if (on | off) { \
+        CRITICAL_SECTION_START; \
+        STEP_WPORT(LEAD) = (STEP_WPORT(LEAD) | on) & ~off; \
+        CRITICAL_SECTION_END; \
+      } \
+    }while(0)
+
+  /**
+   * Start (start = true) or end the step pulse of the axes set in 'axes'.
+   * The port comparisons are constant, so only one write per port is compiled.
+   */
+  FORCE_INLINE void write_step_ports(const uint8_t axes, const bool start) {
+    STEP_PORT_WRITE(X_STEP_PIN);
+    if (!SAME_STEP_PORT(X_STEP_PIN, Y_STEP_PIN))
+      STEP_PORT_WRITE(Y_STEP_PIN);
+    if (!SAME_STEP_PORT(X_STEP_PIN, Z_STEP_PIN) && !SAME_STEP_PORT(Y_STEP_PIN, Z_STEP_PIN))
+      STEP_PORT_WRITE(Z_STEP_PIN);
+    #if ENABLED(STEP_PORTS_GROUP_E)
+      if (!SAME_STEP_PORT(X_STEP_PIN, E0_STEP_PIN) && !SAME_STEP_PORT(Y_STEP_PIN, E0_STEP_PIN) && !SAME_STEP_PORT(Z_STEP_PIN, E0_STEP_PIN))
+        STEP_PORT_WRITE(E0_STEP_PIN);
+    #endif
+  }
+
+#endif // !DUAL_X_CARRIAGE && !Y_DUAL_STEPPER_DRIVERS && !Z_DUAL_STEPPER_DRIVERS
+
 // intRes = intIn1 * intIn2 >> 16
 // uses:
 // r26 to store 0
@@ -306,21 +413,27 @@ void st_wake_up() {
   ENABLE_STEPPER_DRIVER_INTERRUPT();
 }
 
-FORCE_INLINE unsigned short calc_timer(unsigned short step_rate) {
+// from_isr is false when the planner pre-computes a block, the timer is then
+// returned unclamped and the ISR clamps it when it starts the block.
+FORCE_INLINE unsigned short calc_timer_loops(unsigned short step_rate, uint8_t &loops, const bool from_isr) {
   unsigned short timer;
 
+  #if ENABLED(STEPPER_ISR_STATS)
+    if (from_isr) NOLESS(stepper_stats.step_rate_max, step_rate);
+  #endif
+
   NOMORE(step_rate, MAX_STEP_FREQUENCY);
 
   if(step_rate > (2 * DOUBLE_STEP_FREQUENCY)) { // If steprate > 2*DOUBLE_STEP_FREQUENCY >> step 4 times
     step_rate >>= 2;
-    step_loops = 4;
+    loops = 4;
   }
   else if(step_rate > DOUBLE_STEP_FREQUENCY) { // If steprate > DOUBLE_STEP_FREQUENCY >> step 2 times
     step_rate >>= 1;
-    step_loops = 2;
+    loops = 2;
   }
   else {
-    step_loops = 1;
+    loops = 1;
   }
 
   NOLESS(step_rate, F_CPU / 500000);
@@ -339,14 +452,22 @@ FORCE_INLINE unsigned short calc_timer(unsigned short step_rate) {
     timer -= (((unsigned short)pgm_read_word_near(table_address + 2) * (unsigned char)(step_rate & 0x0007)) >> 3);
   }
 
-  if (timer < 100) { // (20kHz this should never happen)
+  if (from_isr && timer < 100) { // (20kHz this should never happen)
     timer = 100;
+    #if ENABLED(STEPPER_ISR_STATS)
+      stepper_stats.too_high++;
+    #endif
     ECHO_EMV(SERIAL_STEPPER_TOO_HIGH, step_rate);
   }
 
   return timer;
 }
 
+FORCE_INLINE unsigned short calc_timer(unsigned short step_rate) { return calc_timer_loops(step_rate, step_loops, true); }
+
+// Timer interval and step loops for the planner, which pre-computes them for each block
+unsigned short st_calc_timer(const unsigned short step_rate, uint8_t &loops) { return calc_timer_loops(step_rate, loops, false); }
+
 /**
  * Set the stepper direction of each axis
  *
@@ -366,8 +487,14 @@ void set_stepper_direction(bool onlye) {
     }
 
   if (!onlye) {
-    SET_STEP_DIR(X); // A
-    SET_STEP_DIR(Y); // B
+    #if ENABLED(INPUT_SHAPING)
+      // The shaper writes the X and Y direction pins with its steps
+      count_direction[X_AXIS] = motor_direction(X_AXIS) ? -1 : 1; // A
+      count_direction[Y_AXIS] = motor_direction(Y_AXIS) ? -1 : 1; // B
+    #else
+      SET_STEP_DIR(X); // A
+      SET_STEP_DIR(Y); // B
+    #endif
     SET_STEP_DIR(Z); // C
   }
 
@@ -403,14 +530,27 @@ FORCE_INLINE void trapezoid_generator_reset() {
     old_advance = advance >>8;
   #endif
   deceleration_time = 0;
-  // step_rate to timer interval
-  OCR1A_nominal = calc_timer(current_block->nominal_rate);
-  // make a note of the number of step loops required at nominal speed
-  step_loops_nominal = step_loops;
+  // Timer intervals and step loops pre-computed by the planner
+  OCR1A_nominal = current_block->nominal_timer;
+  step_loops_nominal = current_block->nominal_step_loops;
   acc_step_rate = current_block->initial_rate;
-  acceleration_time = calc_timer(acc_step_rate);
+  acceleration_time = current_block->initial_timer;
+  NOLESS(acceleration_time, 100);
+  step_loops = current_block->initial_step_loops;
   OCR1A = acceleration_time;
 
+  // The planner pre-computed the timers, clamp and account for them once per block here
+  #if ENABLED(STEPPER_ISR_STATS)
+    NOLESS(stepper_stats.step_rate_max, (unsigned short)min(current_block->nominal_rate, 0xFFFFUL));
+  #endif
+  if (OCR1A_nominal < 100) { // (20kHz this should never happen)
+    OCR1A_nominal = 100;
+    #if ENABLED(STEPPER_ISR_STATS)
+      stepper_stats.too_high++;
+    #endif
+    ECHO_EMV(SERIAL_STEPPER_TOO_HIGH, (F_CPU / 8UL / OCR1A_nominal) * step_loops_nominal);
+  }
+
   #if ENABLED(ADVANCE_LPC)
     if (current_block->use_advance_lead) {
       current_estep_rate[current_block->active_driver] = ((unsigned long)acc_step_rate * current_block->e_speed_multiplier8) >> 8;
@@ -419,11 +559,422 @@ FORCE_INLINE void trapezoid_generator_reset() {
   #endif
 }
 
+#if ENABLED(ADVANCE) || ENABLED(ADVANCE_LPC)
+
+  /**
+   * Spread the pending E steps evenly over the next stepper interval.
+   * The advance ISR makes one step per interrupt, at least ADVANCE_E_MIN_INTERVAL
+   * timer 0 ticks apart. If the steps don't fit they run over into the next
+   * interval, and the event is counted in advance_deferred.
+   */
+  FORCE_INLINE void schedule_e_steps(const unsigned short timer) {
+    #if ENABLED(COLOR_MIXING_EXTRUDER)
+      uint16_t pending = 0;
+      for (uint8_t j = 0; j < DRIVER_EXTRUDERS; j++) NOLESS(pending, abs(e_steps[j]));
+    #else
+      const uint16_t pending = abs(e_steps[current_block->active_driver]);
+    #endif
+
+    if (!pending) {
+      eISR_Rate = 200;
+      return;
+    }
+
+    const uint16_t interval = timer >> 3; // Timer 1 ticks (0.5us) to timer 0 ticks (4us)
+    uint16_t rate = interval / pending;
+    if (rate < ADVANCE_E_MIN_INTERVAL) {
+      rate = ADVANCE_E_MIN_INTERVAL;
+      advance_deferred++;
+    }
+    eISR_Rate = min(rate, 255);
+  }
+
+#endif // ADVANCE || ADVANCE_LPC
+
+#if ENABLED(INPUT_SHAPING)
+
+  /**
+   * Input shaping
+   *
+   * The block steps of X and Y don't go to the pins. Each one is split in
+   * impulses that move the shaped position by a fraction of a step, the
+   * first one at once and the others after their delay. The pins follow
+   * the shaped position, rounded to whole steps.
+   * The steps waiting for the delayed impulses are kept in a queue with
+   * their time. When the next impulse is due before the next block step
+   * the interrupt runs for it alone, then the block goes on.
+   */
+
+  FORCE_INLINE void shaper_echo(shaper_t &s, const uint8_t i) {
+    s.error += TEST(s.queue[s.tail[i]], 0) ? -s.amplitude[i] : s.amplitude[i];
+    s.tail[i] = (s.tail[i] + 1) & SHAPING_QUEUE_MASK;
+  }
+
+  // A step from the block: the first impulse now, the others queued
+  FORCE_INLINE void shaper_input(shaper_t &s, const bool reverse, const uint16_t now) {
+    s.error += reverse ? -s.amplitude[0] : s.amplitude[0];
+    if (s.impulses < 2) return;
+
+    const shaping_index_t next = (s.head + 1) & SHAPING_QUEUE_MASK,
+                          oldest = s.tail[s.impulses - 1];
+    if (next == oldest) {
+      // Queue full, the oldest step gives its impulses now
+      for (uint8_t i = 1; i < s.impulses; i++)
+        if (s.tail[i] == oldest) shaper_echo(s, i);
+      shaping_overflows++;
+    }
+    s.queue[s.head] = (now & 0xFFFE) | (reverse ? 1 : 0);
+    s.head = next;
+  }
+
+  // Apply the delayed impulses that are due
+  FORCE_INLINE void shaper_update(shaper_t &s, const uint16_t now) {
+    for (uint8_t i = 1; i < s.impulses; i++)
+      while (s.tail[i] != s.head && (uint16_t)(now - (s.queue[s.tail[i]] & 0xFFFE)) >= s.delay[i])
+        shaper_echo(s, i);
+  }
+
+  // 4us ticks to the next delayed impulse, 0xFFFF if none
+  FORCE_INLINE uint16_t shaper_next(const shaper_t &s, const uint16_t now) {
+    uint16_t next = 0xFFFF;
+    for (uint8_t i = 1; i < s.impulses; i++) {
+      if (s.tail[i] != s.head) {
+        const int16_t left = (s.queue[s.tail[i]] & 0xFFFE) + s.delay[i] - now;
+        NOMORE(next, (uint16_t)max(left, 0));
+      }
+    }
+    return next;
+  }
+
+  #if ENABLED(STEPPER_HIGH_LOW) && STEPPER_HIGH_LOW_DELAY > 0
+    #define SHAPER_PULSE_DELAY() HAL::delayMicroseconds(STEPPER_HIGH_LOW_DELAY)
+  #else
+    #define SHAPER_PULSE_DELAY() NOOP
+  #endif
+
+  // The drivers need the direction some time before the step
+  #if SHAPING_DIR_DELAY > 0
+    #define SHAPER_DIR_DELAY() HAL::delayMicroseconds(SHAPING_DIR_DELAY)
+  #else
+    #define SHAPER_DIR_DELAY() NOOP
+  #endif
+
+  // Step the pins to the shaped position
+  #define SHAPER_OUTPUT(AXIS) { \
+    shaper_t &s = shaper[_AXIS(AXIS)]; \
+    while (s.error >= 128 || s.error < -128) { \
+      const uint8_t dir = s.error < 0 ? 1 : 0; \
+      if (dir != s.dir) { \
+        s.dir = dir; \
+        AXIS ##_APPLY_DIR(dir ? INVERT_## AXIS ##_DIR : !INVERT_## AXIS ##_DIR, false); \
+        SHAPER_DIR_DELAY(); \
+      } \
+      AXIS ##_APPLY_STEP(!INVERT_## AXIS ##_STEP_PIN, 0); \
+      s.error += dir ? 256 : -256; \
+      SHAPER_PULSE_DELAY(); \
+      AXIS ##_APPLY_STEP(INVERT_## AXIS ##_STEP_PIN, 0); \
+    } \
+  }
+
+  FORCE_INLINE void shaping_output() {
+    const uint16_t now = SHAPING_NOW();
+    shaper_update(shaper[X_AXIS], now);
+    shaper_update(shaper[Y_AXIS], now);
+    SHAPER_OUTPUT(X);
+    SHAPER_OUTPUT(Y);
+  }
+
+  // Interrupt again after main_ticks, or sooner for a delayed impulse
+  FORCE_INLINE void shaping_schedule(uint16_t main_ticks) {
+    const uint16_t now = SHAPING_NOW(),
+                   earliest = TCNT1 + 16;
+
+    uint16_t echo = min(shaper_next(shaper[X_AXIS], now), shaper_next(shaper[Y_AXIS], now));
+    echo = echo < 0x2000 ? echo << 3 : 0xFFFF; // Timer 0 ticks (4us) to timer 1 ticks (0.5us)
+    NOLESS(echo, earliest);
+    NOLESS(main_ticks, earliest);
+
+    if (echo < main_ticks && main_ticks - echo > SHAPING_MIN_TICKS) {
+      OCR1A = echo;
+      shaping_main_ticks = main_ticks - echo;
+    }
+    else {
+      OCR1A = main_ticks;
+      shaping_main_ticks = 0;
+    }
+  }
+
+  // Drop the delayed impulses, the positions go back to the output steps
+  static void shaping_discard() {
+    for (uint8_t axis = X_AXIS; axis <= Y_AXIS; axis++) {
+      shaper_t &s = shaper[axis];
+      long lag = s.error;
+      for (uint8_t i = 1; i < s.impulses; i++)
+        while (s.tail[i] != s.head) {
+          lag += TEST(s.queue[s.tail[i]], 0) ? -s.amplitude[i] : s.amplitude[i];
+          s.tail[i] = (s.tail[i] + 1) & SHAPING_QUEUE_MASK;
+        }
+      count_position[axis] -= lag / 256; // Output steps are whole, lag is too
+      s.error = 0;
+    }
+  }
+
+  bool shaping_busy() {
+    bool busy = false;
+    CRITICAL_SECTION_START;
+      for (uint8_t axis = X_AXIS; axis <= Y_AXIS; axis++)
+        for (uint8_t i = 1; i < shaper[axis].impulses; i++)
+          if (shaper[axis].tail[i] != shaper[axis].head) busy = true;
+    CRITICAL_SECTION_END;
+    return busy;
+  }
+
+  /**
+   * Impulses of the shapers, for the damped ringing period Td:
+   *  ZV:  1, K             at 0, Td/2
+   *  ZVD: 1, 2K, K^2       at 0, Td/2, Td
+   *  MZV: a, (sqrt2-1)K', aK'^2 at 0, 3Td/8, 3Td/4 (a = 1 - 1/sqrt2)
+   * with K = exp(-zeta*pi/sqrt(1-zeta^2)) and K' = K^0.75, normalized to 1.
+   */
+  void shaping_refresh() {
+    st_synchronize();
+
+    for (uint8_t axis = X_AXIS; axis <= Y_AXIS; axis++) {
+      shaping_settings_t &cfg = shaping_settings[axis];
+      NOMORE(cfg.type, SHAPER_MZV);
+      NOLESS(cfg.frequency, SHAPING_MIN_FREQ);
+      cfg.zeta = constrain(cfg.zeta, 0.0, 0.5);
+
+      const float damped = sqrt(1.0 - cfg.zeta * cfg.zeta),
+                  period = 1.0 / (cfg.frequency * damped),
+                  K = exp(-cfg.zeta * M_PI / damped);
+      float amp[3] = { 1.0, 0.0, 0.0 }, at[3] = { 0.0, 0.0, 0.0 };
+      uint8_t impulses = 1;
+
+      switch (cfg.type) {
+        case SHAPER_ZV:
+          impulses = 2;
+          amp[1] = K;
+          at[1] = 0.5;
+          break;
+        case SHAPER_ZVD:
+          impulses = 3;
+          amp[1] = 2.0 * K; amp[2] = K * K;
+          at[1] = 0.5; at[2] = 1.0;
+          break;
+        case SHAPER_MZV: {
+          const float Km = pow(K, 0.75), a = 1.0 - M_SQRT1_2;
+          impulses = 3;
+          amp[0] = a; amp[1] = (M_SQRT2 - 1.0) * Km; amp[2] = a * Km * Km;
+          at[1] = 0.375; at[2] = 0.75;
+        } break;
+      }
+
+      const float sum = amp[0] + amp[1] + amp[2];
+      int16_t amplitude[3] = { 256, 0, 0 };
+      uint16_t delay[3] = { 0, 0, 0 };
+      for (uint8_t i = 1; i < impulses; i++) {
+        amplitude[i] = amp[i] * 256.0 / sum + 0.5;
+        amplitude[0] -= amplitude[i];
+        delay[i] = at[i] * period * 250000.0 + 0.5;
+      }
+
+      // Steps of the longest delay at the max feedrate, the queue must hold them
+      const float rate = min(planner.max_feedrate_mm_s[axis] * planner.axis_steps_per_mm[axis], (float)(MAX_STEP_FREQUENCY));
+      const uint16_t needed = rate * delay[impulses - 1] * 0.000004 + 1;
+      if (needed >= SHAPING_QUEUE) {
+        ECHO_SMV(ER, "Input shaping queue too short for ", axis == X_AXIS ? 'X' : 'Y');
+        ECHO_EMV(", SHAPING_QUEUE needed: ", needed);
+      }
+
+      CRITICAL_SECTION_START;
+        shaper_t &s = shaper[axis];
+        s.impulses = impulses;
+        memcpy(s.amplitude, amplitude, sizeof(amplitude));
+        memcpy(s.delay, delay, sizeof(delay));
+        s.tail[0] = s.tail[1] = s.tail[2] = s.head;
+        s.dir = 2;
+      CRITICAL_SECTION_END;
+    }
+  }
+
+#endif // INPUT_SHAPING
+
+#if ENABLED(HYSTERESIS)
+
+  /**
+   * Hysteresis take-up
+   *
+   * The take-up steps of a block have their own Bresenham counter, spread
+   * over the step events in which the axis covers HYSTERESIS_SMOOTHING_MM.
+   * They go to the pins after the steps of the move, in the same direction,
+   * and never to count_position: the positions stay the planned ones.
+   */
+
+  static long hysteresis_counter[NUM_AXIS];
+  static uint16_t hysteresis_left[NUM_AXIS];
+  static uint8_t hysteresis_axes; // Axes with take-up steps left in the block
+
+  #if ENABLED(STEPPER_HIGH_LOW) && STEPPER_HIGH_LOW_DELAY > 0
+    #define HYSTERESIS_PULSE_DELAY() HAL::delayMicroseconds(STEPPER_HIGH_LOW_DELAY)
+  #else
+    #define HYSTERESIS_PULSE_DELAY() NOOP
+  #endif
+
+  FORCE_INLINE void hysteresis_reset() {
+    hysteresis_axes = 0;
+    LOOP_XYZE(i) {
+      hysteresis_left[i] = abs(current_block->hysteresis_steps[i]);
+      if (hysteresis_left[i]) {
+        hysteresis_counter[i] = -(current_block->hysteresis_events[i] >> 1);
+        SBI(hysteresis_axes, i);
+      }
+    }
+  }
+
+  // Is a take-up step of the axis due in this step event?
+  FORCE_INLINE bool hysteresis_due(const uint8_t axis) {
+    if (!TEST(hysteresis_axes, axis)) return false;
+    hysteresis_counter[axis] += abs(current_block->hysteresis_steps[axis]);
+    if (hysteresis_counter[axis] <= 0) return false;
+    hysteresis_counter[axis] -= current_block->hysteresis_events[axis];
+    if (!--hysteresis_left[axis]) CBI(hysteresis_axes, axis);
+    return true;
+  }
+
+  #if ENABLED(COLOR_MIXING_EXTRUDER)
+    // Each driver of the mix takes up its own slack
+    #define E_TAKE_UP_STEP(v) \
+      for (uint8_t j = 0; j < DRIVER_EXTRUDERS; j++) \
+        if (current_block->mix_event_count[j]) En_STEP_WRITE(j, v)
+  #else
+    #define E_TAKE_UP_STEP(v) E_APPLY_STEP(v, 0)
+  #endif
+
+  FORCE_INLINE void hysteresis_take_up() {
+    uint8_t due = 0;
+    LOOP_XYZE(i) if (hysteresis_due(i)) SBI(due, i);
+    if (!due) return;
+
+    #if ENABLED(INPUT_SHAPING)
+      // X and Y through the shaper, like the steps of the move
+      if (TEST(due, X_AXIS)) shaper_input(shaper[X_AXIS], count_direction[X_AXIS] < 0, SHAPING_NOW());
+      if (TEST(due, Y_AXIS)) shaper_input(shaper[Y_AXIS], count_direction[Y_AXIS] < 0, SHAPING_NOW());
+    #endif
+
+    #if ENABLED(ADVANCE) || ENABLED(ADVANCE_LPC)
+      // The E steps are given by the advance ISR
+      if (TEST(due, E_AXIS)) {
+        const int8_t dir = motor_direction(E_AXIS) ? -1 : 1;
+        #if ENABLED(ADVANCE) && ENABLED(COLOR_MIXING_EXTRUDER)
+          for (uint8_t j = 0; j < DRIVER_EXTRUDERS; j++)
+            if (current_block->mix_event_count[j]) e_steps[j] += dir;
+        #else
+          e_steps[current_block->active_driver] += dir;
+        #endif
+      }
+    #endif
+
+    // Low time after the steps of the move
+    HYSTERESIS_PULSE_DELAY();
+
+    #if DISABLED(INPUT_SHAPING)
+      if (TEST(due, X_AXIS)) X_APPLY_STEP(!INVERT_X_STEP_PIN, 0);
+      if (TEST(due, Y_AXIS)) Y_APPLY_STEP(!INVERT_Y_STEP_PIN, 0);
+    #endif
+    if (TEST(due, Z_AXIS)) Z_APPLY_STEP(!INVERT_Z_STEP_PIN, 0);
+    #if DISABLED(ADVANCE) && DISABLED(ADVANCE_LPC)
+      if (TEST(due, E_AXIS)) E_TAKE_UP_STEP(!INVERT_E_STEP_PIN);
+    #endif
+
+    HYSTERESIS_PULSE_DELAY();
+
+    #if DISABLED(INPUT_SHAPING)
+      if (TEST(due, X_AXIS)) X_APPLY_STEP(INVERT_X_STEP_PIN, 0);
+      if (TEST(due, Y_AXIS)) Y_APPLY_STEP(INVERT_Y_STEP_PIN, 0);
+    #endif
+    if (TEST(due, Z_AXIS)) Z_APPLY_STEP(INVERT_Z_STEP_PIN, 0);
+    #if DISABLED(ADVANCE) && DISABLED(ADVANCE_LPC)
+      if (TEST(due, E_AXIS)) E_TAKE_UP_STEP(INVERT_E_STEP_PIN);
+    #endif
+  }
+
+#endif // HYSTERESIS
+
 // "The Stepper Driver Interrupt" - This timer interrupt is the workhorse.
 // It pops blocks from the block_buffer and executes them by pulsing the stepper pins appropriately.
-ISR(TIMER1_COMPA_vect) { isr(); }
+//
+// The step loop runs with interrupts enabled so the serial RX interrupt
+// can store incoming chars while it generates pulses. The stepper,
+// temperature and advance interrupts are held back until it ends.
+//
+ISR(TIMER1_COMPA_vect) {
+  #if ENABLED(STEPPER_ISR_STATS)
+    // Timer 1 runs at 2MHz and restarts from 0 on the compare match
+    const uint16_t isr_start = TCNT1;
+  #endif
 
-void isr() {
+  const uint8_t timsk0 = TIMSK0;
+  TIMSK0 &= ~(_BV(OCIE0A) | _BV(OCIE0B));
+  DISABLE_STEPPER_DRIVER_INTERRUPT();
+  sei();
+
+  isr();
+
+  cli();
+  TIMSK0 = timsk0;
+  ENABLE_STEPPER_DRIVER_INTERRUPT();
+
+  #if ENABLED(STEPPER_ISR_STATS)
+    // The difference is right also when the timer rolled over at 0xFFFF.
+    // A compare match during the ISR restarted it from 0 after OCR1A,
+    // taken as the interval isr() just set, as it is set before it ends.
+    uint16_t isr_ticks = TCNT1 - isr_start;
+    if (TEST(TIFR1, OCF1A)) isr_ticks += OCR1A + 1;
+    NOMORE(stepper_stats.isr_min, isr_ticks);
+    NOLESS(stepper_stats.isr_max, isr_ticks);
+    stepper_stats.isr_sum += isr_ticks;
+    stepper_stats.isr_count++;
+  #endif
+}
+
+#if ENABLED(STEPPER_ISR_STATS)
+
+  void stepper_stats_reset() {
+    CRITICAL_SECTION_START;
+      memset(&stepper_stats, 0, sizeof(stepper_stats));
+      stepper_stats.isr_min = 0xFFFF;
+    CRITICAL_SECTION_END;
+  }
+
+  /**
+   * Report the stepper ISR statistics, durations in us
+   */
+  void stepper_stats_report() {
+    CRITICAL_SECTION_START;
+      const stepper_stats_t stats = stepper_stats;
+    CRITICAL_SECTION_END;
+
+    ECHO_SMV(DB, "ISR us min:", stats.isr_count ? stats.isr_min * 0.5 : 0.0);
+    ECHO_MV(" avg:", stats.isr_count ? stats.isr_sum * 0.5 / stats.isr_count : 0.0);
+    ECHO_MV(" max:", stats.isr_max * 0.5);
+    ECHO_EMV(" count:", stats.isr_count);
+    ECHO_SMV(DB, "Step loops x1:", stats.step_loops[0]);
+    ECHO_MV(" x2:", stats.step_loops[1]);
+    ECHO_EMV(" x4:", stats.step_loops[2]);
+    ECHO_SMV(DB, "Steprate max:", stats.step_rate_max);
+    ECHO_MV("/", MAX_STEP_FREQUENCY);
+    ECHO_EMV(" too high:", stats.too_high);
+    ECHO_SMV(DB, "Underruns:", stats.underruns);
+    ECHO_EMV(" Block start latency us max:", stats.latency_max);
+    #if ENABLED(ADVANCE) || ENABLED(ADVANCE_LPC)
+      ECHO_LMV(DB, "Advance steps deferred:", advance_deferred);
+    #endif
+  }
+
+#endif // STEPPER_ISR_STATS
+
+FORCE_INLINE void block_isr() {
 
   if (cleaning_buffer_counter) {
     current_block = NULL;
@@ -438,8 +989,7 @@ void isr() {
 
   #if ENABLED(LASERBEAM) && (!ENABLED(LASER_PULSE_METHOD))
     if (laser.dur != 0 && (laser.last_firing + laser.dur < micros())) {
-      if (laser.diagnostics)
-        ECHO_LM(INFO, "Laser firing duration elapsed, in interrupt handler");
+      if (laser.diagnostics) laser_log(LASER_LOG_DURATION);
 
       laser_extinguish();
     }
@@ -451,6 +1001,27 @@ void isr() {
     current_block = planner.get_current_block();
     if (current_block) {
       current_block->busy = true;
+
+      #if ENABLED(PLANNED_TOOL_OFFSET)
+        // The planner switched to the new tool coordinates before this block
+        if (current_block->sync_position) {
+          LOOP_XYZ(i) count_position[i] += planner.position_sync[i];
+          planner.position_sync_queued = false;
+        }
+      #endif
+
+      #if ENABLED(HYSTERESIS)
+        hysteresis_reset();
+      #endif
+
+      #if ENABLED(STEPPER_ISR_STATS)
+        const uint32_t now_us = micros();
+        NOLESS(stepper_stats.latency_max, now_us - stepper_block_ready_us);
+        if (stepper_starved && now_us - stepper_starved_us < STEPPER_ISR_UNDERRUN_MS * 1000UL)
+          stepper_stats.underruns++;
+        stepper_starved = false;
+      #endif
+
       trapezoid_generator_reset();
 
       // Initialize Bresenham counters to 1/2 the ceiling
@@ -471,7 +1042,8 @@ void isr() {
       step_events_completed = 0;
 
       #if ENABLED(Z_LATE_ENABLE)
-        if (current_block->steps[Z_AXIS] > 0) {
+        // Normally check_axes_activity() has enabled Z while the previous block ran
+        if (current_block->steps[Z_AXIS] > 0 && Z_ENABLE_READ != Z_ENABLE_ON) {
           enable_z();
           OCR1A = 2000; // 1ms wait
           return;
@@ -507,17 +1079,19 @@ void isr() {
 
       #if !ENABLED(LASER_PULSE_METHOD)
         if (current_block->laser_status == LASER_OFF) {
-          if (laser.diagnostics) ECHO_LM(INFO,"Laser status set to off, in interrupt handler");
+          if (laser.diagnostics) laser_log(LASER_LOG_STATUS_OFF);
           laser_extinguish();
         }
       #endif
     #endif
 
+    #if ENABLED(STEPPER_ISR_STATS)
+      stepper_stats.step_loops[step_loops >> 1]++; // 1, 2, 4 => 0, 1, 2
+    #endif
+
     // Take multiple steps per interrupt (For high speed moves)
     for (uint8_t i = 0; i < step_loops; i++) {
 
-        MKSERIAL.checkRx(); // Check for serial chars.
-
       #if ENABLED(ADVANCE)
         counter_E += current_block->steps[E_AXIS];
         if (counter_E > 0) {
@@ -583,29 +1157,94 @@ void isr() {
           } \
         }
 
-      STEP_START(X);
-      STEP_START(Y);
-      STEP_START(Z);
+      #if ENABLED(INPUT_SHAPING)
+        // X and Y steps go to the shaper, it steps the pins after the loop
+        #define SHAPED_STEP(AXIS) \
+          _COUNTER(AXIS) += current_block->steps[_AXIS(AXIS)]; \
+          if (_COUNTER(AXIS) > 0) { \
+            _COUNTER(AXIS) -= current_block->step_event_count; \
+            count_position[_AXIS(AXIS)] += count_direction[_AXIS(AXIS)]; \
+            shaper_input(shaper[_AXIS(AXIS)], count_direction[_AXIS(AXIS)] < 0, SHAPING_NOW()); \
+          }
+
+        SHAPED_STEP(X);
+        SHAPED_STEP(Y);
+      #endif
+
+      #if ENABLED(STEP_PORTS_GROUPED)
+
+        uint8_t step_axes = 0;
+
+        #define GROUP_STEP_START(AXIS) \
+          _COUNTER(AXIS) += current_block->steps[_AXIS(AXIS)]; \
+          if (_COUNTER(AXIS) > 0) SBI(step_axes, _AXIS(AXIS));
+
+        #define GROUP_STEP_END(AXIS) \
+          if (TEST(step_axes, _AXIS(AXIS))) { \
+            _COUNTER(AXIS) -= current_block->step_event_count; \
+            count_position[_AXIS(AXIS)] += count_direction[_AXIS(AXIS)]; \
+          }
+
+        #if DISABLED(INPUT_SHAPING)
+          GROUP_STEP_START(X);
+          GROUP_STEP_START(Y);
+        #endif
+        GROUP_STEP_START(Z);
+      #else
+        #if DISABLED(INPUT_SHAPING)
+          STEP_START(X);
+          STEP_START(Y);
+        #endif
+        STEP_START(Z);
+      #endif
       #if DISABLED(ADVANCE) && DISABLED(ADVANCE_LPC)
-        STEP_START(E);
+        #if ENABLED(STEP_PORTS_GROUP_E)
+          GROUP_STEP_START(E);
+        #else
+          STEP_START(E);
+        #endif
         #if ENABLED(COLOR_MIXING_EXTRUDER)
           STEP_START_MIXING;
         #endif
       #endif
+      #if ENABLED(STEP_PORTS_GROUPED)
+        write_step_ports(step_axes, true);
+      #endif
 
       #if ENABLED(STEPPER_HIGH_LOW) && STEPPER_HIGH_LOW_DELAY > 0
         HAL::delayMicroseconds(STEPPER_HIGH_LOW_DELAY);
       #endif
 
-      STEP_END(X);
-      STEP_END(Y);
-      STEP_END(Z);
+      #if ENABLED(STEP_PORTS_GROUPED)
+        #if DISABLED(INPUT_SHAPING)
+          GROUP_STEP_END(X);
+          GROUP_STEP_END(Y);
+        #endif
+        GROUP_STEP_END(Z);
+      #else
+        #if DISABLED(INPUT_SHAPING)
+          STEP_END(X);
+          STEP_END(Y);
+        #endif
+        STEP_END(Z);
+      #endif
       #if DISABLED(ADVANCE) && DISABLED(ADVANCE_LPC)
-        STEP_END(E);
+        #if ENABLED(STEP_PORTS_GROUP_E)
+          GROUP_STEP_END(E);
+        #else
+          STEP_END(E);
+        #endif
         #if ENABLED(COLOR_MIXING_EXTRUDER)
           STEP_END_MIXING;
         #endif
       #endif
+      #if ENABLED(STEP_PORTS_GROUPED)
+        write_step_ports(step_axes, false);
+      #endif
+
+      #if ENABLED(HYSTERESIS)
+        if (hysteresis_axes) hysteresis_take_up();
+      #endif
 
       #if ENABLED(LASERBEAM)
         counter_L += current_block->steps_l;
@@ -619,9 +1258,9 @@ void isr() {
               laser_fire(current_block->laser_intensity);
             #endif
             if (laser.diagnostics) {
-              ECHO_MV("X: ", counter_X);
-              ECHO_MV("Y: ", counter_Y);
-              ECHO_MV("L: ", counter_L);
+              laser_log(LASER_LOG_COUNTER_X, counter_X);
+              laser_log(LASER_LOG_COUNTER_Y, counter_Y);
+              laser_log(LASER_LOG_COUNTER_L, counter_L);
             }
           }
           #if ENABLED(LASER_RASTER)
@@ -637,7 +1276,7 @@ void isr() {
                 // going from darkened paper to burning through paper.
                 laser_fire(current_block->laser_raster_data[counter_raster]); 
               #endif
-              if (laser.diagnostics) ECHO_EMV("Pixel: ", (float)current_block->laser_raster_data[counter_raster]);
+              if (laser.diagnostics) laser_log(LASER_LOG_PIXEL, current_block->laser_raster_data[counter_raster]);
               counter_raster++;
             }
           #endif // LASER_RASTER
@@ -646,16 +1285,14 @@ void isr() {
         #if !ENABLED(LASER_PULSE_METHOD)
         if (current_block->laser_duration != 0 && (laser.last_firing + current_block->laser_duration < micros())) {
           if (laser.diagnostics) {
-            ECHO_MV("X: ", counter_X);
-            ECHO_MV(", Y: ", counter_Y);
-            ECHO_MV(", L: ", counter_L);
-            ECHO_MV(", Z: ", counter_L);
-            ECHO_MV(", E: ", counter_E);
-            ECHO_MV(", steps done: ",step_events_completed);
-            ECHO_MV(", event count: ", current_block->step_event_count);
-            ECHO_EM(", <--------------------");
-            ECHO_LM(INFO, "Laser firing duration elapsed, in interrupt fast loop ");
-			 }
+            laser_log(LASER_LOG_COUNTER_X, counter_X);
+            laser_log(LASER_LOG_COUNTER_Y, counter_Y);
+            laser_log(LASER_LOG_COUNTER_L, counter_L);
+            laser_log(LASER_LOG_COUNTER_E, counter_E);
+            laser_log(LASER_LOG_STEPS_DONE, step_events_completed);
+            laser_log(LASER_LOG_EVENT_COUNT, current_block->step_event_count);
+            laser_log(LASER_LOG_DURATION_FAST);
+          }
           laser_extinguish();
         }
         #endif
@@ -706,7 +1343,7 @@ void isr() {
       #endif
 
       #if ENABLED(ADVANCE) || ENABLED(ADVANCE_LPC)
-        eISR_Rate = (timer >> 2) * step_loops / abs(e_steps[current_block->active_driver]);
+        schedule_e_steps(timer);
       #endif
     }
     else if (step_events_completed > (unsigned long)current_block->decelerate_after) {
@@ -746,15 +1383,17 @@ void isr() {
       #endif
 
       #if ENABLED(ADVANCE) || ENABLED(ADVANCE_LPC)
-        eISR_Rate = (timer >> 2) * step_loops / abs(e_steps[current_block->active_driver]);
+        schedule_e_steps(timer);
       #endif
     }
     else {
       #if ENABLED(ADVANCE_LPC)
         if (current_block->use_advance_lead)
           current_estep_rate[current_block->active_driver] = final_estep_rate;
+      #endif
 
-        eISR_Rate = (OCR1A_nominal >> 2) * step_loops_nominal / abs(e_steps[current_block->active_driver]);
+      #if ENABLED(ADVANCE) || ENABLED(ADVANCE_LPC)
+        schedule_e_steps(OCR1A_nominal);
       #endif
 
       OCR1A = OCR1A_nominal;
@@ -768,6 +1407,14 @@ void isr() {
     if (step_events_completed >= current_block->step_event_count) {
       current_block = NULL;
       planner.discard_current_block();
+      #if ENABLED(STEPPER_ISR_STATS)
+        // The next block is ready now, or when the planner queues it
+        stepper_block_ready_us = micros();
+        if (!planner.blocks_queued()) {
+          stepper_starved = true;
+          stepper_starved_us = stepper_block_ready_us;
+        }
+      #endif
       #if ENABLED(LASERBEAM) && ENABLED(LASER_PULSE_METHOD)
         if (current_block->laser_mode == CONTINUOUS && current_block->laser_status == LASER_ON)
           laser_extinguish();
@@ -776,9 +1423,29 @@ void isr() {
   }
 }
 
+void isr() {
+  #if ENABLED(INPUT_SHAPING)
+    // OCR1A still holds the interval that just ended
+    shaping_ticks += OCR1A;
+
+    if (shaping_main_ticks) {
+      // Only delayed impulses are due, the block goes on at the next interrupt
+      shaping_output();
+      shaping_schedule(shaping_main_ticks);
+      return;
+    }
+
+    block_isr();
+    shaping_output();
+    shaping_schedule(OCR1A);
+  #else
+    block_isr();
+  #endif
+}
+
 #if ENABLED(ADVANCE) || ENABLED(ADVANCE_LPC)
 
-  // Timer interrupt for E. e_steps is set in the main routine;
+  // Timer interrupt for E. e_steps is set by the stepper ISR, which also sets eISR_Rate.
   // Timer 0 is shared with millies
   ISR(TIMER0_COMPA_vect) { advance_isr(); }
 
@@ -801,29 +1468,31 @@ void isr() {
         E## INDEX ##_STEP_WRITE(!INVERT_E_STEP_PIN); \
       }
 
-    // Step all E steppers that have steps
-    for (uint8_t i = 0; i < step_loops; i++) {
-      STEP_E_ONCE(0);
-      #if EXTRUDERS > 1
-        STEP_E_ONCE(1);
-        #if EXTRUDERS > 2
-          STEP_E_ONCE(2);
-          #if EXTRUDERS > 3
-            STEP_E_ONCE(3);
-            #if EXTRUDERS > 4
-              STEP_E_ONCE(4);
-              #if EXTRUDERS > 5
-                STEP_E_ONCE(5);
-              #endif
+    // One step for each E stepper that has steps, the rate spreads them
+    STEP_E_ONCE(0);
+    #if EXTRUDERS > 1
+      STEP_E_ONCE(1);
+      #if EXTRUDERS > 2
+        STEP_E_ONCE(2);
+        #if EXTRUDERS > 3
+          STEP_E_ONCE(3);
+          #if EXTRUDERS > 4
+            STEP_E_ONCE(4);
+            #if EXTRUDERS > 5
+              STEP_E_ONCE(5);
             #endif
           #endif
         #endif
       #endif
-    }
+    #endif
   }
 #endif
 
 void st_init() {
+  #if ENABLED(STEPPER_ISR_STATS)
+    stepper_stats_reset();
+  #endif
+
   digipot_init(); //Initialize Digipot Motor Current
   microstep_init(); //Initialize Microstepping Pins
 
@@ -1050,7 +1719,13 @@ void st_init() {
 /**
  * Block until all buffered steps are executed
  */
-void st_synchronize() { while (planner.blocks_queued()) idle(); }
+void st_synchronize() {
+  #if ENABLED(INPUT_SHAPING)
+    while (planner.blocks_queued() || shaping_busy()) idle();
+  #else
+    while (planner.blocks_queued()) idle();
+  #endif
+}
 
 /**
  * Set the stepper positions directly in steps
@@ -1159,6 +1834,9 @@ void quick_stop() {
   DISABLE_STEPPER_DRIVER_INTERRUPT();
   while (planner.blocks_queued()) planner.discard_current_block();
   current_block = NULL;
+  #if ENABLED(INPUT_SHAPING)
+    shaping_discard();
+  #endif
   ENABLE_STEPPER_DRIVER_INTERRUPT();
 }
 
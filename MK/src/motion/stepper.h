@@ -57,6 +57,7 @@
 
   #if ENABLED(ADVANCE) || ENABLED(ADVANCE_LPC)
     static void advance_isr();
+    extern volatile uint32_t advance_deferred; // Stepper intervals too short for their advance steps
   #endif
 
   // Block until all buffered steps are executed
@@ -75,6 +76,9 @@
   // Get current position in mm
   float st_get_axis_position_mm(AxisEnum axis);
 
+  // Timer 1 interval and steps per interrupt for a step rate
+  unsigned short st_calc_timer(const unsigned short step_rate, uint8_t &loops);
+
   // The stepper subsystem goes to sleep when it runs out of things to execute. Call this
   // to notify the subsystem that it is time to go to work.
   void st_wake_up();
@@ -107,6 +111,42 @@
 
   extern block_t *current_block;  // A pointer to the block currently being traced
 
+  #if ENABLED(STEPPER_ISR_STATS)
+    typedef struct {
+      uint16_t isr_min, isr_max;  // ISR duration in timer 1 ticks (0.5us)
+      uint32_t isr_sum, isr_count;
+      uint32_t step_loops[3];     // Interrupts stepping 1, 2 and 4 times
+      uint32_t too_high;          // Steprates clamped by calc_timer()
+      uint16_t step_rate_max;     // Highest steprate asked to calc_timer()
+      uint16_t underruns;         // Blocks started after the planner ran empty
+      uint32_t latency_max;       // Longest time from a block ready to its start (us)
+    } stepper_stats_t;
+
+    extern volatile uint32_t stepper_block_ready_us; // Set by the planner when the first block is queued
+
+    void stepper_stats_reset();
+    void stepper_stats_report();
+  #endif
+
+  #if ENABLED(INPUT_SHAPING)
+    enum ShaperType { SHAPER_NONE, SHAPER_ZV, SHAPER_ZVD, SHAPER_MZV };
+
+    typedef struct {
+      uint8_t type;     // ShaperType
+      float frequency;  // Ringing frequency (Hz)
+      float zeta;       // Damping ratio
+    } shaping_settings_t;
+
+    extern shaping_settings_t shaping_settings[2];  // X and Y motors
+    extern volatile uint16_t shaping_overflows;     // Steps echoed early for lack of queue
+
+    // Wait for the delayed steps and apply shaping_settings
+    void shaping_refresh();
+
+    // Delayed steps still to be output
+    bool shaping_busy();
+  #endif
+
   void quick_stop();
 
   void digitalPotWrite(int address, int value);
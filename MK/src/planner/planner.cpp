@@ -108,6 +108,12 @@ float Planner::previous_speed[NUM_AXIS],
 
 uint8_t Planner::last_extruder;
 
+#if ENABLED(PLANNED_TOOL_OFFSET)
+  long Planner::position_sync[3] = { 0 };
+  volatile bool Planner::position_sync_queued = false;
+  bool Planner::sync_next_block = false;
+#endif
+
 #if ENABLED(DISABLE_INACTIVE_EXTRUDER)
   uint8_t Planner::g_uc_extruder_last_move[EXTRUDERS] = { 0 };
 #endif // DISABLE_INACTIVE_EXTRUDER
@@ -169,6 +175,9 @@ void Planner::calculate_trapezoid_for_block(block_t* block, float entry_factor,
     volatile long final_advance = block->advance * exit_factor * exit_factor;
   #endif // ADVANCE
 
+  uint8_t initial_step_loops;
+  const unsigned short initial_timer = st_calc_timer(initial_rate, initial_step_loops);
+
   // block->accelerate_until = accelerate_steps;
   // block->decelerate_after = accelerate_steps+plateau_steps;
   CRITICAL_SECTION_START;  // Fill variables used by the stepper in a critical section
@@ -177,6 +186,8 @@ void Planner::calculate_trapezoid_for_block(block_t* block, float entry_factor,
     block->decelerate_after = accelerate_steps + plateau_steps;
     block->initial_rate = initial_rate;
     block->final_rate = final_rate;
+    block->initial_timer = initial_timer;
+    block->initial_step_loops = initial_step_loops;
     #if ENABLED(ADVANCE)
       block->initial_advance = initial_advance;
       block->final_advance = final_advance;
@@ -367,6 +378,26 @@ void Planner::recalculate() {
   }
 #endif //AUTOTEMP
 
+#if ENABLED(MPCTEMP)
+  /**
+   * Filament feed of the queued moves in mm/s, for the feed-forward
+   * of the hotend model. Averaged over the next MPC_FEEDFORWARD_TIME
+   * seconds of motion at nominal speed. Retracts don't count.
+   */
+  float Planner::get_e_speed() {
+    float e_steps = 0.0, time = 0.0;
+
+    for (uint8_t b = block_buffer_tail; b != block_buffer_head && time < MPC_FEEDFORWARD_TIME; b = next_block_index(b)) {
+      const block_t* block = &block_buffer[b];
+      if (block->nominal_speed <= 0.0) continue;
+      time += block->millimeters / block->nominal_speed;
+      if (!TEST(block->direction_bits, E_AXIS)) e_steps += block->steps[E_AXIS];
+    }
+
+    return time > 0.0 ? e_steps / axis_steps_per_mm[E_AXIS + active_extruder] / time : 0.0;
+  }
+#endif // MPCTEMP
+
 /**
  * Maintain fans, paste extruder pressure, 
  */
@@ -395,6 +426,13 @@ void Planner::check_axes_activity() {
       block = &block_buffer[b];
       LOOP_XYZE(i) if (block->steps[i]) axis_active[i]++;
     }
+
+    #if ENABLED(Z_LATE_ENABLE)
+      // Enable Z while the block before a Z move runs, so the stepper ISR doesn't wait for it
+      uint8_t next = block_buffer_tail;
+      if (block_buffer[next].busy) next = next_block_index(next);
+      if (next != block_buffer_head && block_buffer[next].steps[Z_AXIS]) enable_z();
+    #endif
   }
   if (DISABLE_X && !axis_active[X_AXIS]) disable_x();
   if (DISABLE_Y && !axis_active[Y_AXIS]) disable_y();
@@ -480,9 +518,15 @@ void Planner::check_axes_activity() {
     // Calculate ZWobble
     zwobble.InsertCorrection(z);
   #endif
-  #if ENABLED(HYSTERESIS)
-    // Calculate Hysteresis
-    hysteresis.InsertCorrection(x, y, z, e);
+  #if ENABLED(MIXING_GRADIENT)
+    // The gradient follows the Z of the move, before the bed leveling
+    #if MECH(DELTA)
+      const float gradient_z = delta_cartesian_z; // Segment of the last inverse_kinematics
+    #elif MECH(SCARA)
+      const float gradient_z = LOGICAL_Z_POSITION(z); // Raw cartesian Z of the segment
+    #else
+      const float gradient_z = z;
+    #endif
   #endif
 
   // Calculate the buffer head after we push this byte
@@ -607,8 +651,24 @@ void Planner::check_axes_activity() {
     if (block->step_event_count <= DROP_SEGMENTS) return;
   #endif
 
+  #if ENABLED(HYSTERESIS)
+    // Hysteresis take-up of the motors that reverse, stepped apart by the ISR
+    #if MECH(COREXY) || MECH(COREYX)
+      const long dm[NUM_AXIS] = { da, db, dz, de };
+    #elif MECH(COREXZ) || MECH(COREZX)
+      const long dm[NUM_AXIS] = { da, dy, dc, de };
+    #else
+      const long dm[NUM_AXIS] = { dx, dy, dz, de };
+    #endif
+    hysteresis.InsertCorrection(dm, block);
+  #endif
+
   block->fan_speed = fanSpeed;
 
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    block->sdpos = command_sdpos;
+  #endif
+
   #if ENABLED(BARICUDA)
     block->valve_pressure = ValvePressure;
     block->e_to_p_pressure = EtoPPressure;
@@ -616,8 +676,13 @@ void Planner::check_axes_activity() {
 
   // For a mixing extruder, get steps for each
   #if ENABLED(COLOR_MIXING_EXTRUDER)
+    #if ENABLED(MIXING_GRADIENT)
+      const float* mix = mixing_gradient_mix(gradient_z, de * steps_to_mm[E_AXIS + extruder]);
+    #else
+      const float* mix = mixing_factor;
+    #endif
     for (uint8_t i = 0; i < DRIVER_EXTRUDERS; i++)
-      block->mix_event_count[i] = block->steps[E_AXIS] * mixing_factor[i];
+      block->mix_event_count[i] = block->steps[E_AXIS] * mix[i];
   #endif
 
   // Compute direction bits for this block 
@@ -1021,6 +1086,8 @@ void Planner::check_axes_activity() {
     block->nominal_rate *= speed_factor;
   }
 
+  block->nominal_timer = st_calc_timer(block->nominal_rate, block->nominal_step_loops);
+
   // Compute and limit the acceleration rate for the trapezoid generator.
   float steps_per_mm = block->step_event_count / block->millimeters;
   long bsx = block->steps[X_AXIS], bsy = block->steps[Y_AXIS], bsz = block->steps[Z_AXIS], bse = block->steps[E_AXIS];
@@ -1179,6 +1246,25 @@ void Planner::check_axes_activity() {
 
   calculate_trapezoid_for_block(block, block->entry_speed / block->nominal_speed, safe_speed / block->nominal_speed);
 
+  #if ENABLED(STEPPER_ISR_STATS)
+    // With an empty planner the block is ready right now
+    if (!blocks_queued()) {
+      const uint32_t now_us = micros();
+      CRITICAL_SECTION_START;
+        stepper_block_ready_us = now_us;
+      CRITICAL_SECTION_END;
+    }
+  #endif
+
+  #if ENABLED(PLANNED_TOOL_OFFSET)
+    // The first block after a tool change brings the stepper positions along
+    block->sync_position = sync_next_block;
+    if (sync_next_block) {
+      sync_next_block = false;
+      position_sync_queued = true;
+    }
+  #endif
+
   // Move buffer head
   block_buffer_head = next_buffer_head;
 
@@ -1241,8 +1327,68 @@ void Planner::check_axes_activity() {
   previous_nominal_speed = 0.0; // Resets planner junction speeds. Assumes start from rest.
 
   LOOP_XYZE(i) previous_speed[i] = 0.0;
+
+  #if ENABLED(PLANNED_TOOL_OFFSET)
+    // The new positions already include the shift, a flagged block in the buffer adds nothing
+    CRITICAL_SECTION_START;
+      LOOP_XYZ(i) position_sync[i] = 0;
+    CRITICAL_SECTION_END;
+    sync_next_block = position_sync_queued = false;
+  #endif
 }
 
+#if ENABLED(PLANNED_TOOL_OFFSET)
+
+  /**
+   * Set the planner XYZ position as a planned event.
+   *
+   * The moves in the buffer keep running. The first block queued
+   * from here shifts the stepper XYZ positions by the same steps
+   * when it starts, so a G92 meanwhile is kept. E is left alone,
+   * a tool offset never moves it.
+   */
+  #if (ENABLED(AUTO_BED_LEVELING_FEATURE) || ENABLED(MESH_BED_LEVELING)) && NOMECH(DELTA)
+    void Planner::shift_position_mm(float x, float y, float z, const float& e)
+  #else
+    void Planner::shift_position_mm(const float& x, const float& y, const float& z, const float& e)
+  #endif
+  {
+    // Only one shift can wait for its block
+    while (position_sync_queued && blocks_queued()) idle();
+
+    // Nothing in flight, just set the positions
+    if (!blocks_queued()) {
+      set_position_mm(x, y, z, e);
+      return;
+    }
+
+    #if ENABLED(MESH_BED_LEVELING) && NOMECH(DELTA)
+      if (mbl.active())
+        z += mbl.get_z(RAW_X_POSITION(x), RAW_Y_POSITION(y));
+    #elif ENABLED(AUTO_BED_LEVELING_FEATURE) && NOMECH(DELTA)
+      apply_rotation_xyz(bed_level_matrix, x, y, z);
+    #endif
+
+    const long nx = lround(x * axis_steps_per_mm[X_AXIS]),
+               ny = lround(y * axis_steps_per_mm[Y_AXIS]),
+               nz = lround(z * axis_steps_per_mm[Z_AXIS]);
+
+    // No flagged block is in the buffer, the stepper doesn't read it.
+    // A shift still waiting for its block adds up with this one.
+    if (!sync_next_block) LOOP_XYZ(i) position_sync[i] = 0;
+    position_sync[X_AXIS] += nx - position[X_AXIS];
+    position_sync[Y_AXIS] += ny - position[Y_AXIS];
+    position_sync[Z_AXIS] += nz - position[Z_AXIS];
+    position[X_AXIS] = nx;
+    position[Y_AXIS] = ny;
+    position[Z_AXIS] = nz;
+    position[E_AXIS] = lround(e * axis_steps_per_mm[E_AXIS + active_extruder]);
+    last_extruder = active_extruder;
+    sync_next_block = true;
+  }
+
+#endif // PLANNED_TOOL_OFFSET
+
 /**
  * Directly set the planner E position (hence the stepper E position).
  */
@@ -85,12 +85,27 @@ typedef struct {
   unsigned char recalculate_flag,                    // Planner flag to recalculate trapezoids on entry junction
                 nominal_length_flag;                 // Planner flag for nominal speed always reached
 
+  #if ENABLED(PLANNED_TOOL_OFFSET)
+    bool sync_position;                              // Shift the stepper XYZ positions by planner.position_sync before this block
+  #endif
+
+  #if ENABLED(HYSTERESIS)
+    int16_t hysteresis_steps[NUM_AXIS];              // Signed take-up steps, stepped apart from steps[] and not counted as motion
+    unsigned long hysteresis_events[NUM_AXIS];       // Step events over which each take-up is spread
+  #endif
+
   // Settings for the trapezoid generator
   unsigned long nominal_rate,                        // The nominal step rate for this block in step_events/sec
                 initial_rate,                        // The jerk-adjusted step rate at start of block
                 final_rate,                          // The minimal rate at exit
                 acceleration_steps_per_s2;           // acceleration steps/sec^2
 
+  // Stepper ISR constants, pre-computed so a new block starts without calc_timer()
+  unsigned short nominal_timer,                      // Timer 1 interval at nominal_rate
+                 initial_timer;                      // Timer 1 interval at initial_rate
+  uint8_t nominal_step_loops,                        // Steps per interrupt at nominal_rate
+          initial_step_loops;                        // Steps per interrupt at initial_rate
+
   unsigned long fan_speed;
 
   #if ENABLED(BARICUDA)
@@ -109,6 +124,10 @@ typedef struct {
     #endif
   #endif 
 
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    uint32_t sdpos; // SD file position of the command that generated this block
+  #endif
+
   volatile char busy;
 
 } block_t;
@@ -147,6 +166,11 @@ class Planner {
       static matrix_3x3 bed_level_matrix; // Transform to compensate for bed level
     #endif
 
+    #if ENABLED(PLANNED_TOOL_OFFSET)
+      static long position_sync[3];                // XYZ stepper shift at the start of the block flagged sync_position
+      static volatile bool position_sync_queued;   // A block flagged sync_position is in the buffer
+    #endif
+
   private:
 
     /**
@@ -186,6 +210,13 @@ class Planner {
      */
     static uint8_t last_extruder;
 
+    #if ENABLED(PLANNED_TOOL_OFFSET)
+      /**
+       * Flag the next block queued to sync the stepper positions
+       */
+      static bool sync_next_block;
+    #endif
+
   public:
 
     /**
@@ -242,10 +273,24 @@ class Planner {
        */
       static void set_position_mm(float x, float y, float z, const float& e);
 
+      #if ENABLED(PLANNED_TOOL_OFFSET)
+        /**
+         * Set the planner.position without waiting for the moves in flight.
+         * The stepper positions are set when the next block starts.
+         * Used by tool change to apply the hotend offset.
+         *
+         * Keeps previous speed values, the next move joins the last one.
+         */
+        static void shift_position_mm(float x, float y, float z, const float& e);
+      #endif
+
     #else
 
       static void buffer_line(const float& x, const float& y, const float& z, const float& e, float fr_mm_s, const uint8_t extruder, const uint8_t driver);
       static void set_position_mm(const float& x, const float& y, const float& z, const float& e);
+      #if ENABLED(PLANNED_TOOL_OFFSET)
+        static void shift_position_mm(const float& x, const float& y, const float& z, const float& e);
+      #endif
 
     #endif // AUTO_BED_LEVELING_FEATURE || MESH_BED_LEVELING
 
@@ -291,6 +336,10 @@ class Planner {
       static void autotemp_M109();
     #endif
 
+    #if ENABLED(MPCTEMP)
+      static float get_e_speed();
+    #endif
+
   private:
 
     /**
@@ -231,6 +231,29 @@
   #if DISABLED(MAX_COOLER_POWER)
     #error DEPENDENCY ERROR: Missing setting MAX_COOLER_POWER
   #endif
+  #if (ENABLED(ADVANCE) || ENABLED(ADVANCE_LPC)) && DISABLED(ADVANCE_E_MIN_INTERVAL)
+    #error DEPENDENCY ERROR: Missing setting ADVANCE_E_MIN_INTERVAL
+  #endif
+  #if ENABLED(STEPPER_ISR_STATS) && DISABLED(STEPPER_ISR_UNDERRUN_MS)
+    #error DEPENDENCY ERROR: Missing setting STEPPER_ISR_UNDERRUN_MS
+  #endif
+  #if ENABLED(INPUT_SHAPING)
+    #if DISABLED(SHAPING_TYPE_X) || DISABLED(SHAPING_FREQ_X) || DISABLED(SHAPING_ZETA_X)
+      #error DEPENDENCY ERROR: Missing setting SHAPING_TYPE_X, SHAPING_FREQ_X or SHAPING_ZETA_X
+    #endif
+    #if DISABLED(SHAPING_TYPE_Y) || DISABLED(SHAPING_FREQ_Y) || DISABLED(SHAPING_ZETA_Y)
+      #error DEPENDENCY ERROR: Missing setting SHAPING_TYPE_Y, SHAPING_FREQ_Y or SHAPING_ZETA_Y
+    #endif
+    #if DISABLED(SHAPING_QUEUE)
+      #error DEPENDENCY ERROR: Missing setting SHAPING_QUEUE
+    #endif
+    #if DISABLED(SHAPING_DIR_DELAY)
+      #error DEPENDENCY ERROR: Missing setting SHAPING_DIR_DELAY
+    #endif
+  #endif
+  #if ENABLED(ADC_INTERRUPT_SAMPLING) && DISABLED(ADC_SWEEP_TICKS)
+    #error DEPENDENCY ERROR: Missing setting ADC_SWEEP_TICKS
+  #endif
   #if ENABLED(PIDTEMP) || ENABLED(PIDTEMPBED) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER)
     #if DISABLED(MAX_OVERSHOOT_PID_AUTOTUNE)
       #error DEPENDENCY ERROR: Missing setting MAX_OVERSHOOT_PID_AUTOTUNE
@@ -253,6 +276,26 @@
       #error DEPENDENCY ERROR: Missing setting DEFAULT_Kd
     #endif
   #endif
+  #if ENABLED(MPCTEMP)
+    #if ENABLED(PIDTEMP)
+      #error CONFLICT ERROR: MPCTEMP and PIDTEMP cannot be enabled together. Choose one.
+    #endif
+    #if DISABLED(MPC_MAX) || DISABLED(MPC_HEATER_POWER)
+      #error DEPENDENCY ERROR: Missing setting MPC_MAX or MPC_HEATER_POWER
+    #endif
+    #if DISABLED(MPC_BLOCK_HEAT_CAPACITY) || DISABLED(MPC_SENSOR_RESPONSIVENESS) || DISABLED(MPC_AMBIENT_XFER_COEFF) || DISABLED(MPC_AMBIENT_XFER_COEFF_FAN255)
+      #error DEPENDENCY ERROR: Missing setting MPC_BLOCK_HEAT_CAPACITY, MPC_SENSOR_RESPONSIVENESS, MPC_AMBIENT_XFER_COEFF or MPC_AMBIENT_XFER_COEFF_FAN255
+    #endif
+    #if DISABLED(MPC_FILAMENT_HEAT_CAPACITY_PERMM) || DISABLED(MPC_FEEDFORWARD_TIME)
+      #error DEPENDENCY ERROR: Missing setting MPC_FILAMENT_HEAT_CAPACITY_PERMM or MPC_FEEDFORWARD_TIME
+    #endif
+    #if DISABLED(MPC_SMOOTHING_FACTOR) || DISABLED(MPC_MIN_AMBIENT_CHANGE) || DISABLED(MPC_STEADYSTATE)
+      #error DEPENDENCY ERROR: Missing setting MPC_SMOOTHING_FACTOR, MPC_MIN_AMBIENT_CHANGE or MPC_STEADYSTATE
+    #endif
+    #if DISABLED(MPC_AUTOTUNE_TEMP) || DISABLED(MAX_OVERSHOOT_PID_AUTOTUNE)
+      #error DEPENDENCY ERROR: Missing setting MPC_AUTOTUNE_TEMP or MAX_OVERSHOOT_PID_AUTOTUNE
+    #endif
+  #endif
   #if ENABLED(PIDTEMPBED)
     #if DISABLED(PID_BED_INTEGRAL_DRIVE_MAX)
       #error DEPENDENCY ERROR: Missing setting PID_BED_INTEGRAL_DRIVE_MAX
@@ -411,6 +454,14 @@
     #if ENABLED(FILAMENT_SENSOR)
       #error COLOR_MIXING_EXTRUDER is incompatible with FILAMENT_SENSOR. Comment out this line to use it anyway.
     #endif
+    #if ENABLED(MIXING_GRADIENT)
+      #if DISABLED(MIXING_VIRTUAL_TOOLS) || MIXING_VIRTUAL_TOOLS < 2
+        #error DEPENDENCY ERROR: MIXING_GRADIENT needs MIXING_VIRTUAL_TOOLS 2 or more
+      #endif
+      #if DISABLED(MIXING_GRADIENTS)
+        #error DEPENDENCY ERROR: Missing setting MIXING_GRADIENTS
+      #endif
+    #endif
   #endif
 
   #if ENABLED(NPR2)
@@ -434,6 +485,22 @@
     #endif
   #endif
 
+  #if ENABLED(TOOL_CHANGE_PREHEAT)
+    #if HOTENDS < 2
+      #error DEPENDENCY ERROR: TOOL_CHANGE_PREHEAT needs at least 2 hotends
+    #endif
+    #if DISABLED(TOOL_PREHEAT_TIME)
+      #error DEPENDENCY ERROR: Missing setting TOOL_PREHEAT_TIME
+    #endif
+    #if DISABLED(TOOL_STANDBY_DROP)
+      #error DEPENDENCY ERROR: Missing setting TOOL_STANDBY_DROP
+    #endif
+  #endif
+
+  #if ENABLED(PLANNED_TOOL_OFFSET) && HOTENDS < 2
+    #error DEPENDENCY ERROR: PLANNED_TOOL_OFFSET needs at least 2 hotends
+  #endif
+
   #if ENABLED(IDLE_OOZING_PREVENT)
     #if DISABLED(IDLE_OOZING_MINTEMP)
       #error DEPENDENCY ERROR: Missing setting IDLE_OOZING_MINTEMP
@@ -794,6 +861,20 @@
     #if DISABLED(SD_FINISHED_RELEASECOMMAND)
       #error DEPENDENCY ERROR: Missing setting SD_FINISHED_RELEASECOMMAND
     #endif
+    #if ENABLED(SD_DIR_INDEX) && DISABLED(SD_DIR_INDEX_SIZE)
+      #error DEPENDENCY ERROR: Missing setting SD_DIR_INDEX_SIZE
+    #endif
+    #if ENABLED(SD_METADATA_CACHE) && DISABLED(SD_METADATA_FILE)
+      #error DEPENDENCY ERROR: Missing setting SD_METADATA_FILE
+    #endif
+    #if ENABLED(POWER_LOSS_RECOVERY)
+      #if DISABLED(POWER_LOSS_JOURNAL_SECONDS)
+        #error DEPENDENCY ERROR: Missing setting POWER_LOSS_JOURNAL_SECONDS
+      #endif
+      #if DISABLED(POWER_LOSS_JOURNAL_FILE)
+        #error DEPENDENCY ERROR: Missing setting POWER_LOSS_JOURNAL_FILE
+      #endif
+    #endif
     #if ENABLED(SD_SETTINGS)
       #if DISABLED(SD_CFG_SECONDS)
         #error DEPENDENCY ERROR: Missing setting SD_CFG_SECONDS
@@ -1138,6 +1219,14 @@
   #if DISABLED(BUFSIZE)
     #error DEPENDENCY ERROR: Missing setting BUFSIZE
   #endif
+  #if DISABLED(TX_BUFFER_SIZE)
+    #error DEPENDENCY ERROR: Missing setting TX_BUFFER_SIZE
+  #elif TX_BUFFER_SIZE > 128 || (TX_BUFFER_SIZE & (TX_BUFFER_SIZE - 1))
+    #error CONFLICT ERROR: TX_BUFFER_SIZE must be 0 or a power of 2 up to 128
+  #endif
+  #if ENABLED(EMERGENCY_PARSER) && defined(EXTERNALSERIAL)
+    #error CONFLICT ERROR: EMERGENCY_PARSER needs the MK serial, it is not available with EXTERNALSERIAL
+  #endif
   #if DISABLED(NUM_POSITON_SLOTS)
     #error DEPENDENCY ERROR: Missing setting NUM_POSITON_SLOTS
   #endif
@@ -1671,6 +1760,18 @@
     #endif
   #endif // DUAL_X_CARRIAGE
 
+  /**
+   * Input shaping requirements
+   */
+  #if ENABLED(INPUT_SHAPING)
+    #if MECH(DELTA) || MECH(SCARA) || ENABLED(DUAL_X_CARRIAGE)
+      #error CONFLICT ERROR: INPUT_SHAPING is not compatible with DELTA, SCARA or DUAL_X_CARRIAGE.
+    #endif
+    #if SHAPING_QUEUE > 1024 || (SHAPING_QUEUE & (SHAPING_QUEUE - 1)) != 0
+      #error CONFLICT ERROR: SHAPING_QUEUE must be a power of 2, 1024 max.
+    #endif
+  #endif
+
   /**
    * Make sure auto fan pins don't conflict with the fan pin
    */
@@ -1715,6 +1816,30 @@
     #error DEPENDENCY ERROR: You have to enable SDSUPPORT to use SD_SETTINGS
   #endif
 
+  #if DISABLED(SDSUPPORT) && ENABLED(POWER_LOSS_RECOVERY)
+    #error DEPENDENCY ERROR: You have to enable SDSUPPORT to use POWER_LOSS_RECOVERY
+  #endif
+
+  #if DISABLED(SD_DIR_INDEX) && (ENABLED(SD_DIR_INDEX_SORT_NAME) || ENABLED(SD_DIR_INDEX_SORT_DATE))
+    #error DEPENDENCY ERROR: You have to enable SD_DIR_INDEX to use SD_DIR_INDEX_SORT_NAME or SD_DIR_INDEX_SORT_DATE
+  #endif
+
+  #if ENABLED(IDLE_SCHEDULER) && DISABLED(IDLE_TASK_MAX_LATENCY)
+    #error DEPENDENCY ERROR: Missing setting IDLE_TASK_MAX_LATENCY
+  #endif
+
+  #if ENABLED(SD_METADATA_CACHE) && (DISABLED(SDSUPPORT) || DISABLED(JSON_OUTPUT))
+    #error DEPENDENCY ERROR: You have to enable SDSUPPORT and JSON_OUTPUT to use SD_METADATA_CACHE
+  #endif
+
+  #if DISABLED(SDSUPPORT) && ENABLED(SD_LAYER_INDEX)
+    #error DEPENDENCY ERROR: You have to enable SDSUPPORT to use SD_LAYER_INDEX
+  #endif
+
+  #if ENABLED(SD_DIR_INDEX_SORT_NAME) && ENABLED(SD_DIR_INDEX_SORT_DATE)
+    #error CONFLICT ERROR: "SD_DIR_INDEX_SORT_NAME and SD_DIR_INDEX_SORT_DATE are incompatible."
+  #endif
+
   #if MECH(COREXZ) && ENABLED(Z_LATE_ENABLE)
     #error CONFLICT ERROR: "Z_LATE_ENABLE can't be used with COREXZ."
   #endif
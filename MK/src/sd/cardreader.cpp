@@ -37,6 +37,12 @@ CardReader::CardReader() {
   sdprinting = false;
   cardOK = false;
   saving = false;
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    journal_enabled = true;
+  #endif
+  #if ENABLED(SD_DIR_INDEX)
+    dir_index_valid = false;
+  #endif
 
   workDirDepth = 0;
   memset(workDirParents, 0, sizeof(workDirParents));
@@ -62,17 +68,29 @@ char* CardReader::createFilename(char* buffer, const dir_t& p) { //buffer > 12ch
   return pos;
 }
 
+#if ENABLED(SD_DIR_INDEX_SORT_NAME)
+  // Sort key of the four characters of a name from offset, 0 past its end
+  static uint32_t nameKey(const char* name, const uint8_t offset) {
+    uint32_t key = 0;
+    if (offset < strlen(name))
+      for (uint8_t i = 0; i < 4 && name[offset + i]; i++)
+        key |= (uint32_t)toupper(name[offset + i]) << (24 - 8 * i);
+    return key;
+  }
+#endif
+
 /**
  * Dive into a folder and recurse depth-first to perform a pre-set operation lsAction:
  *   LS_Count       - Add +1 to nrFiles for every file within the parent
  *   LS_GetFilename - Get the filename of the file indexed by nrFiles
+ *   LS_Index       - Store the position of every dir_index_stride-th file in the directory index
  */
 void CardReader::lsDive(SdBaseFile parent, const char* const match/*=NULL*/) {
   dir_t* p;
-  uint8_t cnt = 0;
-  
-  // Read the next entry from a directory
-  while ((p = parent.getLongFilename(p, fullName, 0, NULL)) != NULL) {
+  uint16_t cnt = 0;
+
+  // Read the next entry from a directory, pos is where the search for it started
+  for (uint32_t pos = parent.curPosition(); (p = parent.getLongFilename(p, fullName, 0, NULL)) != NULL; pos = parent.curPosition()) {
     char pn0 = p->name[0];
     if (pn0 == DIR_NAME_FREE) break;
     if (pn0 == DIR_NAME_DELETED || pn0 == '.') continue;
@@ -88,15 +106,31 @@ void CardReader::lsDive(SdBaseFile parent, const char* const match/*=NULL*/) {
         nrFiles++;
         break;
       case LS_GetFilename:
-        if (match != NULL) {
-          if (strcasecmp(match, fullName) == 0) return;
+        if (match != NULL ? strcasecmp(match, fullName) == 0 : cnt == nrFiles) {
+          #if ENABLED(SD_METADATA_CACHE)
+            filenameEntry = *p;
+          #endif
+          return;
         }
-        else if (cnt == nrFiles) return;
         cnt++;
         break;
+      #if ENABLED(SD_DIR_INDEX)
+        case LS_Index:
+          if (nrFiles % dir_index_stride == 0) {
+            const uint16_t slot = nrFiles / dir_index_stride;
+            dir_index[slot] = (pos >> 5) | (filenameIsDir ? 0x8000 : 0);
+            #if ENABLED(SD_DIR_INDEX_SORT_NAME)
+              dir_index_key[slot] = nameKey(fullName, 0);
+            #elif ENABLED(SD_DIR_INDEX_SORT_DATE)
+              dir_index_key[slot] = ((uint32_t)p->lastWriteDate << 16) | p->lastWriteTime;
+            #endif
+          }
+          nrFiles++;
+          break;
+      #endif
     }
 
-  } // while readDir
+  } // for readDir
 }
 
 void CardReader::ls()  {
@@ -104,6 +138,7 @@ void CardReader::ls()  {
   root.ls(0, 0);
   workDir = root;
   curDir = &root;
+  invalidateIndex();
 }
 
 void CardReader::initsd() {
@@ -133,6 +168,7 @@ void CardReader::initsd() {
   root = *fat.vwd();
   workDir = root;
   curDir = &root;
+  invalidateIndex();
 }
 
 void CardReader::mount() {
@@ -140,12 +176,37 @@ void CardReader::mount() {
 }
 
 void CardReader::unmount() {
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    closeJournal(false);
+  #endif
+  #if ENABLED(SD_LAYER_INDEX)
+    finishLayerIndex(false);
+  #endif
   cardOK = false;
   sdprinting = false;
 }
 
 void CardReader::startPrint() {
-  if (cardOK) sdprinting = true;
+  if (cardOK) {
+    sdprinting = true;
+    #if ENABLED(POWER_LOSS_RECOVERY)
+      openJournal();
+    #endif
+    #if ENABLED(SD_LAYER_INDEX)
+      // Index the layers while printing the file from the start, if not done yet
+      if (sdpos == 0 && !fileLayers.isOpen() && !restartSelected()) {
+        layer_index_header_t header;
+        if (openLayerIndex(header, false) && header.complete)
+          fileLayers.close();
+        else {
+          resume_point_t rp;
+          get_resume_point(rp, false);
+          rp.sdpos = 0;
+          startLayerIndex(rp);
+        }
+      }
+    #endif
+  }
 }
 
 void CardReader::pausePrint() {
@@ -156,6 +217,15 @@ void CardReader::continuePrint(bool intern) {}
 
 void CardReader::stopPrint() {
   sdprinting = false;
+  #if ENABLED(TOOL_CHANGE_PREHEAT)
+    toolchange_preheat_reset();
+  #endif
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    closeJournal(true);
+  #endif
+  #if ENABLED(SD_LAYER_INDEX)
+    finishLayerIndex(false);
+  #endif
   closeFile();
 }
 
@@ -183,11 +253,15 @@ bool CardReader::selectFile(const char* filename, bool silent/*=false*/) {
 
   if(!cardOK) return false;
 
+  #if ENABLED(SD_LAYER_INDEX)
+    finishLayerIndex(false);
+  #endif
   file.close();
 
   if (!file.exists("restart.gcode")) {
     file.createContiguous(&workDir, "restart.gcode", 1);
     file.close();
+    invalidateIndex();
   }
 
   if (file.open(curDir, filename, O_READ)) {
@@ -204,7 +278,9 @@ bool CardReader::selectFile(const char* filename, bool silent/*=false*/) {
   		const_cast<char&>(fullName[c]) = '\0';
     strncpy(fullName, filename, strlen(filename));
 
-    #if ENABLED(JSON_OUTPUT)
+    #if ENABLED(SD_METADATA_CACHE)
+      getMetadata();
+    #elif ENABLED(JSON_OUTPUT)
       parsejson(file);
     #endif
     sdpos = 0;
@@ -236,6 +312,7 @@ void CardReader::startWrite(char *filename, bool lcd_status/*=true*/) {
   }
   else {
     saving = true;
+    invalidateIndex();
     ECHO_EMT(SERIAL_SD_WRITE_TO_FILE, filename);
     if (lcd_status) lcd_setstatus(filename);
   }
@@ -245,6 +322,7 @@ void CardReader::deleteFile(char *filename) {
   if(!cardOK) return;
   sdprinting = false;
   file.close();
+  invalidateIndex();
   if(fat.remove(filename)) {
     ECHO_EMT(SERIAL_SD_FILE_DELETED, filename);
   }
@@ -268,6 +346,7 @@ void CardReader::makeDirectory(char *filename) {
   if(!cardOK) return;
   sdprinting = false;
   file.close();
+  invalidateIndex();
   if(fat.mkdir(filename)) {
     ECHO_EM(SERIAL_SD_DIRECTORY_CREATED);
   }
@@ -282,20 +361,131 @@ void CardReader::makeDirectory(char *filename) {
 void CardReader::getfilename(uint16_t nr, const char* const match/*=NULL*/) {
   curDir = &workDir;
   lsAction = LS_GetFilename;
+  #if ENABLED(SD_DIR_INDEX)
+    if (match == NULL) {
+      if (!dir_index_valid) buildIndex();
+      if (nr >= dir_index_count) { fullName[0] = '\0'; return; }
+      // Start from the nearest indexed entry instead of the top of the directory
+      nrFiles = nr % dir_index_stride;
+      curDir->seekSet((uint32_t)(dir_index[nr / dir_index_stride] & 0x7FFF) << 5);
+      lsDive(*curDir);
+      return;
+    }
+  #endif
   nrFiles = nr;
   curDir->rewind();
   lsDive(*curDir, match);
 }
 
 uint16_t CardReader::getnrfilenames() {
-  curDir = &workDir;
-  lsAction = LS_Count;
-  nrFiles = 0;
-  curDir->rewind();
-  lsDive(*curDir);
-  return nrFiles;
+  #if ENABLED(SD_DIR_INDEX)
+    if (!dir_index_valid) buildIndex();
+    return dir_index_count;
+  #else
+    curDir = &workDir;
+    lsAction = LS_Count;
+    nrFiles = 0;
+    curDir->rewind();
+    lsDive(*curDir);
+    return nrFiles;
+  #endif
 }
 
+#if ENABLED(SD_DIR_INDEX)
+
+  /**
+   * Index the working directory, so that getfilename() reads at most
+   * dir_index_stride entries. Folders with more than SD_DIR_INDEX_SIZE
+   * files are indexed every dir_index_stride files and stay unsorted.
+   */
+  void CardReader::buildIndex() {
+    curDir = &workDir;
+    lsAction = LS_Count;
+    nrFiles = 0;
+    curDir->rewind();
+    lsDive(*curDir);
+    dir_index_count = nrFiles;
+    dir_index_stride = dir_index_count ? (dir_index_count + SD_DIR_INDEX_SIZE - 1) / (SD_DIR_INDEX_SIZE) : 1;
+
+    lsAction = LS_Index;
+    nrFiles = 0;
+    curDir->rewind();
+    lsDive(*curDir);
+
+    #if ENABLED(SD_DIR_INDEX_SORT_NAME) || ENABLED(SD_DIR_INDEX_SORT_DATE)
+      if (dir_index_stride == 1) {
+        // The folders first, then by key
+        sortIndex(0, dir_index_count);
+
+        #if ENABLED(SD_DIR_INDEX_SORT_NAME)
+          // Names with the same first characters are sorted again by the next
+          // four, each name is read once per round instead of once per compare.
+          // Bit i of tie is set when entry i still equals entry i - 1.
+          uint8_t tie[(SD_DIR_INDEX_SIZE + 7) / 8] = { 0 };
+          bool more = false;
+          for (uint16_t i = 1; i < dir_index_count; i++) {
+            if (!((dir_index[i] ^ dir_index[i - 1]) & 0x8000) && dir_index_key[i] == dir_index_key[i - 1] && (dir_index_key[i] & 0xFF)) {
+              SBI(tie[i >> 3], i & 7);
+              more = true;
+            }
+          }
+
+          for (uint8_t offset = 4; more && offset < LONG_FILENAME_LENGTH; offset += 4) {
+            more = false;
+            for (uint16_t first = 0; first < dir_index_count; ) {
+              uint16_t last = first + 1;
+              while (last < dir_index_count && TEST(tie[last >> 3], last & 7)) last++;
+              if (last - first > 1) {
+                for (uint16_t i = first; i < last; i++) {
+                  dir_t* p;
+                  workDir.seekSet((uint32_t)(dir_index[i] & 0x7FFF) << 5);
+                  workDir.getLongFilename(p, fullName, 0, NULL);
+                  dir_index_key[i] = nameKey(fullName, offset);
+                }
+                sortIndex(first, last);
+                for (uint16_t i = first + 1; i < last; i++) {
+                  if (dir_index_key[i] == dir_index_key[i - 1] && (dir_index_key[i] & 0xFF))
+                    more = true;
+                  else
+                    CBI(tie[i >> 3], i & 7);
+                }
+              }
+              first = last;
+            }
+          }
+        #endif
+      }
+    #endif
+
+    dir_index_valid = true;
+  }
+
+  #if ENABLED(SD_DIR_INDEX_SORT_NAME) || ENABLED(SD_DIR_INDEX_SORT_DATE)
+    bool CardReader::indexLess(uint16_t e1, uint32_t k1, uint16_t e2, uint32_t k2) {
+      if ((e1 ^ e2) & 0x8000) return e1 & 0x8000;
+      return k1 < k2;
+    }
+
+    /**
+     * Stable insertion sort of the index entries from first to last - 1
+     */
+    void CardReader::sortIndex(uint16_t first, uint16_t last) {
+      for (uint16_t i = first + 1; i < last; i++) {
+        const uint16_t e = dir_index[i];
+        const uint32_t k = dir_index_key[i];
+        uint16_t j = i;
+        for (; j > first && indexLess(e, k, dir_index[j - 1], dir_index_key[j - 1]); j--) {
+          dir_index[j] = dir_index[j - 1];
+          dir_index_key[j] = dir_index_key[j - 1];
+        }
+        dir_index[j] = e;
+        dir_index_key[j] = k;
+      }
+    }
+  #endif
+
+#endif // SD_DIR_INDEX
+
 void CardReader::chdir(const char* relpath) {
   SdBaseFile newfile;
   SdBaseFile* parent = &root;
@@ -310,6 +500,7 @@ void CardReader::chdir(const char* relpath) {
       workDirParents[0] = *parent;
     }
     workDir = newfile;
+    invalidateIndex();
   }
 }
 
@@ -319,6 +510,7 @@ void CardReader::updir() {
     workDir = workDirParents[0];
     for (uint16_t d = 0; d < workDirDepth; d++)
       workDirParents[d] = workDirParents[d + 1];
+    invalidateIndex();
   }
 }
 
@@ -328,120 +520,468 @@ void CardReader::closeFile(bool store_location /*=false*/) {
   saving = false;
 
   if (store_location) {
-    char bufferFilerestart[50];
-    char bufferX[11];
-    char bufferY[11];
-    char bufferZ[11];
-    char bufferE[11];
-    char bufferCoord[50];
-    char bufferCoord1[50];
-    char bufferCoord2[50];
-    char bufferSdpos[11];
-    char nameFile[15];
-    snprintf(bufferSdpos, sizeof bufferSdpos, "%lu", (unsigned long)sdpos);
-
-    strcpy(nameFile, "restart.gcode");
-    if (!fileRestart.exists(nameFile)) {
-      fileRestart.createContiguous(&workDir, nameFile, 1);
-      fileRestart.close();
-    }
-
-    fileRestart.open(&workDir, nameFile, O_WRITE);
-    fileRestart.truncate(0);
-
-    dtostrf(current_position[X_AXIS], 1, 3, bufferX);
-    dtostrf(current_position[Y_AXIS], 1, 3, bufferY);
-    dtostrf(current_position[Z_AXIS], 1, 3, bufferZ);
-    dtostrf(current_position[E_AXIS], 1, 3, bufferE);
+    #if ENABLED(POWER_LOSS_RECOVERY)
+      closeJournal(true);
+    #endif
+
+    resume_point_t rp;
+    get_resume_point(rp, false);
+    writeRestartScript(rp, fullName, rp.position[Z_AXIS]);
+
+    HAL::delayMilliseconds(200);
 
     #if MECH(DELTA)
-      strcpy(bufferCoord1, "G1 Z");
-      strcat(bufferCoord1, bufferZ);
-      strcat(bufferCoord1, " F8000");
+      enqueue_and_echo_commands_P(PSTR("G28"));
     #else
-      strcpy(bufferCoord1, "G92 Z");
-      strcat(bufferCoord1, bufferZ);
+      enqueue_and_echo_commands_P(PSTR("G28 X Y"));
     #endif
 
-    strcpy(bufferCoord, "G1 X");
-    strcat(bufferCoord, bufferX);
-    strcat(bufferCoord, " Y");
-    strcat(bufferCoord, bufferY);
-    strcat(bufferCoord, " Z");
-    strcat(bufferCoord, bufferZ);
-    strcat(bufferCoord, " F3600");
-    strcpy(bufferCoord2, "G92 E");
-    strcat(bufferCoord2, bufferE);
+    disable_all_heaters();
+    disable_all_coolers();
+    fanSpeed = 0;
+  }
+}
 
-    for (int8_t i = 0; i < (int8_t)strlen(fullName); i++)
-      fullName[i] = tolower(fullName[i]);
+/**
+ * Open the folder of the selected file, fullName being relative to curDir
+ */
+bool CardReader::openFileDir(SdBaseFile &dir) {
+  char* slash = strrchr(fullName, '/');
+  if (!slash) {
+    dir = *curDir;
+    return true;
+  }
+  *slash = '\0';
+  bool ok = fullName[0] ? dir.open(curDir, fullName, O_READ) : dir.openRoot(fat.vol());
+  *slash = '/';
+  return ok;
+}
 
-    strcpy(bufferFilerestart, "M34 S");
-    strcat(bufferFilerestart, bufferSdpos);
-    strcat(bufferFilerestart, " @");
-    strcat(bufferFilerestart, fullName);
+/**
+ * True when the selected file is restart.gcode
+ */
+bool CardReader::restartSelected() {
+  const char* name = strrchr(fullName, '/');
+  return strcasecmp_P(name ? name + 1 : fullName, PSTR("restart.gcode")) == 0;
+}
 
-    #if MECH(DELTA)
-      fileRestart.write("G28\n");
-    #else
-      fileRestart.write(bufferCoord1);
-      fileRestart.write("\n");
-      fileRestart.write("G28 X Y\n");
-    #endif
+/**
+ * Write restart.gcode in the working directory from a resume point:
+ * home, heat up, go back to the saved position and continue
+ * the print of file 'name' from the saved file position with M34.
+ * z_now is the current height of the nozzle, Z being not homed.
+ */
+void CardReader::writeRestartScript(resume_point_t &rp, char* name, const float z_now) {
+  char line[40], bufferZ[11], buffer[11];
+
+  if (!workDir.exists("restart.gcode")) {
+    fileRestart.createContiguous(&workDir, "restart.gcode", 1);
+    fileRestart.close();
+    invalidateIndex();
+  }
+
+  fileRestart.open(&workDir, "restart.gcode", O_WRITE);
+  fileRestart.truncate(0);
+
+  #if MECH(DELTA)
+    fileRestart.write("G28\n");
+  #else
+    sprintf_P(line, PSTR("G92 Z%s\n"), dtostrf(z_now, 1, 3, bufferZ));
+    fileRestart.write(line);
+    fileRestart.write("G28 X Y\n");
+  #endif
+
+  dtostrf(rp.position[Z_AXIS], 1, 3, bufferZ);
+
+  if (rp.target_temperature_bed > 0) {
+    sprintf_P(line, PSTR("M190 S%i\n"), rp.target_temperature_bed);
+    fileRestart.write(line);
+  }
+
+  sprintf_P(line, PSTR("T%i\n"), rp.active_extruder);
+  fileRestart.write(line);
+
+  for (uint8_t h = 0; h < HOTENDS; h++) {
+    if (rp.target_temperature[h] > 0) {
+      sprintf_P(line, PSTR("M109 T%i S%i\n"), h, rp.target_temperature[h]);
+      fileRestart.write(line);
+    }
+  }
+
+  #if MECH(DELTA)
+    sprintf_P(line, PSTR("G1 Z%s F8000\n"), bufferZ);
+    fileRestart.write(line);
+  #endif
+
+  fileRestart.write("G1 X");
+  fileRestart.write(dtostrf(rp.position[X_AXIS], 1, 3, buffer));
+  fileRestart.write(" Y");
+  fileRestart.write(dtostrf(rp.position[Y_AXIS], 1, 3, buffer));
+  sprintf_P(line, PSTR(" Z%s F3600\n"), bufferZ);
+  fileRestart.write(line);
+
+  if (rp.fan_speed > 0) {
+    sprintf_P(line, PSTR("M106 S%i\n"), rp.fan_speed);
+    fileRestart.write(line);
+  }
+
+  sprintf_P(line, PSTR("G92 E%s\n"), dtostrf(rp.position[E_AXIS], 1, 3, buffer));
+  fileRestart.write(line);
+
+  if (rp.relative_e) fileRestart.write("M83\n");
+
+  // Lowercase so that M34 can't mistake letters of the name for parameters
+  for (char* c = name; *c; c++) *c = tolower(*c);
+
+  sprintf_P(line, PSTR("M34 S%lu F%i @"), (unsigned long)rp.sdpos, (int)rp.feedrate_mm_m);
+  fileRestart.write(line);
+  fileRestart.write(name);
+  fileRestart.write("\n");
+
+  fileRestart.sync();
+  fileRestart.close();
+}
+
+#if ENABLED(POWER_LOSS_RECOVERY)
+
+  /**
+   * CRC-16/CCITT, used to validate the power-loss journal
+   */
+  uint16_t CardReader::crc16(uint16_t crc, const void* data, uint16_t len) {
+    const uint8_t* b = (const uint8_t*)data;
+    while (len--) {
+      crc ^= (uint16_t)*b++ << 8;
+      for (uint8_t i = 0; i < 8; i++)
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+  }
+
+  /**
+   * Open the power-loss journal for the file about to be printed.
+   * The journal is created contiguous in the root directory, big enough
+   * for the record and the longest file name, so that the periodic saves
+   * never need to allocate clusters. The name is written once here.
+   */
+  void CardReader::openJournal() {
+    if (!journal_enabled || fileJournal.isOpen()) return;
+
+    // restart.gcode ends with M34 that reopens the journal for the real file
+    if (restartSelected()) return;
+
+    if (!root.exists(POWER_LOSS_JOURNAL_FILE)) {
+      fileJournal.createContiguous(&root, POWER_LOSS_JOURNAL_FILE, sizeof(resume_point_t) + sizeof(fullName));
+      invalidateIndex();
+    }
+    else
+      fileJournal.open(&root, POWER_LOSS_JOURNAL_FILE, O_RDWR);
 
-    if (degTargetBed() > 0) {
-      char Bedtemp[15];
-      sprintf(Bedtemp, "M190 S%i\n", (int)degTargetBed());
-      fileRestart.write(Bedtemp);
+    if (!fileJournal.isOpen()) {
+      ECHO_LMT(ER, SERIAL_SD_OPEN_FILE_FAIL, POWER_LOSS_JOURNAL_FILE);
+      return;
     }
 
-    char CurrHotend[10];
-    sprintf(CurrHotend, "T%i\n", active_extruder);
-    fileRestart.write(CurrHotend);
+    journal_name_length = strlen(fullName);
+    journal_name_crc = crc16(0xFFFF, fullName, journal_name_length);
+    fileJournal.seekSet(sizeof(resume_point_t));
+    fileJournal.write(fullName, journal_name_length);
+    fileJournal.sync();
+  }
+
+  /**
+   * Overwrite the journal record with the current print state.
+   * Called every POWER_LOSS_JOURNAL_SECONDS while printing.
+   */
+  void CardReader::saveJournal() {
+    if (!fileJournal.isOpen()) return;
+
+    resume_point_t rp;
+    get_resume_point(rp, true);
+    rp.name_length = journal_name_length;
+    rp.crc = crc16(journal_name_crc, &rp, offsetof(resume_point_t, crc));
+
+    fileJournal.seekSet(0);
+    if (fileJournal.write(&rp, sizeof(rp)) != sizeof(rp) || !fileJournal.sync())
+      ECHO_LM(ER, SERIAL_SD_ERR_WRITE_TO_FILE);
+  }
+
+  /**
+   * Close the journal. On a normal end of print it is invalidated
+   * by clearing the version byte of the record.
+   */
+  void CardReader::closeJournal(bool invalidate) {
+    if (!fileJournal.isOpen()) return;
+    if (invalidate) {
+      uint8_t version = 0;
+      fileJournal.seekSet(0);
+      fileJournal.write(&version, 1);
+    }
+    fileJournal.close();
+  }
+
+  /**
+   * Invalidate the journal, open or left on the card by an earlier print,
+   * so that it can't be resumed. The file is kept for the next print.
+   */
+  void CardReader::discardJournal() {
+    if (!fileJournal.isOpen() && (!cardOK || !fileJournal.open(&root, POWER_LOSS_JOURNAL_FILE, O_RDWR))) return;
+    closeJournal(true);
+  }
+
+  /**
+   * Validate the journal, turn it into restart.gcode and print it.
+   */
+  void CardReader::resumeJournal() {
+    if (!cardOK || sdprinting) return;
+
+    setroot();
+
+    resume_point_t rp;
+    bool valid = false;
+
+    if (fileJournal.open(&root, POWER_LOSS_JOURNAL_FILE, O_READ)) {
+      valid = fileJournal.read(&rp, sizeof(rp)) == sizeof(rp)
+              && rp.version == RESUME_POINT_VERSION
+              && rp.name_length < sizeof(fullName)
+              && fileJournal.read(fullName, rp.name_length) == rp.name_length;
+      fileJournal.close();
+    }
+
+    if (valid) {
+      fullName[rp.name_length] = '\0';
+      valid = rp.crc == crc16(crc16(0xFFFF, fullName, rp.name_length), &rp, offsetof(resume_point_t, crc));
+    }
+
+    if (!valid) {
+      ECHO_LM(ER, SERIAL_JOURNAL_INVALID);
+      return;
+    }
+
+    ECHO_SMT(DB, SERIAL_JOURNAL_RESUME, fullName);
+    ECHO_EMV(SERIAL_JOURNAL_SDPOS, rp.sdpos);
+
+    writeRestartScript(rp, fullName, rp.position[Z_AXIS]);
+    if (selectFile("restart.gcode")) {
+      startPrint();
+      print_job_counter.start();
+    }
+  }
+
+#endif // POWER_LOSS_RECOVERY
+
+#if ENABLED(SD_LAYER_INDEX)
+
+  /**
+   * Open the layer index of the selected file, <name>.LIX in its folder.
+   * With create the index is emptied and a new header is written,
+   * else the header is read and checked against the file.
+   */
+  bool CardReader::openLayerIndex(layer_index_header_t &header, const bool create) {
+    dir_t entry;
+    SdBaseFile dir;
+    char name[13], *c = name;
+
+    if (fileLayers.isOpen()) fileLayers.close();
+    if (!file.dirEntry(&entry) || !openFileDir(dir)) return false;
+
+    for (uint8_t i = 0; i < 8 && entry.name[i] != ' '; i++) *c++ = entry.name[i];
+    strcpy_P(c, PSTR(".LIX"));
+
+    if (create) {
+      if (!dir.exists(name)) invalidateIndex();
+      if (!fileLayers.open(&dir, name, O_CREAT | O_RDWR | O_TRUNC)) return false;
+      header.version  = LAYER_INDEX_VERSION;
+      header.size     = entry.fileSize;
+      header.date     = entry.lastWriteDate;
+      header.time     = entry.lastWriteTime;
+      header.complete = false;
+      return fileLayers.write(&header, sizeof(header)) == sizeof(header);
+    }
+
+    return fileLayers.open(&dir, name, O_RDWR)
+        && fileLayers.read(&header, sizeof(header)) == sizeof(header)
+        && header.version == LAYER_INDEX_VERSION
+        && header.size == entry.fileSize
+        && header.date == entry.lastWriteDate
+        && header.time == entry.lastWriteTime;
+  }
 
-    for (uint8_t h = 0; h < HOTENDS; h++) {
-      if (degTargetHotend(h) > 0) {
-        char Hotendtemp[15];
-        sprintf(Hotendtemp, "M109 T%i S%i\n", h, (int)degTargetHotend(h));
-        fileRestart.write(Hotendtemp);
+  void CardReader::startLayerIndex(const resume_point_t &state) {
+    layer_index_header_t header;
+    if (!openLayerIndex(header, true)) {
+      fileLayers.close();
+      ECHO_LM(ER, SERIAL_SD_ERR_WRITE_TO_FILE);
+      return;
+    }
+    layer_pending = state;
+    layer_z = -1000;
+  }
+
+  void CardReader::finishLayerIndex(const bool complete) {
+    if (!fileLayers.isOpen()) return;
+    if (complete) {
+      fileLayers.seekSet(offsetof(layer_index_header_t, complete));
+      fileLayers.write(&complete, 1);
+    }
+    fileLayers.close();
+  }
+
+  /**
+   * Follow the moves of the file to index its layers.
+   * A move changing Z may start a layer, and it does when it's followed
+   * by an extrusion above the last layer: that skips Z lifts and travels.
+   * The print state is taken from 'state' or, when printing, from the machine.
+   */
+  void CardReader::layerIndexMove(const float from[NUM_AXIS], const float to[NUM_AXIS], resume_point_t* state/*=NULL*/) {
+    if (!fileLayers.isOpen()) return;
+
+    if (to[Z_AXIS] != from[Z_AXIS]) {
+      if (state)
+        layer_pending = *state;
+      else {
+        get_resume_point(layer_pending, false);
+        layer_pending.sdpos = command_sdpos;
       }
+      LOOP_XYZE(i) layer_pending.position[i] = from[i];
+      layer_pending.position[Z_AXIS] = to[Z_AXIS];
     }
+    else if (to[E_AXIS] > from[E_AXIS] && to[Z_AXIS] > layer_z + 0.001
+             && (to[X_AXIS] != from[X_AXIS] || to[Y_AXIS] != from[Y_AXIS])) {
+      layer_z = to[Z_AXIS];
+      if (fileLayers.write(&layer_pending, sizeof(layer_pending)) != sizeof(layer_pending)) {
+        ECHO_LM(ER, SERIAL_SD_ERR_WRITE_TO_FILE);
+        fileLayers.close();
+      }
+    }
+  }
 
-    #if MECH(DELTA)
-      fileRestart.write(bufferCoord1);
-      fileRestart.write("\n");
-    #endif
+  /**
+   * Index the layers of the selected file, reading it all.
+   * Only the commands that change the print state are followed.
+   */
+  bool CardReader::buildLayerIndex() {
+    static const char axis_codes[NUM_AXIS] PROGMEM = { 'X', 'Y', 'Z', 'E' };
+    resume_point_t state;
+    float to[NUM_AXIS];
+    char line[MAX_CMD_SIZE], *p;
+    uint8_t n = 0;
+    bool relative = false, comment = false;
+
+    memset(&state, 0, sizeof(state));
+    state.version = RESUME_POINT_VERSION;
+    state.feedrate_mm_m = 1200.0;
+    startLayerIndex(state);
+    if (!fileLayers.isOpen()) return false;
+
+    ECHO_LM(DB, SERIAL_LAYER_INDEXING);
+
+    setIndex(0);
+    for (;;) {
+      const int16_t c = get();
+
+      if (c >= 0 && c != '\n' && c != '\r') {
+        if (c == ';') comment = true;
+        if (comment || n >= MAX_CMD_SIZE - 1) continue;
+        if (!n) state.sdpos = sdpos;
+        line[n++] = c;
+        continue;
+      }
+
+      if (n) {
+        line[n] = '\0';
+        n = 0;
 
-    fileRestart.write(bufferCoord);
-    fileRestart.write("\n");
+        char* cmd = line;
+        if (*cmd == 'N' && (cmd = strchr(cmd, ' ')) == NULL) continue; // Skip the line number
+        while (*cmd == ' ') cmd++;
+        const int code = strtol(cmd + 1, &p, 10);
+        char* args = p;
 
-   	if (fanSpeed > 0) {
-      char fanSp[15];
-      sprintf(fanSp, "M106 S%i\n", fanSpeed);
-      fileRestart.write(fanSp);
+        #define LAYER_ARG(L) ((p = strchr(args, L)) != NULL)
+        #define LAYER_VAL strtod(p + 1, NULL)
+
+        if (*cmd == 'G') switch (code) {
+          case 0: case 1:
+            LOOP_XYZE(i) {
+              const bool rel = relative || (i == E_AXIS && state.relative_e);
+              to[i] = LAYER_ARG(pgm_read_byte(&axis_codes[i])) ? LAYER_VAL + (rel ? state.position[i] : 0) : state.position[i];
+            }
+            if (LAYER_ARG('F')) state.feedrate_mm_m = LAYER_VAL;
+            layerIndexMove(state.position, to, &state);
+            LOOP_XYZE(i) state.position[i] = to[i];
+            break;
+          case 90: relative = false; break;
+          case 91: relative = true; break;
+          case 92:
+            LOOP_XYZE(i) if (LAYER_ARG(pgm_read_byte(&axis_codes[i]))) state.position[i] = LAYER_VAL;
+            break;
+        }
+        else if (*cmd == 'M') switch (code) {
+          case 82: state.relative_e = false; break;
+          case 83: state.relative_e = true; break;
+          case 104: case 109: {
+            const uint8_t h = LAYER_ARG('T') ? (uint8_t)LAYER_VAL : state.active_extruder;
+            if (h < HOTENDS && LAYER_ARG('S')) state.target_temperature[h] = LAYER_VAL;
+          } break;
+          case 140: case 190:
+            if (LAYER_ARG('S')) state.target_temperature_bed = LAYER_VAL;
+            break;
+          case 106: state.fan_speed = LAYER_ARG('S') ? LAYER_VAL : 255; break;
+          case 107: state.fan_speed = 0; break;
+        }
+        else if (*cmd == 'T')
+          state.active_extruder = code;
+
+        #undef LAYER_ARG
+        #undef LAYER_VAL
+      }
+
+      if (c < 0) break;
+      comment = false;
+      if ((sdpos & 0x3FF) == 0) idle();
     }
 
-    fileRestart.write(bufferCoord2);
-    fileRestart.write("\n");
-    fileRestart.write(bufferFilerestart);
-    fileRestart.write("\n");
+    finishLayerIndex(true);
+    setIndex(0);
+    return true;
+  }
 
-    fileRestart.sync();
-    fileRestart.close();
+  /**
+   * Print the selected file from a layer, by number (from 0) or by height when layer < 0.
+   * The file is indexed first if it has no complete layer index.
+   * The current Z is used as the nozzle height in restart.gcode.
+   */
+  void CardReader::printFromLayer(const int16_t layer, const float z) {
+    layer_index_header_t header;
+    resume_point_t rp;
+    bool found = false;
+
+    if (!isFileOpen()) return;
+
+    if ((openLayerIndex(header, false) && header.complete) || (buildLayerIndex() && openLayerIndex(header, false))) {
+      if (layer >= 0)
+        found = fileLayers.seekSet(sizeof(header) + (uint32_t)layer * sizeof(rp)) && fileLayers.read(&rp, sizeof(rp)) == sizeof(rp);
+      else
+        while (!found && fileLayers.read(&rp, sizeof(rp)) == sizeof(rp))
+          found = rp.position[Z_AXIS] >= z - 0.001;
+    }
+    fileLayers.close();
 
-    HAL::delayMilliseconds(200);
+    if (!found) {
+      ECHO_LM(ER, SERIAL_LAYER_NOT_FOUND);
+      return;
+    }
 
-    #if MECH(DELTA)
-      enqueue_and_echo_commands_P(PSTR("G28"));
-    #else
-      enqueue_and_echo_commands_P(PSTR("G28 X Y"));
-    #endif
+    ECHO_LMV(DB, SERIAL_LAYER_START, rp.position[Z_AXIS]);
 
-    disable_all_heaters();
-    disable_all_coolers();
-    fanSpeed = 0;
+    writeRestartScript(rp, fullName, current_position[Z_AXIS]);
+    if (selectFile("restart.gcode")) {
+      startPrint();
+      print_job_counter.start();
+    }
   }
-}
+
+#endif // SD_LAYER_INDEX
 
 void CardReader::checkautostart(bool force) {
   if (!force && (!autostart_stilltocheck || next_autostart_ms >= millis()))
@@ -460,8 +1000,17 @@ void CardReader::checkautostart(bool force) {
 
 void CardReader::printingHasFinished() {
   st_synchronize();
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    closeJournal(true);
+  #endif
+  #if ENABLED(SD_LAYER_INDEX)
+    finishLayerIndex(true);
+  #endif
   file.close();
   sdprinting = false;
+  #if ENABLED(TOOL_CHANGE_PREHEAT)
+    toolchange_preheat_reset();
+  #endif
   if (SD_FINISHED_STEPPERRELEASE) {
     enqueue_and_echo_commands_P(PSTR(SD_FINISHED_RELEASECOMMAND));
     print_job_counter.stop();
@@ -473,11 +1022,13 @@ void CardReader::setroot(bool temporary /*=false*/) {
   if(temporary) lastDir = workDir;
   workDir = root;
   curDir = &workDir;
+  invalidateIndex();
 }
 
 void CardReader::setlast() {
   workDir = lastDir;
   curDir = &workDir;
+  invalidateIndex();
 }
 
 // --------------------------------------------------------------- //
@@ -494,10 +1045,13 @@ void CardReader::parsejson(SdBaseFile &file) {
   objectHeight      = 0.0;
   firstlayerHeight  = 0.0;
   layerHeight       = 0.0;
+  layerCount        = 0;
+  printTime         = 0;
 
   if (!file.isOpen()) return;
 
-  bool genByFound = false, firstlayerHeightFound = false, layerHeightFound = false, filamentNeedFound = false;
+  bool genByFound = false, firstlayerHeightFound = false, layerHeightFound = false, filamentNeedFound = false,
+       layerCountFound = false, printTimeFound = false;
 
   #if CPU_ARCH==ARCH_AVR
     #define GCI_BUF_SIZE 120
@@ -505,39 +1059,135 @@ void CardReader::parsejson(SdBaseFile &file) {
     #define GCI_BUF_SIZE 1024
   #endif
 
+  #define GCI_READ() do{ int n = file.read(buf, GCI_BUF_SIZE - 1); buf[n > 0 ? n : 0] = '\0'; }while(0)
+
   // READ 4KB FROM THE BEGINNING
   char buf[GCI_BUF_SIZE];
   for (int i = 0; i < 4096; i += GCI_BUF_SIZE - 50) {
     if(!file.seekSet(i)) break;
-    file.read(buf, GCI_BUF_SIZE);
+    GCI_READ();
     if (!genByFound && findGeneratedBy(buf, generatedBy)) genByFound = true;
     if (!firstlayerHeightFound && findFirstLayerHeight(buf, firstlayerHeight)) firstlayerHeightFound = true;
     if (!layerHeightFound && findLayerHeight(buf, layerHeight)) layerHeightFound = true;
     if (!filamentNeedFound && findFilamentNeed(buf, filamentNeeded)) filamentNeedFound = true;
-    if(genByFound && layerHeightFound && filamentNeedFound) goto get_objectHeight;
+    if (!layerCountFound && findLayerCount(buf, layerCount)) layerCountFound = true;
+    if (!printTimeFound && findPrintTime(buf, printTime)) printTimeFound = true;
+    if(genByFound && layerHeightFound && filamentNeedFound && printTimeFound) goto get_objectHeight;
   }
 
   // READ 4KB FROM END
   for (int i = 0; i < 4096; i += GCI_BUF_SIZE - 50) {
     if(!file.seekEnd(-4096 + i)) break;
-    file.read(buf, GCI_BUF_SIZE);
+    GCI_READ();
     if (!genByFound && findGeneratedBy(buf, generatedBy)) genByFound = true;
     if (!firstlayerHeightFound && findFirstLayerHeight(buf, firstlayerHeight)) firstlayerHeightFound = true;
     if (!layerHeightFound && findLayerHeight(buf, layerHeight)) layerHeightFound = true;
     if (!filamentNeedFound && findFilamentNeed(buf, filamentNeeded)) filamentNeedFound = true;
-    if(genByFound && layerHeightFound && filamentNeedFound) goto get_objectHeight;
+    if (!layerCountFound && findLayerCount(buf, layerCount)) layerCountFound = true;
+    if (!printTimeFound && findPrintTime(buf, printTime)) printTimeFound = true;
+    if(genByFound && layerHeightFound && filamentNeedFound && printTimeFound) goto get_objectHeight;
   }
 
   get_objectHeight:
   // MOVE FROM END UP IN 1KB BLOCKS UP TO 30KB
   for (int i = GCI_BUF_SIZE; i < 30000; i += GCI_BUF_SIZE - 50) {
     if(!file.seekEnd(-i)) break;
-    file.read(buf, GCI_BUF_SIZE);
+    GCI_READ();
     if (findTotalHeight(buf, objectHeight)) break;
   }
   file.seekSet(0);
+
+  // Slicers that don't tell the layer count
+  if (!layerCountFound && layerHeight > 0 && objectHeight > 0) {
+    const float first = firstlayerHeight > 0 ? firstlayerHeight : layerHeight;
+    layerCount = 1 + (uint16_t)((objectHeight - first) / layerHeight + 0.5);
+  }
 }
 
+#if ENABLED(SD_METADATA_CACHE)
+
+  /**
+   * Look for the record of a directory entry in an open SD_METADATA_FILE.
+   * Return true when the record is current. slot is where the record of the
+   * entry goes, a stale record with the same name is replaced.
+   */
+  static bool findMetadata(SdBaseFile &meta, const dir_t &entry, gcode_meta_t &rec, uint16_t &slot) {
+    for (slot = 0; meta.read(&rec, sizeof(rec)) == sizeof(rec); slot++) {
+      if (memcmp(rec.name, entry.name, sizeof(rec.name))) continue;
+      return rec.size == entry.fileSize && rec.date == entry.lastWriteDate && rec.time == entry.lastWriteTime;
+    }
+    return false;
+  }
+
+  /**
+   * Get the cached metadata of the file last found by getfilename(),
+   * without opening the file. Used by the LCD file browser.
+   */
+  bool CardReader::getFileMetadata(gcode_meta_t &rec) {
+    SdBaseFile meta;
+    uint16_t slot;
+    if (filenameIsDir || !meta.open(&workDir, SD_METADATA_FILE, O_READ)) return false;
+    const bool found = findMetadata(meta, filenameEntry, rec, slot);
+    meta.close();
+    return found;
+  }
+
+  /**
+   * Get the metadata of the selected file from the SD_METADATA_FILE of its folder.
+   * When it isn't there, or the file changed, parse the file and store the result.
+   */
+  void CardReader::getMetadata() {
+    dir_t entry;
+    SdBaseFile dir, meta;
+    gcode_meta_t rec;
+
+    if (!file.dirEntry(&entry) || !openFileDir(dir)) {
+      parsejson(file);
+      return;
+    }
+
+    uint16_t slot = 0;
+    if (meta.open(&dir, SD_METADATA_FILE, O_RDWR)) {
+      if (findMetadata(meta, entry, rec, slot)) {
+        fileSize          = rec.size;
+        objectHeight      = rec.objectHeight;
+        firstlayerHeight  = rec.firstlayerHeight;
+        layerHeight       = rec.layerHeight;
+        filamentNeeded    = rec.filamentNeeded;
+        layerCount        = rec.layerCount;
+        printTime         = rec.printTime;
+        memcpy(generatedBy, rec.generatedBy, sizeof(generatedBy));
+        meta.close();
+        return;
+      }
+    }
+    else if (meta.open(&dir, SD_METADATA_FILE, O_CREAT | O_RDWR))
+      invalidateIndex();
+
+    parsejson(file);
+
+    if (!meta.isOpen()) return;
+
+    memcpy(rec.name, entry.name, sizeof(rec.name));
+    rec.size              = entry.fileSize;
+    rec.date              = entry.lastWriteDate;
+    rec.time              = entry.lastWriteTime;
+    rec.objectHeight      = objectHeight;
+    rec.firstlayerHeight  = firstlayerHeight;
+    rec.layerHeight       = layerHeight;
+    rec.filamentNeeded    = filamentNeeded;
+    rec.layerCount        = layerCount;
+    rec.printTime         = printTime;
+    memcpy(rec.generatedBy, generatedBy, sizeof(rec.generatedBy));
+
+    meta.seekSet((uint32_t)slot * sizeof(rec));
+    if (meta.write(&rec, sizeof(rec)) != sizeof(rec))
+      ECHO_LM(ER, SERIAL_SD_ERR_WRITE_TO_FILE);
+    meta.close();
+  }
+
+#endif // SD_METADATA_CACHE
+
 void CardReader::printEscapeChars(const char* s) {
   for (unsigned int i = 0; i < strlen(s); ++i) {
     switch (s[i]) {
@@ -669,7 +1319,7 @@ bool CardReader::findFilamentNeed(char* buf, float& filament) {
 }
 
 bool CardReader::findTotalHeight(char* buf, float& height) {
-  int len = 1024;
+  int len = strlen(buf);
   bool inComment, inRelativeMode = false;
   unsigned int zPos;
   for (int i = len - 5; i > 0; i--) {
@@ -724,6 +1374,41 @@ bool CardReader::findTotalHeight(char* buf, float& height) {
   return false;
 }
 
+bool CardReader::findLayerCount(char* buf, uint16_t& layerCount) {
+  // CURA
+  const char* layerCountCura = PSTR(";LAYER_COUNT:");
+  char* pos = strstr_P(buf, layerCountCura);
+  if (pos) {
+    layerCount = strtol(pos + strlen_P(layerCountCura), NULL, 10);
+    return true;
+  }
+  return false;
+}
+
+bool CardReader::findPrintTime(char* buf, uint32_t& printTime) {
+  char* pos;
+  if ((pos = strstr_P(buf, PSTR(";TIME:"))) == NULL                     // CURA, seconds
+      && (pos = strstr_P(buf, PSTR("estimated printing time"))) == NULL // SLIC3R PE, 1d 2h 3m 4s
+      && (pos = strstr_P(buf, PSTR("Build time:"))) == NULL)            // S3D, 1 hours 2 minutes
+    return false;
+
+  // Add up every number of the line, scaled by the unit that follows it
+  printTime = 0;
+  while (*pos && *pos != '\n' && *pos != '\r' && !isDigit(*pos)) ++pos;
+  while (isDigit(*pos)) {
+    uint32_t n = strtoul(pos, &pos, 10);
+    while (*pos == ' ') ++pos;
+    switch (*pos) {
+      case 'd': n *= 86400UL; break;
+      case 'h': n *= 3600UL; break;
+      case 'm': n *= 60UL; break;
+    }
+    printTime += n;
+    while (*pos && *pos != '\n' && *pos != '\r' && !isDigit(*pos)) ++pos;
+  }
+  return true;
+}
+
 /**
  * File parser for KEY->VALUE format from files
  *
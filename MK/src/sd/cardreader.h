@@ -36,7 +36,61 @@
 extern char tempLongFilename[LONG_FILENAME_LENGTH + 1];
 extern char fullName[LONG_FILENAME_LENGTH * SD_MAX_FOLDER_DEPTH + SD_MAX_FOLDER_DEPTH + 1];
 
-enum LsAction { LS_Count, LS_GetFilename };
+enum LsAction { LS_Count, LS_GetFilename, LS_Index };
+
+#define RESUME_POINT_VERSION 1
+
+/**
+ * Everything needed to restart an SD print from a given file position.
+ * Used to write restart.gcode (M33) and, with POWER_LOSS_RECOVERY, as the
+ * record of the binary power-loss journal. The file name follows the record
+ * in the journal and is covered by the same CRC.
+ */
+typedef struct {
+  uint8_t   version;
+  uint32_t  sdpos;                          // File position of the first command not yet completed
+  float     position[NUM_AXIS];             // Logical position, mm
+  float     feedrate_mm_m;
+  int16_t   target_temperature[HOTENDS],
+            target_temperature_bed,
+            fan_speed;
+  uint8_t   active_extruder;
+  bool      relative_e;
+  uint16_t  name_length;
+  uint16_t  crc;
+} resume_point_t;
+
+void get_resume_point(resume_point_t &rp, const bool stepper_pos);
+
+#if ENABLED(SD_LAYER_INDEX)
+  #define LAYER_INDEX_VERSION 1
+
+  /**
+   * Header of a layer index, <name>.LIX next to the G-code file.
+   * It's followed by one resume point per layer, the position being
+   * where the move to the layer starts, except Z that is the layer height.
+   */
+  typedef struct {
+    uint8_t   version;
+    uint32_t  size;                         // Size and date of the indexed file
+    uint16_t  date, time;
+    bool      complete;                     // Every layer of the file is indexed
+  } layer_index_header_t;
+#endif
+
+/**
+ * G-code metadata of a file, as stored in the SD_METADATA_FILE of its folder.
+ * The record is valid as long as name, size and date of the file match.
+ */
+typedef struct {
+  uint8_t   name[11];                       // 8.3 name, as in the directory entry
+  uint32_t  size;
+  uint16_t  date, time;                     // Last write
+  float     objectHeight, firstlayerHeight, layerHeight, filamentNeeded;
+  uint16_t  layerCount;
+  uint32_t  printTime;                      // Seconds, as estimated by the slicer
+  char      generatedBy[GENBY_SIZE];
+} gcode_meta_t;
 
 #include "SDFat.h"
 
@@ -45,6 +99,9 @@ public:
   SdFat fat;
   SdFile file;
   SdFile fileRestart;
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    SdFile fileJournal;
+  #endif
   CardReader();
 
   void initsd();
@@ -73,6 +130,26 @@ public:
 
   uint16_t getnrfilenames();
 
+  #if ENABLED(SD_METADATA_CACHE)
+    bool getFileMetadata(gcode_meta_t &rec);
+  #endif
+
+  void writeRestartScript(resume_point_t &rp, char* name, const float z_now);
+
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    void openJournal();
+    void saveJournal();
+    void closeJournal(bool invalidate);
+    void discardJournal();
+    void resumeJournal();
+    bool journal_enabled;
+  #endif
+
+  #if ENABLED(SD_LAYER_INDEX)
+    void layerIndexMove(const float from[NUM_AXIS], const float to[NUM_AXIS], resume_point_t* state = NULL);
+    void printFromLayer(const int16_t layer, const float z);
+  #endif
+
   void parseKeyLine(char* key, char* value, int &len_k, int &len_v);
   void unparseKeyLine(const char* key, char* value);
 
@@ -83,6 +160,12 @@ public:
   FORCE_INLINE uint8_t percentDone() { return (isFileOpen() && fileSize) ? sdpos / ((fileSize + 99) / 100) : 0; }
   FORCE_INLINE char* getWorkDirName() { workDir.getFilename(fullName); return fullName; }
 
+  #if ENABLED(SD_DIR_INDEX)
+    FORCE_INLINE void invalidateIndex() { dir_index_valid = false; }
+  #else
+    FORCE_INLINE void invalidateIndex() {}
+  #endif
+
   //files init.g on the sd card are performed in a row
   //this is to delay autostart and hence the initialisaiton of the sd card to some seconds after the normal init, so the device is available quick after a reset
   void checkautostart(bool x);
@@ -90,6 +173,8 @@ public:
   bool saving, sdprinting, cardOK, filenameIsDir;
   uint32_t fileSize, sdpos;
   float objectHeight, firstlayerHeight, layerHeight, filamentNeeded;
+  uint16_t layerCount;
+  uint32_t printTime;
   char generatedBy[GENBY_SIZE];
 
   static void printEscapeChars(const char* s);
@@ -103,12 +188,49 @@ private:
   LsAction lsAction; //stored for recursion.
   bool autostart_stilltocheck; //the sd start is delayed, because otherwise the serial cannot answer fast enought to make contact with the hostsoftware.
   void lsDive(SdBaseFile parent, const char* const match = NULL);
+
+  #if ENABLED(SD_DIR_INDEX)
+    bool dir_index_valid;
+    uint16_t dir_index[SD_DIR_INDEX_SIZE],  // Directory entry number of every dir_index_stride-th file, bit 15 set for folders
+             dir_index_count,               // Files in the working directory
+             dir_index_stride;
+    #if ENABLED(SD_DIR_INDEX_SORT_NAME) || ENABLED(SD_DIR_INDEX_SORT_DATE)
+      uint32_t dir_index_key[SD_DIR_INDEX_SIZE];
+      bool indexLess(uint16_t e1, uint32_t k1, uint16_t e2, uint32_t k2);
+      void sortIndex(uint16_t first, uint16_t last);
+    #endif
+    void buildIndex();
+  #endif
   void parsejson(SdBaseFile &file);
+  bool openFileDir(SdBaseFile &dir);
+  bool restartSelected();
+  #if ENABLED(SD_METADATA_CACHE)
+    dir_t filenameEntry;                    // Directory entry of the file found by getfilename()
+    void getMetadata();
+  #endif
   bool findGeneratedBy(char* buf, char* genBy);
   bool findFirstLayerHeight(char* buf, float& firstlayerHeight);
   bool findLayerHeight(char* buf, float& layerHeight);
   bool findFilamentNeed(char* buf, float& filament);
   bool findTotalHeight(char* buf, float& objectHeight);
+  bool findLayerCount(char* buf, uint16_t& layerCount);
+  bool findPrintTime(char* buf, uint32_t& printTime);
+
+  #if ENABLED(SD_LAYER_INDEX)
+    SdFile fileLayers;
+    resume_point_t layer_pending;           // Start of the last move that changed Z
+    float layer_z;                          // Height of the last indexed layer
+    bool openLayerIndex(layer_index_header_t &header, const bool create);
+    void startLayerIndex(const resume_point_t &state);
+    void finishLayerIndex(const bool complete);
+    bool buildLayerIndex();
+  #endif
+
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    uint16_t journal_name_crc;
+    uint16_t journal_name_length;
+    static uint16_t crc16(uint16_t crc, const void* data, uint16_t len);
+  #endif
 };
 
 extern CardReader card;
@@ -47,12 +47,107 @@
 //================================== macros =================================
 //===========================================================================
 
-#if ENABLED(K1) // Defined in Configuration_base.h in the PID settings
-  #define K2 (1.0 - K1)
+#if ENABLED(PIDTEMPBED) || ENABLED(PIDTEMP) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER) || ENABLED(MPCTEMP)
+  #if ENABLED(ADC_INTERRUPT_SAMPLING)
+    #define PID_dT ((OVERSAMPLENR * (float)ADC_SWEEP_TICKS)/(F_CPU / 64.0 / 256.0))
+  #else
+    #define PID_dT ((OVERSAMPLENR * 14.0)/(F_CPU / 64.0 / 256.0))
+  #endif
 #endif
 
 #if ENABLED(PIDTEMPBED) || ENABLED(PIDTEMP) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER)
-  #define PID_dT ((OVERSAMPLENR * 14.0)/(F_CPU / 64.0 / 256.0))
+  /**
+   * Fixed point PID, shared by all the controllers
+   *
+   *  Temperatures and errors in 1/16 degree
+   *  P, D and output in 1/256 PWM step, I in 1/65536 PWM step
+   *  Kp scaled by 256, Ki by 65536, Kd by 16 (see pid_set_gains)
+   *
+   * The errors and the temperature changes are clamped so that
+   * the products fit in 32 bit. Kd/PID_dT gets large with a short
+   * PID_dT, so it has fewer fraction bits and the widest range.
+   */
+  #define PID_TEMP_SHIFT  4
+  #define PID_ERROR_MAX   2047L       // 128 degrees
+  #define PID_DELTA_MAX   1023L       // 64 degrees per cycle
+  #define PID_TERM_MAX    0x3FFFFFL   // 16383 PWM steps, far beyond any output
+  #define PID_KP_MAX      4095.0
+  #define PID_KI_MAX      15.99       // Ki * PID_dT
+  #define PID_KD_MAX      131071.0    // Kd / PID_dT
+  #define PID_K1          ((int32_t)(K1 * 256 + 0.5)) // Smoothing of the D term
+  #define PID_K2          (256 - PID_K1)
+
+  typedef struct {
+    int32_t Kp, Ki, Kd;
+    int32_t pTerm, dTerm;   // 1/256 PWM step
+    int32_t iTerm, iMax;    // 1/65536 PWM step
+    int16_t last;           // Last measurement, 1/16 degree
+  } fixed_pid_t;
+#endif
+
+// Sensor of each controller
+#if ENABLED(HEATER_0_USES_MAX6675)
+  #define HEATER_0_SENSOR SENSOR_MAX6675
+#elif HASNT(TEMP_0)
+  #define HEATER_0_SENSOR SENSOR_NONE
+#elif ENABLED(HEATER_0_USES_AD595)
+  #define HEATER_0_SENSOR SENSOR_AD595
+#else
+  #define HEATER_0_SENSOR SENSOR_THERMISTOR
+#endif
+#if HASNT(TEMP_1)
+  #define HEATER_1_SENSOR SENSOR_NONE
+#elif ENABLED(HEATER_1_USES_AD595)
+  #define HEATER_1_SENSOR SENSOR_AD595
+#else
+  #define HEATER_1_SENSOR SENSOR_THERMISTOR
+#endif
+#if HASNT(TEMP_2)
+  #define HEATER_2_SENSOR SENSOR_NONE
+#elif ENABLED(HEATER_2_USES_AD595)
+  #define HEATER_2_SENSOR SENSOR_AD595
+#else
+  #define HEATER_2_SENSOR SENSOR_THERMISTOR
+#endif
+#if HASNT(TEMP_3)
+  #define HEATER_3_SENSOR SENSOR_NONE
+#elif ENABLED(HEATER_3_USES_AD595)
+  #define HEATER_3_SENSOR SENSOR_AD595
+#else
+  #define HEATER_3_SENSOR SENSOR_THERMISTOR
+#endif
+#if HASNT(TEMP_BED)
+  #define BED_SENSOR SENSOR_NONE
+#elif ENABLED(BED_USES_AD595)
+  #define BED_SENSOR SENSOR_AD595
+#else
+  #define BED_SENSOR SENSOR_THERMISTOR
+#endif
+#if HASNT(TEMP_CHAMBER)
+  #define CHAMBER_SENSOR SENSOR_NONE
+#elif ENABLED(CHAMBER_USES_AD595)
+  #define CHAMBER_SENSOR SENSOR_AD595
+#else
+  #define CHAMBER_SENSOR SENSOR_THERMISTOR
+#endif
+#if HASNT(TEMP_COOLER)
+  #define COOLER_SENSOR SENSOR_NONE
+#elif ENABLED(COOLER_USES_AD595)
+  #define COOLER_SENSOR SENSOR_AD595
+#else
+  #define COOLER_SENSOR SENSOR_THERMISTOR
+#endif
+
+#ifdef __SAM3X8E__
+  #define AD595_VREF 3.3
+#else
+  #define AD595_VREF 5.0
+#endif
+
+#if ENABLED(MPCTEMP)
+  #define HOTEND_MAX_POWER MPC_MAX
+#else
+  #define HOTEND_MAX_POWER PID_MAX
 #endif
 
 //===========================================================================
@@ -126,22 +221,8 @@ void setPwmCooler(unsigned char pwm);
   int current_raw_filwidth = 0;  //Holds measured filament diameter - one extruder only
 #endif
 
-#if ENABLED(THERMAL_PROTECTION_HOTENDS) || ENABLED(THERMAL_PROTECTION_BED) || ENABLED(THERMAL_PROTECTION_COOLER)
+#if HAS(THERMAL_PROTECTION)
   enum TRState { TRInactive, TRFirstRunning, TRStable, TRRunaway };
-  void thermal_runaway_protection(TRState* state, millis_t* timer, float temperature, float target_temperature, int temp_controller_id, int period_seconds, int hysteresis_degc);
-
-  #if ENABLED(THERMAL_PROTECTION_HOTENDS)
-    static TRState thermal_runaway_state_machine[HOTENDS] = { TRInactive };
-    static millis_t thermal_runaway_timer[HOTENDS] = { 0 };
-  #endif
-  #if ENABLED(THERMAL_PROTECTION_BED) && TEMP_SENSOR_BED != 0
-    static TRState thermal_runaway_bed_state_machine = TRInactive;
-    static millis_t thermal_runaway_bed_timer;
-  #endif
-  #if ENABLED(THERMAL_PROTECTION_COOLER) && TEMP_SENSOR_COOLER != 0
-    static TRState thermal_runaway_cooler_state_machine = TRReset;
-    static millis_t thermal_runaway_cooler_timer;
-  #endif
 #endif
 
 #if HAS(POWER_CONSUMPTION_SENSOR)
@@ -156,66 +237,24 @@ void setPwmCooler(unsigned char pwm);
 static volatile bool temp_meas_ready = false;
 
 #if ENABLED(PIDTEMP)
-  //static cannot be external:
-  static float temp_iState[HOTENDS] = { 0 };
-  static float temp_dState[HOTENDS] = { 0 };
-  static float pTerm[HOTENDS];
-  static float iTerm[HOTENDS];
-  static float dTerm[HOTENDS];
+  static fixed_pid_t hotend_pid[HOTENDS];
   #if ENABLED(PID_ADD_EXTRUSION_RATE)
     static float cTerm[HOTENDS];
     static long last_e_position;
     static long lpq[LPQ_MAX_LEN];
     static int lpq_ptr = 0;
   #endif
-  //int output;
-  static float pid_error[HOTENDS];
-  static float temp_iState_min[HOTENDS];
-  static float temp_iState_max[HOTENDS];
   static bool pid_reset[HOTENDS];
 #endif //PIDTEMP
 #if ENABLED(PIDTEMPBED)
-  //static cannot be external:
-  static float temp_iState_bed = { 0 };
-  static float temp_dState_bed = { 0 };
-  static float pTerm_bed;
-  static float iTerm_bed;
-  static float dTerm_bed;
-  //int output;
-  static float pid_error_bed;
-  static float temp_iState_min_bed;
-  static float temp_iState_max_bed;
-#else // PIDTEMPBED
-  static millis_t next_bed_check_ms;
-#endif // !PIDTEMPBED
+  static fixed_pid_t bed_pid;
+#endif
 #if ENABLED(PIDTEMPCHAMBER)
-  //static cannot be external:
-  static float temp_iState_chamber = { 0 };
-  static float temp_dState_chamber = { 0 };
-  static float pTerm_chamber;
-  static float iTerm_chamber;
-  static float dTerm_chamber;
-  //int output;
-  static float pid_error_chamber;
-  static float temp_iState_min_chamber;
-  static float temp_iState_max_chamber;
-#else // PIDTEMPCHAMBER
-  static millis_t next_chamber_check_ms;
-#endif // !PIDTEMPCHAMBER
+  static fixed_pid_t chamber_pid;
+#endif
 #if ENABLED(PIDTEMPCOOLER)
-  //static cannot be external:
-  static float temp_iState_cooler = { 0 };
-  static float temp_dState_cooler = { 0 };
-  static float pTerm_cooler;
-  static float iTerm_cooler;
-  static float dTerm_cooler;
-  //int output;
-  static float pid_error_cooler;
-  static float temp_iState_min_cooler;
-  static float temp_iState_max_cooler;
-#else // PIDTEMPCOOLER
-  static millis_t next_cooler_check_ms;
-#endif // !PIDTEMPCOOLER
+  static fixed_pid_t cooler_pid;
+#endif
 
 static unsigned char soft_pwm[HOTENDS];
 
@@ -236,69 +275,119 @@ static unsigned char soft_pwm[HOTENDS];
   float Kp[HOTENDS], Ki[HOTENDS], Kd[HOTENDS], Kc[HOTENDS];
 #endif //PIDTEMP
 
-// Init min and max temp with extreme values to prevent false errors during startup
-static int minttemp_raw[HOTENDS] = ARRAY_BY_HOTENDS_N( HEATER_0_RAW_LO_TEMP , HEATER_1_RAW_LO_TEMP , HEATER_2_RAW_LO_TEMP, HEATER_3_RAW_LO_TEMP);
-static int maxttemp_raw[HOTENDS] = ARRAY_BY_HOTENDS_N( HEATER_0_RAW_HI_TEMP , HEATER_1_RAW_HI_TEMP , HEATER_2_RAW_HI_TEMP, HEATER_3_RAW_HI_TEMP);
-static int minttemp[HOTENDS] = { 0 };
-static int maxttemp[HOTENDS] = ARRAY_BY_HOTENDS(16383);
-#if ENABLED(BED_MINTEMP)
-  static int bed_minttemp_raw = HEATER_BED_RAW_LO_TEMP;
-#endif
-#if ENABLED(BED_MAXTEMP)
-  static int bed_maxttemp_raw = HEATER_BED_RAW_HI_TEMP;
-#endif
-#if ENABLED(CHAMBER_MINTEMP)
-  static int chamber_minttemp_raw = HEATER_CHAMBER_RAW_LO_TEMP;
-#endif
-#if ENABLED(CHAMBER_MAXTEMP)
-  static int chamber_maxttemp_raw = HEATER_CHAMBER_RAW_HI_TEMP;
-#endif
-#if ENABLED(COOLER_MINTEMP)
-  static int cooler_minttemp_raw = COOLER_RAW_LO_TEMP;
-#endif
-#if ENABLED(COOLER_MAXTEMP)
-  static int cooler_maxttemp_raw = COOLER_RAW_HI_TEMP;
-#endif
+#if ENABLED(MPCTEMP)
+  mpc_settings_t mpc_settings[HOTENDS];
 
-#if ENABLED(TEMP_SENSOR_1_AS_REDUNDANT)
-  static void* heater_ttbl_map[2] = {(void*)HEATER_0_TEMPTABLE, (void*)HEATER_1_TEMPTABLE };
-  static uint8_t heater_ttbllen_map[2] = { HEATER_0_TEMPTABLE_LEN, HEATER_1_TEMPTABLE_LEN };
-#else
-  static void* heater_ttbl_map[HOTENDS] = ARRAY_BY_HOTENDS_N( (void*)HEATER_0_TEMPTABLE, (void*)HEATER_1_TEMPTABLE, (void*)HEATER_2_TEMPTABLE, (void*)HEATER_3_TEMPTABLE );
-  static uint8_t heater_ttbllen_map[HOTENDS] = ARRAY_BY_HOTENDS_N( HEATER_0_TEMPTABLE_LEN, HEATER_1_TEMPTABLE_LEN, HEATER_2_TEMPTABLE_LEN, HEATER_3_TEMPTABLE_LEN );
-#endif
+  // Modeled temperatures of a hotend
+  typedef struct {
+    float block_temp, sensor_temp, ambient_temp;
+    bool ready;                     // Starts from the first reading
+  } mpc_model_t;
 
-static float analog2temp(int raw, uint8_t e);
-static float analog2tempBed(int raw);
-static float analog2tempChamber(int raw);
-static float analog2tempCooler(int raw);
-static void updateTemperaturesFromRawValues();
+  static mpc_model_t mpc_model[HOTENDS];
 
-#if ENABLED(THERMAL_PROTECTION_HOTENDS)
-  int watch_target_temp[HOTENDS] = { 0 };
-  millis_t watch_heater_next_ms[HOTENDS] = { 0 };
+  /**
+   * Measure of the model of a hotend (M307 T), one at a time as
+   * the fan is shared. Like the PID autotune it is advanced by
+   * manage_temp_controller at each reading.
+   */
+  enum MPCTunePhase { MPCTuneOff, MPCTuneCooling, MPCTuneHeating, MPCTuneHold, MPCTuneHoldFan };
+
+  typedef struct {
+    MPCTunePhase phase;
+    uint8_t h;
+    int target,                     // Target of the hotend in this phase
+        old_fan_speed;
+    millis_t deadline, next_test_ms, measure_ms, heat_start_ms;
+    float ambient_temp, last_temp, heat_power, t1_time, total_power, total_temp,
+          temp_samples[16];
+    uint8_t sample_count;
+    uint16_t sample_distance, count;
+  } mpc_autotune_t;
+
+  static mpc_autotune_t mpc_tune;
+
+  static int mpc_autotune_output(const uint8_t h);
 #endif
 
-#if ENABLED(THERMAL_PROTECTION_BED)
-  int watch_target_bed_temp = 0;
-  millis_t watch_bed_next_ms = 0;
+/**
+ * Temperature controllers
+ *
+ * One descriptor for each controller: the hotends first, then bed, chamber
+ * and cooler. The control loop, the heating watch, the thermal runaway
+ * protection and the MIN/MAX checks in the ISR all go through this table.
+ */
+#define BED_INDEX     (HOTENDS)
+#define CHAMBER_INDEX (HOTENDS + 1)
+#define COOLER_INDEX  (HOTENDS + 2)
+#define HEATER_COUNT  (HOTENDS + 3)
+
+typedef struct {
+  int8_t id;                        // For the error handler: hotend number, -1 bed, -2 chamber, -3 cooler
+  uint8_t sensor;                   // TempSensorType, SENSOR_NONE without a sensor
+  bool cooling;                     // Drives the temperature down
+  int *target, *raw;
+  float *current;
+  const short (*table)[2];          // Thermistor table, in PROGMEM
+  uint8_t table_len;
+  bool raw_rising;                  // The ADC value grows with the temperature
+  int mintemp, maxtemp;             // Working range, the output is off outside of it
+  int minttemp_raw, maxttemp_raw;   // MIN/MAX limits as ADC sums, checked by the ISR
+  unsigned char* soft_pwm;          // Duty (0-127) for the soft PWM in the ISR
+  int max_power, output;            // Output limit and last output, 0-255
+  #if ENABLED(PIDTEMPBED) || ENABLED(PIDTEMP) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER)
+    fixed_pid_t* pid;               // NULL for bang-bang
+    #if ENABLED(PID_DEBUG) || ENABLED(PID_BED_DEBUG) || ENABLED(PID_CHAMBER_DEBUG) || ENABLED(PID_COOLER_DEBUG)
+      bool pid_debug;
+    #endif
+  #endif
+  uint8_t bang_hysteresis;          // Bang-bang switching band, 0 switches at the target
+  millis_t check_interval,          // Bang-bang update period, 0 for every reading
+           next_check_ms;
+  #if HAS(THERMAL_PROTECTION)
+    bool protect;                   // Watch and thermal runaway checks enabled
+    uint8_t temp_hysteresis,        // "Close to the target" band
+            tr_hysteresis,          // Runaway band around the target
+            watch_increase;         // Degrees to gain (or lose) in each watch period
+    uint16_t tr_period,             // Seconds out of the band before a runaway
+             watch_period;          // Seconds
+    TRState tr_state;
+    int tr_target, watch_target;
+    millis_t tr_timer, watch_next_ms;
+  #endif
+} heater_t;
+
+static heater_t heaters[HEATER_COUNT];
+
+#if ENABLED(PIDTEMPBED) || ENABLED(PIDTEMP) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER)
+  /**
+   * Relay autotune of a PID controller (M303). It is advanced by
+   * manage_temp_controller at each reading, so more controllers can
+   * be tuned at once and the thermal protection stays on.
+   */
+  typedef struct {
+    bool active, set_result,
+         high;                      // Output high, waiting to pass the setpoint
+    uint8_t cycles, ncycles;
+    int temp;                       // Setpoint, also the target of the controller
+    long bias, d, t_high, t_low;
+    millis_t t1, t2;
+    float max, min, Kp, Ki, Kd;
+  } pid_autotune_t;
+
+  static pid_autotune_t pid_autotune[HEATER_COUNT];
+
+  static int pid_autotune_output(const uint8_t tc);
 #endif
 
+static float analog2temp(const int raw, const uint8_t tc);
+static void updateTemperaturesFromRawValues();
+
 #if ENABLED(PREVENT_DANGEROUS_EXTRUDE)
   float extrude_min_temp = EXTRUDE_MINTEMP;
   bool allow_cold_extrude = false;
 #endif
 
-#if ENABLED(THERMAL_PROTECTION_CHAMBER)
-  int watch_target_temp_chamber = 0;
-  millis_t watch_chamber_next_ms = 0;
-#endif
-
-#if ENABLED(THERMAL_PROTECTION_COOLER)
-  int watch_target_temp_cooler = 0;
-  millis_t watch_cooler_next_ms = 0;
-#endif
-
 #if DISABLED(SOFT_PWM_SCALE)
   #define SOFT_PWM_SCALE 0
 #endif
@@ -343,260 +432,64 @@ void autotempShutdown() {
   #endif
 }
 
-#if  HAS(PID_HEATING) || HAS(PID_COOLING) 
-  void PID_autotune(float temp, int temp_controller, int ncycles, bool set_result/*=false*/) {
-    float input = 0.0;
-    int cycles = 0;
-    bool running = true;
+#if ENABLED(PIDTEMPBED) || ENABLED(PIDTEMP) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER)
 
-    millis_t temp_ms = millis(), t1 = temp_ms, t2 = temp_ms;
-    long t_high = 0, t_low = 0;
+  /**
+   * Convert the float gains to fixed point. Kp up to 4096, scaled Ki
+   * up to 16 and scaled Kd up to 131072 keep the products in 32 bit.
+   * Gains beyond are limited and reported.
+   */
+  static void pid_set_gains(fixed_pid_t &pid, const float p, const float i, const float d, const float i_max) {
+    if (p > PID_KP_MAX || i > PID_KI_MAX || d > PID_KD_MAX)
+      ECHO_LM(ER, SERIAL_PID_GAIN_LIMITED);
+    pid.Kp = constrain(p, 0, PID_KP_MAX) * 256.0;
+    pid.Ki = constrain(i, 0, PID_KI_MAX) * 65536.0;
+    pid.Kd = constrain(d, 0, PID_KD_MAX) * 16.0;
+    pid.iMax = i_max * 65536.0;
+    pid.iTerm = constrain(pid.iTerm, 0, pid.iMax);
+  }
 
-    long bias = 0, d = 0;
-    float Ku = 0, Tu = 0;
-    float workKp = 0, workKi = 0, workKd = 0;
-    float max = 0, min = 10000;
+  // Round to 1/16 degree, truncating would bias the I term
+  FORCE_INLINE int16_t pid_temp(const float temp) { return temp * (1 << PID_TEMP_SHIFT) + (temp < 0 ? -0.5 : 0.5); }
 
-    #if HAS(AUTO_FAN)
-      millis_t next_auto_fan_check_ms = temp_ms + 2500;
-    #endif
+  /**
+   * Derivative on the measurement, so a new target doesn't kick it.
+   * Called every cycle, also while the PID output is not used.
+   */
+  static void pid_derivative(fixed_pid_t &pid, const int16_t temp) {
+    const int32_t delta = constrain(temp - pid.last, -PID_DELTA_MAX, PID_DELTA_MAX),
+                  d_raw = constrain(delta * pid.Kd, -PID_TERM_MAX, PID_TERM_MAX); // 1/16 degree * Kd * 16
+    pid.dTerm = (PID_K2 * d_raw + PID_K1 * pid.dTerm) >> 8;
+    pid.last = temp;
+  }
 
-    if (temp_controller >= HOTENDS
-      #if HASNT(TEMP_BED) && HASNT(TEMP_COOLER)
-        || temp_controller < 0
-      #elif HASNT(TEMP_BED)
-        || (temp_controller == -1 && temp_controller < -3)
-      #elif HASNT(TEMP_COOLER)
-        || temp_controller < -2 
-      #endif
-    ) {
-      ECHO_LM(ER, SERIAL_PID_BAD_TEMP_CONTROLLER_NUM);
-      return;
-    }
+  /**
+   * PID output in PWM steps, 0 to max_output. extra (1/256 PWM step) is added to it.
+   * Anti-windup: the I term stays within 0 and its drive limit, and stops
+   * integrating while the output is saturated in the direction of the error.
+   */
+  static int pid_compute(fixed_pid_t &pid, const int16_t error, const int32_t extra, const int16_t max_output) {
+    const int32_t err = constrain(error, -PID_ERROR_MAX, PID_ERROR_MAX),
+                  i_step = (err * pid.Ki) >> PID_TEMP_SHIFT,
+                  iTerm = constrain(pid.iTerm + i_step, 0, pid.iMax),
+                  max_q8 = (int32_t)max_output << 8;
 
-    ECHO_LM(DB, SERIAL_PID_AUTOTUNE_START);
-    if (temp_controller == -1) {
-      ECHO_SM(DB, "BED");
-    }
-    else if(temp_controller == -2) {
-      ECHO_SM(DB, "CHAMBER");
-    }
-    else if(temp_controller == -3) {
-      ECHO_SM(DB, "COOLER");
-    }
-    else {
-      ECHO_SMV(DB, "Hotend: ", temp_controller);
-    }
-    ECHO_MV(" Temp: ", temp);
-    ECHO_MV(" Cycles: ", ncycles);
-    if (set_result)
-      ECHO_EM(" Apply result");
-    else
-      ECHO_E;
+    pid.pTerm = (err * pid.Kp) >> PID_TEMP_SHIFT;
 
-    disable_all_heaters(); // switch off all heaters.
-    disable_all_coolers(); // switch off all coolers.
+    int32_t output = pid.pTerm + (iTerm >> 8) - pid.dTerm + extra;
 
-    if (temp_controller == -1)
-      soft_pwm_bed = bias = d = MAX_BED_POWER / 2;
-    else if (temp_controller == -3) {
-      bias = d = MAX_COOLER_POWER / 2;
-      setPwmCooler(MAX_COOLER_POWER);
+    if (output > max_q8) {
+      if (i_step <= 0) pid.iTerm = iTerm;
+      return max_output;
     }
-    else
-      soft_pwm[temp_controller] = bias = d = PID_MAX / 2;
-
-    // PID Tuning loop
-    for (;;) {
-
-      millis_t ms = millis();
-
-      if (temp_meas_ready) { // temp sample ready
-        updateTemperaturesFromRawValues();
-
-        if (temp_controller == -1) 
-          input = current_temperature_bed;
-        else if (temp_controller == -3) 
-          input = current_temperature_cooler;
-        else  
-          input = current_temperature[temp_controller];
-
-        max = max(max, input);
-        min = min(min, input);
-
-        #if HAS(AUTO_FAN)
-          if (ms > next_auto_fan_check_ms) {
-            checkExtruderAutoFans();
-            next_auto_fan_check_ms = ms + 2500UL;
-          }
-        #endif
-
-        if (running && ((input > temp && temp_controller >= -1) || (input < temp && temp_controller < -1))) {
-          if (ms > t2 + 5000UL) {
-            running = false;
-
-            if (temp_controller == -3) 
-              setPwmCooler((bias - d));
-            else if (temp_controller == -1)
-              soft_pwm_bed = (bias - d) >> 1;
-            else
-              soft_pwm[temp_controller] = (bias - d) >> 1;
-
-            t1 = ms;
-            t_high = t1 - t2;
-
-            if (temp_controller == -3)
-              min = temp;
-            else
-              max = temp;
-          }
-        }
-
-        if (!running && ((input < temp && temp_controller >= -1) || (input > temp && temp_controller < -1))) {
-          if (ms > t1 + 5000UL) {
-            running = true;
-            t2 = ms;
-            t_low = t2 - t1;
-            if (cycles > 0) {
-              long max_pow;
-
-              if (temp_controller == -3)
-                max_pow = MAX_COOLER_POWER;
-              else
-                max_pow = temp_controller < 0 ? MAX_BED_POWER : PID_MAX;
-
-              bias += (d * (t_high - t_low)) / (t_low + t_high);
-              bias = constrain(bias, 20, max_pow - 20);
-              d = (bias > max_pow / 2) ? max_pow - 1 - bias : bias;
-
-              ECHO_MV(SERIAL_BIAS, bias);
-              ECHO_MV(SERIAL_D, d);
-              ECHO_MV(SERIAL_T_MIN, min);
-              ECHO_MV(SERIAL_T_MAX, max);
-              if (cycles > 2) {
-                Ku = (4.0 * d) / (3.14159265 * (max - min) / 2.0);
-                Tu = ((float)(t_low + t_high) / 1000.0);
-                ECHO_MV(SERIAL_KU, Ku);
-                ECHO_EMV(SERIAL_TU, Tu);
-                workKp = 0.6 * Ku;
-                workKi = 2 * workKp / Tu;
-                workKd = workKp * Tu / 8;
-                
-                ECHO_EM(SERIAL_CLASSIC_PID);
-                ECHO_MV(SERIAL_KP, workKp);
-                ECHO_MV(SERIAL_KI, workKi);
-                ECHO_EMV(SERIAL_KD, workKd);
-              }
-              else {
-                ECHO_E;
-              }
-            }
-
-            #if ENABLED(PIDTEMP)
-              if (temp_controller >= 0)
-                soft_pwm[temp_controller] = (bias + d) >> 1;
-            #endif
-
-            #if ENABLED(PIDTEMPBED)
-              if (temp_controller == -1)
-                soft_pwm_bed = (bias + d) >> 1;
-            #endif
-
-            #if ENABLED(PIDTEMPCOOLER)
-              if (temp_controller == -3)
-                setPwmCooler((bias + d));
-            #endif
-
-            cycles++;
-
-            if(temp_controller == -3)
-              max = temp;
-            else
-              min = temp;
-          }
-        }
-      }
-      if (input > temp + MAX_OVERSHOOT_PID_AUTOTUNE && temp_controller >= -1) {
-        ECHO_LM(ER, SERIAL_PID_TEMP_TOO_HIGH);
-        return;
-      }
-      else if (input < temp + MAX_OVERSHOOT_PID_AUTOTUNE && temp_controller < -1) {
-		    ECHO_LM(ER, SERIAL_PID_TEMP_TOO_LOW);
-		    return;
-		  }
-      // Every 2 seconds...
-      if (ELAPSED(ms, temp_ms + 2000UL)) {
-        #if HAS(TEMP_0) || HAS(TEMP_BED) || ENABLED(HEATER_0_USES_MAX6675)
-          print_heaterstates();
-          ECHO_E;
-        #endif
-        #if HAS(TEMP_CHAMBER)
-          print_chamberstate();
-          ECHO_E;
-        #endif
-        #if HAS(TEMP_COOLER)
-          print_coolerstate();
-          ECHO_E;
-        #endif
-
-        temp_ms = ms;
-      } // every 2 seconds
-
-      // Over 2 minutes?
-      if (((ms - t1) + (ms - t2)) > (10L*60L*1000L*2L)) {
-        ECHO_LM(ER, SERIAL_PID_TIMEOUT);
-        return;
-      }
-      if (cycles > ncycles) {
-        ECHO_LM(DB, SERIAL_PID_AUTOTUNE_FINISHED);
-
-        #if ENABLED(PIDTEMP)
-          if (temp_controller >= 0) {
-            ECHO_SMV(DB, SERIAL_KP, workKp);
-            ECHO_MV(SERIAL_KI, workKi);
-            ECHO_EMV(SERIAL_KD, workKd);
-            if (set_result) {
-              PID_PARAM(Kp, temp_controller) = workKp;
-              PID_PARAM(Ki, temp_controller) = scalePID_i(workKi);
-              PID_PARAM(Kd, temp_controller) = scalePID_d(workKd);
-              updatePID();
-            }
-          }
-        #endif
-
-        #if ENABLED(PIDTEMPBED)
-          if (temp_controller == -1) {
-            ECHO_LMV(DB, "#define DEFAULT_bedKp ", workKp);
-            ECHO_LMV(DB, "#define DEFAULT_bedKi ", workKi);
-            ECHO_LMV(DB, "#define DEFAULT_bedKd ", workKd);
-            if (set_result) {
-              bedKp = workKp;
-              bedKi = scalePID_i(workKi);
-              bedKd = scalePID_d(workKd);
-              updatePID();
-            }
-          }
-        #endif
-
-        #if ENABLED(PIDTEMPCOOLER)
-          if (temp_controller == -3) {
-            ECHO_LMV(DB, "#define DEFAULT_coolerKp ", workKp);
-            ECHO_LMV(DB, "#define DEFAULT_coolerKi ", workKi);
-            ECHO_LMV(DB, "#define DEFAULT_coolerKd ", workKd);
-            if (set_result) {
-              coolerKp = workKp;
-              coolerKi = scalePID_i(workKi);
-              coolerKd = scalePID_d(workKd);
-              updatePID();
-            }
-          }
-        #endif
-
-        return;
-      }
-      lcd_update();
+    if (output < 0) {
+      if (i_step >= 0) pid.iTerm = iTerm;
+      return 0;
     }
+    pid.iTerm = iTerm;
+    return output >> 8;
   }
+
 #endif
 
 void updatePID() {
@@ -604,18 +497,17 @@ void updatePID() {
     #if ENABLED(PID_ADD_EXTRUSION_RATE)
       last_e_position = 0;
     #endif
-    HOTEND_LOOP() {
-      temp_iState_max[h] = PID_INTEGRAL_DRIVE_MAX / PID_PARAM(Ki, h);
-    }
+    HOTEND_LOOP()
+      pid_set_gains(hotend_pid[h], PID_PARAM(Kp, h), PID_PARAM(Ki, h), PID_PARAM(Kd, h), PID_INTEGRAL_DRIVE_MAX);
   #endif
   #if ENABLED(PIDTEMPBED)
-    temp_iState_max_bed = PID_BED_INTEGRAL_DRIVE_MAX / bedKi;
+    pid_set_gains(bed_pid, bedKp, bedKi, bedKd, PID_BED_INTEGRAL_DRIVE_MAX);
   #endif
   #if ENABLED(PIDTEMPCHAMBER)
-	 temp_iState_max_chamber = PID_CHAMBER_INTEGRAL_DRIVE_MAX / chamberKi;
+    pid_set_gains(chamber_pid, chamberKp, chamberKi, chamberKd, PID_CHAMBER_INTEGRAL_DRIVE_MAX);
   #endif
   #if ENABLED(PIDTEMPCOOLER)
-	 temp_iState_max_cooler = PID_COOLER_INTEGRAL_DRIVE_MAX / coolerKi;
+    pid_set_gains(cooler_pid, coolerKp, coolerKi, coolerKd, PID_COOLER_INTEGRAL_DRIVE_MAX);
   #endif
 }
 
@@ -712,594 +604,909 @@ inline void _temp_error(int tc, const char* serial_msg, const char* lcd_msg) {
   #endif
 }
 
-void max_temp_error(uint8_t h) {
-  _temp_error(h, PSTR(SERIAL_T_MAXTEMP), PSTR(MSG_ERR_MAXTEMP));
+void max_temp_error(const uint8_t tc) {
+  const int8_t id = heaters[tc].id;
+  _temp_error(id, PSTR(SERIAL_T_MAXTEMP),
+    id == -1 ? PSTR(MSG_ERR_MAXTEMP_BED) : id == -2 ? PSTR(MSG_ERR_MAXTEMP_CHAMBER) : id == -3 ? PSTR(MSG_ERR_MAXTEMP_COOLER) : PSTR(MSG_ERR_MAXTEMP)
+  );
 }
-void min_temp_error(uint8_t h) {
-  _temp_error(h, PSTR(SERIAL_T_MINTEMP), PSTR(MSG_ERR_MINTEMP));
+void min_temp_error(const uint8_t tc) {
+  const int8_t id = heaters[tc].id;
+  _temp_error(id, PSTR(SERIAL_T_MINTEMP),
+    id == -1 ? PSTR(MSG_ERR_MINTEMP_BED) : id == -2 ? PSTR(MSG_ERR_MINTEMP_CHAMBER) : id == -3 ? PSTR(MSG_ERR_MINTEMP_COOLER) : PSTR(MSG_ERR_MINTEMP)
+  );
 }
 
-float get_pid_output(int h) {
-  #if HOTENDS == 1
-    UNUSED(h);
-    #define _HOTEND_TEST  true
-  #else
-    #define _HOTEND_TEST  h == active_extruder
-  #endif
+#if ENABLED(PIDTEMPBED) || ENABLED(PIDTEMP) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER)
 
-  float pid_output;
-  #if ENABLED(PIDTEMP)
-    #if DISABLED(PID_OPENLOOP)
-      pid_error[HOTEND_INDEX] = target_temperature[HOTEND_INDEX] - current_temperature[HOTEND_INDEX];
-      dTerm[HOTEND_INDEX] = K2 * PID_PARAM(Kd, HOTEND_INDEX) * (current_temperature[HOTEND_INDEX] - temp_dState[HOTEND_INDEX]) + K1 * dTerm[HOTEND_INDEX];
-      temp_dState[HOTEND_INDEX] = current_temperature[HOTEND_INDEX];
-      if (pid_error[HOTEND_INDEX] > PID_FUNCTIONAL_RANGE) {
-        pid_output = BANG_MAX;
-        pid_reset[HOTEND_INDEX] = true;
-      }
-      else if (pid_error[HOTEND_INDEX] < -PID_FUNCTIONAL_RANGE || target_temperature[HOTEND_INDEX] == 0) {
-        pid_output = 0;
-        pid_reset[HOTEND_INDEX] = true;
-      }
-      else {
-        if (pid_reset[HOTEND_INDEX]) {
-          temp_iState[HOTEND_INDEX] = 0.0;
-          pid_reset[HOTEND_INDEX] = false;
-        }
-        pTerm[HOTEND_INDEX] = PID_PARAM(Kp, HOTEND_INDEX) * pid_error[HOTEND_INDEX];
-        temp_iState[HOTEND_INDEX] += pid_error[HOTEND_INDEX];
-        temp_iState[HOTEND_INDEX] = constrain(temp_iState[HOTEND_INDEX], temp_iState_min[HOTEND_INDEX], temp_iState_max[HOTEND_INDEX]);
-        iTerm[HOTEND_INDEX] = PID_PARAM(Ki, HOTEND_INDEX) * temp_iState[HOTEND_INDEX];
-
-        pid_output = pTerm[HOTEND_INDEX] + iTerm[HOTEND_INDEX] - dTerm[HOTEND_INDEX];
-
-        #if ENABLED(PID_ADD_EXTRUSION_RATE)
-          cTerm[HOTEND_INDEX] = 0;
-          if (_HOTEND_TEST) {
-            long e_position = st_get_position(E_AXIS);
-            if (e_position > last_e_position) {
-              lpq[lpq_ptr++] = e_position - last_e_position;
-              last_e_position = e_position;
-            }
-            else {
-              lpq[lpq_ptr] = 0;
-            }
-            if (++lpq_ptr >= lpq_len) lpq_ptr = 0;
-            cTerm[HOTEND_INDEX] = (lpq[lpq_ptr] / planner.axis_steps_per_mm[E_AXIS + active_extruder]) * PID_PARAM(Kc, HOTEND_INDEX);
-            pid_output += cTerm[HOTEND_INDEX];
-          }
-        #endif // PID_ADD_EXTRUSION_RATE
+  /**
+   * PID output of a controller, 0 to its max power.
+   * The hotends also have the functional range and the extrusion rate term.
+   */
+  static int get_pid_output(const uint8_t tc) {
+    heater_t &ht = heaters[tc];
+    int pid_output = 0;
 
-        if (pid_output > PID_MAX) {
-          if (pid_error[HOTEND_INDEX] > 0) temp_iState[HOTEND_INDEX] -= pid_error[HOTEND_INDEX]; // conditional un-integration
-          pid_output = PID_MAX;
-        }
-        else if (pid_output < 0) {
-          if (pid_error[HOTEND_INDEX] < 0) temp_iState[HOTEND_INDEX] -= pid_error[HOTEND_INDEX]; // conditional un-integration
-          pid_output = 0;
-        }
-      }
+    #if ENABLED(PID_OPENLOOP)
+      pid_output = constrain(*ht.target, 0, ht.max_power);
     #else
-      pid_output = constrain(target_temperature[HOTEND_INDEX], 0, PID_MAX);
-    #endif // PID_OPENLOOP
+      fixed_pid_t &pid = *ht.pid;
 
-    #if ENABLED(PID_DEBUG)
-      ECHO_SMV(DB, SERIAL_PID_DEBUG, HOTEND_INDEX);
-      ECHO_MV(SERIAL_PID_DEBUG_INPUT, current_temperature[HOTEND_INDEX]);
-      ECHO_MV(SERIAL_PID_DEBUG_OUTPUT, pid_output);
-      ECHO_MV(SERIAL_PID_DEBUG_PTERM, pTerm[HOTEND_INDEX]);
-      ECHO_MV(SERIAL_PID_DEBUG_ITERM, iTerm[HOTEND_INDEX]);
-      ECHO_MV(SERIAL_PID_DEBUG_DTERM, dTerm[HOTEND_INDEX]);
-      #if ENABLED(PID_ADD_EXTRUSION_RATE)
-        ECHO_MV(SERIAL_PID_DEBUG_CTERM, cTerm[HOTEND_INDEX]);
-      #endif
-      ECHO_E;
-    #endif // PID_DEBUG
+      // Cooling: the error and the derivative are reversed
+      const int16_t temp = pid_temp(*ht.current),
+                    pid_error = ht.cooling ? temp - pid_temp(*ht.target) : pid_temp(*ht.target) - temp;
+      pid_derivative(pid, ht.cooling ? -temp : temp);
 
-  #else /* PID off */
-    pid_output = (current_temperature[HOTEND_INDEX] < target_temperature[HOTEND_INDEX]) ? PID_MAX : 0;
-  #endif
+      bool pid_on = true;
+      int32_t extra = 0;
 
-  return pid_output;
-}
+      #if ENABLED(PIDTEMP)
+        if (tc < HOTENDS) {
+          if (pid_error > pid_temp(PID_FUNCTIONAL_RANGE)) {
+            pid_output = BANG_MAX;
+            pid_on = false;
+          }
+          else if (pid_error < -pid_temp(PID_FUNCTIONAL_RANGE) || *ht.target == 0) {
+            pid_output = 0;
+            pid_on = false;
+          }
 
-#if ENABLED(PIDTEMPBED)
-  float get_pid_output_bed() {
-    float pid_output;
+          if (!pid_on)
+            pid_reset[tc] = true;
+          else if (pid_reset[tc]) {
+            pid.iTerm = 0;
+            pid_reset[tc] = false;
+          }
 
-    #if ENABLED(PID_OPENLOOP)
-      pid_output = constrain(target_temperature_bed, 0, MAX_BED_POWER);
-    #else
-      pid_error_bed = target_temperature_bed - current_temperature_bed;
-      pTerm_bed = bedKp * pid_error_bed;
-      temp_iState_bed += pid_error_bed;
-      temp_iState_bed = constrain(temp_iState_bed, temp_iState_min_bed, temp_iState_max_bed);
-      iTerm_bed = bedKi * temp_iState_bed;
-
-      dTerm_bed = K2 * bedKd * (current_temperature_bed - temp_dState_bed) + K1 * dTerm_bed;
-      temp_dState_bed = current_temperature_bed;
-
-      pid_output = pTerm_bed + iTerm_bed - dTerm_bed;
-      if (pid_output > MAX_BED_POWER) {
-        if (pid_error_bed > 0) temp_iState_bed -= pid_error_bed; // conditional un-integration
-        pid_output = MAX_BED_POWER;
-      }
-      else if (pid_output < 0) {
-        if (pid_error_bed < 0) temp_iState_bed -= pid_error_bed; // conditional un-integration
-        pid_output = 0;
-      }
+          #if ENABLED(PID_ADD_EXTRUSION_RATE)
+            cTerm[tc] = 0;
+            if (pid_on && (HOTENDS == 1 || tc == active_extruder)) {
+              long e_position = st_get_position(E_AXIS);
+              if (e_position > last_e_position) {
+                lpq[lpq_ptr++] = e_position - last_e_position;
+                last_e_position = e_position;
+              }
+              else {
+                lpq[lpq_ptr] = 0;
+              }
+              if (++lpq_ptr >= lpq_len) lpq_ptr = 0;
+              cTerm[tc] = (lpq[lpq_ptr] / planner.axis_steps_per_mm[E_AXIS + active_extruder]) * PID_PARAM(Kc, tc);
+              extra = cTerm[tc] * 256.0;
+            }
+          #endif // PID_ADD_EXTRUSION_RATE
+        }
+      #endif // PIDTEMP
+
+      if (pid_on) pid_output = pid_compute(pid, pid_error, extra, ht.max_power);
     #endif // PID_OPENLOOP
 
-    #if ENABLED(PID_BED_DEBUG)
-      ECHO_SM(DB ," PID_BED_DEBUG ");
-      ECHO_MV(": Input ", current_temperature_bed);
-      ECHO_MV(" Output ", pid_output);
-      ECHO_MV(" pTerm ", pTerm_bed);
-      ECHO_MV(" iTerm ", iTerm_bed);
-      ECHO_EMV(" dTerm ", dTerm_bed);
-    #endif // PID_BED_DEBUG
+    #if ENABLED(PID_DEBUG) || ENABLED(PID_BED_DEBUG) || ENABLED(PID_CHAMBER_DEBUG) || ENABLED(PID_COOLER_DEBUG)
+      if (ht.pid_debug) {
+        ECHO_SMV(DB, SERIAL_PID_DEBUG, (int)ht.id);
+        ECHO_MV(SERIAL_PID_DEBUG_INPUT, *ht.current);
+        ECHO_MV(SERIAL_PID_DEBUG_OUTPUT, pid_output);
+        #if DISABLED(PID_OPENLOOP)
+          ECHO_MV(SERIAL_PID_DEBUG_PTERM, pid.pTerm / 256.0);
+          ECHO_MV(SERIAL_PID_DEBUG_ITERM, pid.iTerm / 65536.0);
+          ECHO_MV(SERIAL_PID_DEBUG_DTERM, pid.dTerm / 256.0);
+          #if ENABLED(PID_ADD_EXTRUSION_RATE)
+            if (tc < HOTENDS) ECHO_MV(SERIAL_PID_DEBUG_CTERM, cTerm[tc]);
+          #endif
+        #endif
+        ECHO_E;
+      }
+    #endif // PID_DEBUG
 
     return pid_output;
   }
+
 #endif
 
-#if ENABLED(PIDTEMPCHAMBER)
-  float get_pid_output_chamber() {
-    float pid_output;
+#if ENABLED(MPCTEMP)
 
-    #if ENABLED(PID_OPENLOOP)
-      pid_output = constrain(target_temperature_chamber, 0, MAX_CHAMBER_POWER);
-    #else
-      pid_error_chamber = target_temperature_chamber - current_temperature_chamber;
-      pTerm_chamber = chamberKp * pid_error_chamber;
-      temp_iState_chamber += pid_error_chamber;
-      temp_iState_chamber = constrain(temp_iState_chamber, temp_iState_min_chamber, temp_iState_max_chamber);
-      iTerm_chamber = chamberKi * temp_iState_chamber;
-
-      dTerm_chamber = K2 * chamberKd * (current_temperature_chamber - temp_dState_chamber) + K1 * dTerm_chamber;
-      temp_dState_chamber = current_temperature_chamber;
-
-      pid_output = pTerm_chamber + iTerm_chamber - dTerm_chamber;
-      if (pid_output > MAX_CHAMBER_POWER) {
-        if (pid_error_chamber > 0) temp_iState_chamber -= pid_error_chamber; // conditional un-integration
-        pid_output = MAX_CHAMBER_POWER;
-      }
-      else if (pid_output < 0) {
-        if (pid_error_chamber < 0) temp_iState_chamber -= pid_error_chamber; // conditional un-integration
-        pid_output = 0;
-      }
-    #endif // PID_OPENLOOP
+  /**
+   * Heat lost by a hotend per degree above the ambient, in W/K.
+   * The print fan and the filament of the queued moves take more.
+   */
+  static float mpc_ambient_xfer_coeff(const uint8_t h) {
+    const mpc_settings_t &mpc = mpc_settings[h];
+    float coeff = mpc.ambient_xfer_coeff_fan0 + mpc.fan255_adjustment * fanSpeed / 255.0;
+    if (HOTENDS == 1 || h == active_extruder)
+      coeff += planner.get_e_speed() * mpc.filament_heat_capacity_permm;
+    return coeff;
+  }
 
-    #if ENABLED(PID_CHAMBER_DEBUG)
-      ECHO_SM(DB ," PID_CHAMBER_DEBUG ");
-      ECHO_MV(": Input ", current_temperature_chamber);
-      ECHO_MV(" Output ", pid_output);
-      ECHO_MV(" pTerm ", pTerm_chamber);
-      ECHO_MV(" iTerm ", iTerm_chamber);
-      ECHO_EMV(" dTerm ", dTerm_chamber);
-    #endif // PID_CHAMBER_DEBUG
+  /**
+   * MPC output of a hotend, 0 to its max power.
+   * Advance the model by the last output, pull it toward the measured
+   * temperature, then plan the power that brings the heater block to
+   * the target in 2 seconds and covers the losses at that point.
+   */
+  static int get_mpc_output(const uint8_t h) {
+    heater_t &ht = heaters[h];
+    const mpc_settings_t &mpc = mpc_settings[h];
+    mpc_model_t &model = mpc_model[h];
+    const float temp = *ht.current;
+
+    if (!model.ready) {
+      model.block_temp = model.sensor_temp = temp;
+      model.ambient_temp = min(30.0, temp);
+      model.ready = true;
+    }
 
-    return pid_output;
-  }
-#endif
+    const float ambient_xfer_coeff = mpc_ambient_xfer_coeff(h);
 
-#if ENABLED(PIDTEMPCOOLER)
-  float get_pid_output_cooler() {
-    float pid_output;
+    const float blocktempdelta = (ht.output * mpc.heater_power / 255.0 + (model.ambient_temp - model.block_temp) * ambient_xfer_coeff)
+                                 * (PID_dT) / mpc.block_heat_capacity;
+    model.block_temp += blocktempdelta;
+    model.sensor_temp += (model.block_temp - model.sensor_temp) * mpc.sensor_responsiveness * (PID_dT);
 
-    // We need this cause 0 is lower than our current temperature probably.
-    if (target_temperature_cooler < COOLER_MINTEMP)
-      return 0.0;
+    // A slow difference from the reading is model error, a fast one is noise.
+    // Correcting by a fraction follows the first and averages out the second.
+    const float delta_to_apply = (temp - model.sensor_temp) * (MPC_SMOOTHING_FACTOR);
+    model.block_temp += delta_to_apply;
+    model.sensor_temp += delta_to_apply;
 
-    #if ENABLED(PID_OPENLOOP)
-      pid_output = constrain(target_temperature_cooler, 0, MAX_COOLER_POWER);
-    #else
-      //pid_error_cooler = target_temperature_cooler - current_temperature_cooler;
-      pid_error_cooler = current_temperature_cooler - target_temperature_cooler;
-      pTerm_cooler = coolerKp * pid_error_cooler;
-      temp_iState_cooler += pid_error_cooler;
-      temp_iState_cooler = constrain(temp_iState_cooler, temp_iState_min_cooler, temp_iState_max_cooler);
-      iTerm_cooler = coolerKi * temp_iState_cooler;
-
-      //dTerm_cooler = K2 * coolerKd * (current_temperature_cooler - temp_dState_cooler) + K1 * dTerm_cooler;
-      dTerm_cooler = K2 * coolerKd * (temp_dState_cooler - current_temperature_cooler) + K1 * dTerm_cooler;
-      temp_dState_cooler = current_temperature_cooler;
-
-      pid_output = pTerm_cooler + iTerm_cooler - dTerm_cooler;
-      if (pid_output > MAX_COOLER_POWER) {
-        if (pid_error_cooler > 0) temp_iState_cooler -= pid_error_cooler; // conditional un-integration
-        pid_output = MAX_COOLER_POWER;
-      }
-      else if (pid_output < 0) {
-        if (pid_error_cooler < 0) temp_iState_cooler -= pid_error_cooler; // conditional un-integration
-        pid_output = 0;
-      }
-    #endif // PID_OPENLOOP
+    // Near steady state (output not clipped, or the temperature settled) the error is in the ambient
+    if ((ht.output > 0 && ht.output < ht.max_power) || fabs(blocktempdelta + delta_to_apply) < (MPC_STEADYSTATE) * (PID_dT))
+      model.ambient_temp += delta_to_apply > 0 ? max(delta_to_apply, (MPC_MIN_AMBIENT_CHANGE) * (PID_dT)) : min(delta_to_apply, -(MPC_MIN_AMBIENT_CHANGE) * (PID_dT));
 
-    #if ENABLED(PID_COOLER_DEBUG)
-      ECHO_SM(DB ," PID_COOLER_DEBUG ");
-      ECHO_MV(": Input ", current_temperature_cooler);
-      ECHO_MV(" Output ", pid_output);
-      ECHO_MV(" pTerm ", pTerm_cooler);
-      ECHO_MV(" iTerm ", iTerm_cooler);
-      ECHO_EMV(" dTerm ", dTerm_cooler);
-    #endif //PID_COOLER_DEBUG
+    if (*ht.target <= 0) return 0;
 
-    return pid_output;
+    float power = (*ht.target - model.block_temp) * mpc.block_heat_capacity / 2.0;
+    power -= (model.ambient_temp - model.block_temp) * ambient_xfer_coeff;
+
+    const float output = power * 255.0 / mpc.heater_power;
+    return constrain(output, 0, ht.max_power) + 0.5;
   }
 
-#endif
+#endif // MPCTEMP
 
 /**
- * Manage heating activities for hotends, bed, chamber and cooler
- *  - Acquire updated temperature readings
- *  - Invoke thermal runaway protection
- *  - Manage extruder auto-fan
- *  - Apply filament width to the extrusion rate (may move)
- *  - Update the heated bed PID output value
+ * Output of a controller, 0 to its max power.
+ * Bang-bang with BED_LIMIT_SWITCHING and the like keeps
+ * the last output while inside the hysteresis band.
  */
-void manage_temp_controller() {
-
-  if (!temp_meas_ready) return;
+static int get_heater_output(const uint8_t tc) {
+  heater_t &ht = heaters[tc];
+  const float temp = *ht.current;
+  const int target = *ht.target;
 
-  updateTemperaturesFromRawValues();
+  // A cooler is off below its MINTEMP, as 0 is lower than the current temperature
+  if (ht.cooling && (!target || target < ht.mintemp)) return 0;
 
-  #if ENABLED(HEATER_0_USES_MAX6675)
-    float ct = current_temperature[0];
-    if (ct > min(HEATER_0_MAXTEMP, 1023)) max_temp_error(0);
-    if (ct < max(HEATER_0_MINTEMP, 0.01)) min_temp_error(0);
+  #if ENABLED(MPCTEMP)
+    if (tc < HOTENDS) return mpc_tune.phase != MPCTuneOff && tc == mpc_tune.h ? mpc_autotune_output(tc) : get_mpc_output(tc);
   #endif
 
-  #if ENABLED(THERMAL_PROTECTION_HOTENDS) || ENABLED(THERMAL_PROTECTION_BED) || ENABLED(THERMAL_PROTECTION_CHAMBER) || ENABLED(THERMAL_PROTECTION_COOLER) || DISABLED(PIDTEMPBED) || DISABLED(PIDTEMPCHAMBER) || DISABLED(PIDTEMPCOOLER) || HAS(AUTO_FAN)
-    millis_t ms = millis();
+  #if ENABLED(PIDTEMPBED) || ENABLED(PIDTEMP) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER)
+    if (pid_autotune[tc].active) return pid_autotune_output(tc);
+    if (ht.pid) return get_pid_output(tc);
   #endif
 
-  // Loop through all hotends
-  for (uint8_t e = 0; e < HOTENDS; e++) {
+  if (ht.bang_hysteresis) {
+    const int above = target + ht.bang_hysteresis,
+              below = target - ht.bang_hysteresis;
+    if (ht.cooling ? temp >= above : temp <= below) return ht.max_power;
+    if (ht.cooling ? temp <= below : temp >= above) return 0;
+    return ht.output;
+  }
 
-    #if ENABLED(THERMAL_PROTECTION_HOTENDS)
-      thermal_runaway_protection(&thermal_runaway_state_machine[e], &thermal_runaway_timer[e], current_temperature[e], target_temperature[e], e, THERMAL_PROTECTION_PERIOD, THERMAL_PROTECTION_HYSTERESIS);
-    #endif
+  return (ht.cooling ? temp > target : temp < target) ? ht.max_power : 0;
+}
 
-    float pid_output = get_pid_output(e);
+// Hand the output to the soft PWM, the cooler may also use the fast PWM
+static void set_heater_output(const uint8_t tc, const int output) {
+  heater_t &ht = heaters[tc];
+  ht.output = output;
+  if (tc == COOLER_INDEX)
+    setPwmCooler(output);
+  else
+    *ht.soft_pwm = output >> 1;
+}
 
-    // Check if temperature is within the correct range
-    soft_pwm[e] = current_temperature[e] > minttemp[e] && current_temperature[e] < maxttemp[e] ? (int)pid_output >> 1 : 0;
+#if HAS(THERMAL_PROTECTION)
+  /**
+   * Start the heating sanity check of a controller that is below
+   * (above, for the cooler) its target by a configurable margin.
+   * This is called when the temperature is set. (M104, M109, M140, M190, M141, M142)
+   */
+  static void start_watching(const uint8_t tc) {
+    heater_t &ht = heaters[tc];
+    if (!ht.protect) return;
 
-    // Check if the temperature is failing to increase
-    #if ENABLED(THERMAL_PROTECTION_HOTENDS)
+    const float temp = *ht.current;
+    const int margin = ht.watch_increase + ht.temp_hysteresis + 1;
 
-      // Is it time to check this extruder's heater?
-      if (watch_heater_next_ms[e] && ms > watch_heater_next_ms[e]) {
-        // Has it failed to increase enough?
-        if (degHotend(e) < watch_target_temp[e]) {
-          // Stop!
-          _temp_error(e, PSTR(SERIAL_T_HEATING_FAILED), PSTR(MSG_HEATING_FAILED_LCD));
-        }
-        else {
-          // Start again if the target is still far off
-          start_watching_heater(e);
-        }
-      }
+    if (*ht.target > 0 && (ht.cooling ? temp > *ht.target + margin : temp < *ht.target - margin)) {
+      ht.watch_target = ht.cooling ? temp - ht.watch_increase : temp + ht.watch_increase;
+      ht.watch_next_ms = millis() + ht.watch_period * 1000UL;
+    }
+    else
+      ht.watch_next_ms = 0;
+  }
 
-    #endif // THERMAL_PROTECTION_HOTENDS
+  /**
+   * Once a controller reaches its target, halt if the temperature
+   * stays out of the hysteresis band for longer than its period.
+   * During the relay autotune the temperature swings around the
+   * target, so the band is the autotune overshoot limit.
+   */
+  static void thermal_runaway_protection(const uint8_t tc) {
+    heater_t &ht = heaters[tc];
+    const float temp = *ht.current;
+    const int target = *ht.target;
+    #if ENABLED(PIDTEMPBED) || ENABLED(PIDTEMP) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER)
+      const int hysteresis = pid_autotune[tc].active ? MAX_OVERSHOOT_PID_AUTOTUNE : ht.tr_hysteresis;
+    #else
+      const int hysteresis = ht.tr_hysteresis;
+    #endif
 
-    // Check if the temperature is failing to increase
-    #if ENABLED(THERMAL_PROTECTION_BED)
+    // If the target temperature changes, restart
+    if (ht.tr_target != target) {
+      ht.tr_target = target;
+      ht.tr_state = target > 0 ? TRFirstRunning : TRInactive;
+    }
 
-      // Is it time to check the bed?
-      if (watch_bed_next_ms && ELAPSED(ms, watch_bed_next_ms)) {
-        // Has it failed to increase enough?
-        if (degBed() < watch_target_bed_temp) {
-          // Stop!
-          _temp_error(-1, PSTR(SERIAL_T_HEATING_FAILED), PSTR(MSG_HEATING_FAILED_LCD));
-        }
-        else {
-          // Start again if the target is still far off
-          start_watching_bed();
+    switch (ht.tr_state) {
+      // Inactive state waits for a target temperature to be set
+      case TRInactive: break;
+      // When first heating/cooling, wait for the temperature to be reached then go to Stable state
+      case TRFirstRunning:
+        if (ht.cooling ? temp > target : temp < target) break;
+        ht.tr_state = TRStable;
+      // While the temperature is stable watch for a bad temperature
+      case TRStable:
+        if (ht.cooling ? temp <= target + hysteresis : temp >= target - hysteresis) {
+          ht.tr_timer = millis() + ht.tr_period * 1000UL;
+          break;
         }
-      }
+        else if (PENDING(millis(), ht.tr_timer)) break;
+        ht.tr_state = TRRunaway;
+      case TRRunaway:
+        _temp_error(ht.id, PSTR(SERIAL_T_THERMAL_RUNAWAY), PSTR(MSG_THERMAL_RUNAWAY));
+    }
+  }
+#endif // HAS(THERMAL_PROTECTION)
 
-    #endif // THERMAL_PROTECTION_HOTENDS
+#if ENABLED(THERMAL_PROTECTION_HOTENDS)
+  void start_watching_heater(int h) { start_watching(h); }
+#endif
 
-    #if ENABLED(TEMP_SENSOR_1_AS_REDUNDANT)
-      if (fabs(current_temperature[0] - redundant_temperature) > MAX_REDUNDANT_TEMP_SENSOR_DIFF) {
-        _temp_error(0, PSTR(SERIAL_REDUNDANCY), PSTR(MSG_ERR_REDUNDANT_TEMP));
-      }
+#if ENABLED(THERMAL_PROTECTION_BED)
+  void start_watching_bed() { start_watching(BED_INDEX); }
+#endif
+
+#if ENABLED(THERMAL_PROTECTION_CHAMBER)
+  void start_watching_chamber() { start_watching(CHAMBER_INDEX); }
+#endif
+
+#if ENABLED(THERMAL_PROTECTION_COOLER)
+  void start_watching_cooler() { start_watching(COOLER_INDEX); }
+#endif
+
+#if ENABLED(PIDTEMPBED) || ENABLED(PIDTEMP) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER)
+
+  // Set the target of a controller and restart its heating watch
+  static void pid_autotune_set_target(const uint8_t tc, const int temp) {
+    *heaters[tc].target = temp;
+    #if HAS(THERMAL_PROTECTION)
+      start_watching(tc);
     #endif
+  }
+
+  /**
+   * Start the relay autotune of a controller, or stop it with temp 0.
+   * The controller target is set to temp, so the heating watch and the
+   * thermal runaway protection follow the tuning. A new target (M104,
+   * M140 etc.) stops the tuning.
+   */
+  void PID_autotune(float temp, int temp_controller, int ncycles, bool set_result/*=false*/) {
+    if (temp_controller >= HOTENDS || temp_controller < -3) {
+      ECHO_LM(ER, SERIAL_PID_BAD_TEMP_CONTROLLER_NUM);
+      return;
+    }
 
-  } // Hotends Loop
+    const uint8_t tc = temp_controller >= 0 ? temp_controller : HOTENDS - 1 - temp_controller;
+    heater_t &ht = heaters[tc];
+    pid_autotune_t &tune = pid_autotune[tc];
 
-  #if HAS(AUTO_FAN)
-    if (ms > next_auto_fan_check_ms) { // only need to check fan state very infrequently
-      checkExtruderAutoFans();
-      next_auto_fan_check_ms = ms + 2500;
+    if (ht.sensor == SENSOR_NONE || !ht.pid) {
+      ECHO_LM(ER, SERIAL_PID_BAD_TEMP_CONTROLLER_NUM);
+      return;
     }
-  #endif
 
-  // Control the extruder rate based on the width sensor
-  #if ENABLED(FILAMENT_SENSOR)
-    if (filament_sensor) {
-      meas_shift_index = filwidth_delay_index1 - meas_delay_cm;
-      if (meas_shift_index < 0) meas_shift_index += MAX_MEASUREMENT_DELAY + 1;  // loop around buffer if needed
+    if (temp <= 0) {
+      if (tune.active) {
+        tune.active = false;
+        pid_autotune_set_target(tc, 0);
+        ECHO_SMV(DB, SERIAL_PID_AUTOTUNE " ", temp_controller);
+        ECHO_EM(SERIAL_PID_AUTOTUNE_STOPPED);
+      }
+      return;
+    }
 
-      // Get the delayed info and add 100 to reconstitute to a percent of
-      // the nominal filament diameter then square it to get an area
-      meas_shift_index = constrain(meas_shift_index, 0, MAX_MEASUREMENT_DELAY);
-      float vm = pow((measurement_delay[meas_shift_index] + 100.0) / 100.0, 2);
-      NOLESS(vm, 0.01);
-      volumetric_multiplier[FILAMENT_SENSOR_EXTRUDER_NUM] = vm;
+    ECHO_LM(DB, SERIAL_PID_AUTOTUNE_START);
+    if (temp_controller == -1) {
+      ECHO_SM(DB, "BED");
     }
-  #endif // FILAMENT_SENSOR
+    else if(temp_controller == -2) {
+      ECHO_SM(DB, "CHAMBER");
+    }
+    else if(temp_controller == -3) {
+      ECHO_SM(DB, "COOLER");
+    }
+    else {
+      ECHO_SMV(DB, "Hotend: ", temp_controller);
+    }
+    ECHO_MV(" Temp: ", temp);
+    ECHO_MV(" Cycles: ", ncycles);
+    if (set_result)
+      ECHO_EM(" Apply result");
+    else
+      ECHO_E;
 
-  #if HAS(TEMP_BED) && DISABLED(PIDTEMPBED)
-    if (ms < next_bed_check_ms) return;
-    next_bed_check_ms = ms + BED_CHECK_INTERVAL;
-  #endif
+    tune.set_result = set_result;
+    tune.cycles = 0;
+    tune.ncycles = ncycles;
+    tune.temp = temp;
+    tune.high = true;
+    tune.bias = tune.d = ht.max_power / 2;
+    tune.t1 = tune.t2 = millis();
+    tune.t_high = tune.t_low = 0;
+    tune.max = 0;
+    tune.min = 10000;
+    tune.Kp = tune.Ki = tune.Kd = 0;
+    tune.active = true;
+
+    pid_autotune_set_target(tc, temp);
+  }
 
-  #if HAS(TEMP_CHAMBER) && DISABLED(PIDTEMPCHAMBER)
-    if (ms < next_chamber_check_ms) return;
-    next_chamber_check_ms = ms + CHAMBER_CHECK_INTERVAL;
-  #endif
+  // Report the tuned constants, and apply them if asked
+  static void pid_autotune_finish(const uint8_t tc) {
+    pid_autotune_t &tune = pid_autotune[tc];
 
-  #if HAS(TEMP_COOLER) && DISABLED(PIDTEMPCOOLER)
-    if (ms < next_cooler_check_ms) return;
-    next_cooler_check_ms = ms + COOLER_CHECK_INTERVAL;
-  #endif
+    ECHO_SMV(DB, SERIAL_PID_AUTOTUNE " ", (int)heaters[tc].id);
+    ECHO_E;
+    ECHO_LM(DB, SERIAL_PID_AUTOTUNE_FINISHED);
 
-  #if HAS(TEMP_BED)
-    #if ENABLED(THERMAL_PROTECTION_BED)
-      thermal_runaway_protection(&thermal_runaway_bed_state_machine, &thermal_runaway_bed_timer, current_temperature_bed, target_temperature_bed, -1, THERMAL_PROTECTION_BED_PERIOD, THERMAL_PROTECTION_BED_HYSTERESIS);
+    #if ENABLED(PIDTEMP)
+      if (tc < HOTENDS) {
+        ECHO_SMV(DB, SERIAL_KP, tune.Kp);
+        ECHO_MV(SERIAL_KI, tune.Ki);
+        ECHO_EMV(SERIAL_KD, tune.Kd);
+        if (tune.set_result) {
+          PID_PARAM(Kp, tc) = tune.Kp;
+          PID_PARAM(Ki, tc) = scalePID_i(tune.Ki);
+          PID_PARAM(Kd, tc) = scalePID_d(tune.Kd);
+        }
+      }
     #endif
 
     #if ENABLED(PIDTEMPBED)
-      float pid_output = get_pid_output_bed();
-
-      soft_pwm_bed = current_temperature_bed > BED_MINTEMP && current_temperature_bed < BED_MAXTEMP ? (int)pid_output >> 1 : 0;
-
-    #elif ENABLED(BED_LIMIT_SWITCHING)
-      // Check if temperature is within the correct band
-      if (current_temperature_bed > BED_MINTEMP && current_temperature_bed < BED_MAXTEMP) {
-        if (current_temperature_bed >= target_temperature_bed + BED_HYSTERESIS)
-          soft_pwm_bed = 0;
-        else if (current_temperature_bed <= target_temperature_bed - BED_HYSTERESIS)
-          soft_pwm_bed = MAX_BED_POWER >> 1;
-      }
-      else {
-        soft_pwm_bed = 0;
-        WRITE_HEATER_BED(LOW);
-      }
-    #else // !PIDTEMPBED && !BED_LIMIT_SWITCHING
-      // Check if temperature is within the correct range
-      if (current_temperature_bed > BED_MINTEMP && current_temperature_bed < BED_MAXTEMP) {
-        soft_pwm_bed = current_temperature_bed < target_temperature_bed ? MAX_BED_POWER >> 1 : 0;
+      if (tc == BED_INDEX) {
+        ECHO_LMV(DB, "#define DEFAULT_bedKp ", tune.Kp);
+        ECHO_LMV(DB, "#define DEFAULT_bedKi ", tune.Ki);
+        ECHO_LMV(DB, "#define DEFAULT_bedKd ", tune.Kd);
+        if (tune.set_result) {
+          bedKp = tune.Kp;
+          bedKi = scalePID_i(tune.Ki);
+          bedKd = scalePID_d(tune.Kd);
+        }
       }
-      else {
-        soft_pwm_bed = 0;
-        WRITE_HEATER_BED(LOW);
+    #endif
+
+    #if ENABLED(PIDTEMPCHAMBER)
+      if (tc == CHAMBER_INDEX) {
+        ECHO_LMV(DB, "#define DEFAULT_chamberKp ", tune.Kp);
+        ECHO_LMV(DB, "#define DEFAULT_chamberKi ", tune.Ki);
+        ECHO_LMV(DB, "#define DEFAULT_chamberKd ", tune.Kd);
+        if (tune.set_result) {
+          chamberKp = tune.Kp;
+          chamberKi = scalePID_i(tune.Ki);
+          chamberKd = scalePID_d(tune.Kd);
+        }
       }
     #endif
-  #endif // HAS(TEMP_BED)
 
-  #if HAS(TEMP_CHAMBER)
-    #if ENABLED(THERMAL_PROTECTION_CHAMBER)
-      thermal_runaway_protection(&thermal_runaway_chamber_state_machine, &thermal_runaway_chamber_timer, current_temperature_chamber, target_temperature_chamber, -1, THERMAL_PROTECTION_CHAMBER_PERIOD, THERMAL_PROTECTION_CHAMBER_HYSTERESIS);
+    #if ENABLED(PIDTEMPCOOLER)
+      if (tc == COOLER_INDEX) {
+        ECHO_LMV(DB, "#define DEFAULT_coolerKp ", tune.Kp);
+        ECHO_LMV(DB, "#define DEFAULT_coolerKi ", tune.Ki);
+        ECHO_LMV(DB, "#define DEFAULT_coolerKd ", tune.Kd);
+        if (tune.set_result) {
+          coolerKp = tune.Kp;
+          coolerKi = scalePID_i(tune.Ki);
+          coolerKd = scalePID_d(tune.Kd);
+        }
+      }
     #endif
 
-    #if ENABLED(PIDTEMPCHAMBER)
-      float pid_output = get_pid_output_chamber();
+    if (tune.set_result) updatePID();
+  }
+
+  /**
+   * One step of the relay autotune, at each temperature reading.
+   * The output swings between bias + d and bias - d each time the
+   * temperature passes the setpoint. The bias is moved to make the
+   * high and low times even, then the amplitude and the period of the
+   * oscillation give the classic Ziegler-Nichols constants.
+   * Return the output of the controller.
+   */
+  static int pid_autotune_output(const uint8_t tc) {
+    heater_t &ht = heaters[tc];
+    pid_autotune_t &tune = pid_autotune[tc];
+    const float input = *ht.current;
+    const millis_t ms = millis();
+
+    // Stopped by a new target
+    if (*ht.target != tune.temp) {
+      tune.active = false;
+      ECHO_SMV(DB, SERIAL_PID_AUTOTUNE " ", (int)ht.id);
+      ECHO_EM(SERIAL_PID_AUTOTUNE_STOPPED);
+      return 0;
+    }
 
-      soft_pwm_chamber = current_temperature_chamber > CHAMBER_MINTEMP && current_temperature_chamber < CHAMBER_MAXTEMP ? (int)pid_output >> 1 : 0;
+    NOLESS(tune.max, input);
+    NOMORE(tune.min, input);
 
-    #elif ENABLED(CHAMBER_LIMIT_SWITCHING)
-      // Check if temperature is within the correct band
-      if (current_temperature_chamber > CHAMBER_MINTEMP && current_temperature_chamber < CHAMBER_MAXTEMP) {
-        if (current_temperature_chamber >= target_temperature_chamber + CHAMBER_HYSTERESIS)
-          soft_pwm_chamber = 0;
-        else if (current_temperature_chamber <= target_temperature_chamber - CHAMBER_HYSTERESIS)
-          soft_pwm_chamber = MAX_CHAMBER_POWER >> 1;
-      }
-      else {
-        soft_pwm_chamber = 0;
-        WRITE_HEATER_CHAMBER(LOW);
-      }
-    #else // !PIDTEMPCHAMBER && !CHAMBER_LIMIT_SWITCHING
-      // Check if temperature is within the correct range
-      if (current_temperature_chamber > CHAMBER_MINTEMP && current_temperature_chamber < CHAMBER_MAXTEMP) {
-        soft_pwm_chamber = current_temperature_chamber < target_temperature_chamber ? MAX_CHAMBER_POWER >> 1 : 0;
+    // The cooler works the other way around
+    const bool past = ht.cooling ? input < tune.temp : input > tune.temp;
+
+    if (tune.high && past) {
+      if (ELAPSED(ms, tune.t2 + 5000UL)) {
+        tune.high = false;
+        tune.t1 = ms;
+        tune.t_high = tune.t1 - tune.t2;
+        if (ht.cooling) tune.min = tune.temp; else tune.max = tune.temp;
       }
-      else {
-        soft_pwm_chamber = 0;
-        WRITE_HEATER_CHAMBER(LOW);
+    }
+    else if (!tune.high && !past) {
+      if (ELAPSED(ms, tune.t1 + 5000UL)) {
+        tune.high = true;
+        tune.t2 = ms;
+        tune.t_low = tune.t2 - tune.t1;
+        if (tune.cycles > 0) {
+          tune.bias += (tune.d * (tune.t_high - tune.t_low)) / (tune.t_low + tune.t_high);
+          tune.bias = constrain(tune.bias, 20, ht.max_power - 20);
+          tune.d = (tune.bias > ht.max_power / 2) ? ht.max_power - 1 - tune.bias : tune.bias;
+
+          ECHO_SMV(DB, SERIAL_PID_AUTOTUNE " ", (int)ht.id);
+          ECHO_MV(SERIAL_PID_CYCLE, (int)tune.cycles);
+          ECHO_MV("/", (int)tune.ncycles);
+          ECHO_MV(SERIAL_BIAS, tune.bias);
+          ECHO_MV(SERIAL_D, tune.d);
+          ECHO_MV(SERIAL_T_MIN, tune.min);
+          ECHO_MV(SERIAL_T_MAX, tune.max);
+          if (tune.cycles > 2) {
+            const float Ku = (4.0 * tune.d) / (3.14159265 * (tune.max - tune.min) / 2.0),
+                        Tu = ((float)(tune.t_low + tune.t_high) / 1000.0);
+            ECHO_MV(SERIAL_KU, Ku);
+            ECHO_EMV(SERIAL_TU, Tu);
+            tune.Kp = 0.6 * Ku;
+            tune.Ki = 2 * tune.Kp / Tu;
+            tune.Kd = tune.Kp * Tu / 8;
+
+            ECHO_SM(DB, SERIAL_CLASSIC_PID);
+            ECHO_MV(SERIAL_KP, tune.Kp);
+            ECHO_MV(SERIAL_KI, tune.Ki);
+            ECHO_EMV(SERIAL_KD, tune.Kd);
+          }
+          else {
+            ECHO_E;
+          }
+
+          char msg[30];
+          sprintf_P(msg, PSTR(SERIAL_PID_AUTOTUNE " %i: %i/%i"), (int)ht.id, (int)tune.cycles, (int)tune.ncycles);
+          lcd_setstatus(msg);
+        }
+
+        tune.cycles++;
+        if (ht.cooling) tune.max = tune.temp; else tune.min = tune.temp;
       }
-    #endif
-  #endif // HAS(TEMP_CHAMBER)
+    }
 
-  #if HAS(TEMP_COOLER)
-    #if ENABLED(THERMAL_PROTECTION_COOLER)
-      thermal_runaway_protection(&thermal_runaway_cooler_state_machine, &thermal_runaway_cooler_timer, current_temperature_cooler, target_temperature_cooler, -2, THERMAL_PROTECTION_COOLER_PERIOD, THERMAL_PROTECTION_COOLER_HYSTERESIS);
-    #endif
+    if (ht.cooling ? input < tune.temp - (MAX_OVERSHOOT_PID_AUTOTUNE) : input > tune.temp + (MAX_OVERSHOOT_PID_AUTOTUNE)) {
+      if (ht.cooling)
+        ECHO_LM(ER, SERIAL_PID_TEMP_TOO_LOW);
+      else
+        ECHO_LM(ER, SERIAL_PID_TEMP_TOO_HIGH);
+      tune.active = false;
+    }
+    // Over 20 minutes?
+    else if (((ms - tune.t1) + (ms - tune.t2)) > (10L*60L*1000L*2L)) {
+      ECHO_LM(ER, SERIAL_PID_TIMEOUT);
+      tune.active = false;
+    }
+    else if (tune.cycles > tune.ncycles) {
+      pid_autotune_finish(tc);
+      tune.active = false;
+    }
 
-    #if ENABLED(PIDTEMPCOOLER)
-      float pid_output = get_pid_output_cooler();
+    if (!tune.active) {
+      pid_autotune_set_target(tc, 0);
+      return 0;
+    }
 
-      setPwmCooler(current_temperature_cooler > COOLER_MINTEMP && current_temperature_cooler < COOLER_MAXTEMP ? (int)pid_output : 0);
+    return tune.high ? tune.bias + tune.d : tune.bias - tune.d;
+  }
 
-    #elif ENABLED(COOLER_LIMIT_SWITCHING)
-      // Check if temperature is within the correct band
-      if (current_temperature_cooler > COOLER_MINTEMP && current_temperature_cooler < COOLER_MAXTEMP) {
-        if (current_temperature_cooler >= target_temperature_cooler + COOLER_HYSTERESIS)
-          setPwmCooler(MAX_COOLER_POWER);
-        else if (current_temperature_cooler <= target_temperature_cooler - COOLER_HYSTERESIS)
-          setPwmCooler(0);
-      }
-      else { 
-        setPwmCooler(0);
-        WRITE_COOLER(LOW);
-      }
-    #else // COOLER_LIMIT_SWITCHING
-      // Check if temperature is within the correct range
-      if (current_temperature_cooler > COOLER_MINTEMP && current_temperature_cooler < COOLER_MAXTEMP) {
-        setPwmCooler(current_temperature_cooler > target_temperature_cooler ? MAX_COOLER_POWER  : 0);
-      }
-      else {
-        setPwmCooler(0);
-        WRITE_COOLER(LOW);
-      }
+#endif
+
+#if ENABLED(MPCTEMP)
+
+  #define MPC_AUTOTUNE_PHASE_MS (10UL * 60UL * 1000UL)  // Time limit of cooling and heating
+  #define MPC_AUTOTUNE_HOLD_MS  60000UL                 // Settle, then measure, for as long
+
+  // Set the target of the tuned hotend and restart its heating watch
+  static void mpc_autotune_set_target(const int temp) {
+    mpc_tune.target = temp;
+    target_temperature[mpc_tune.h] = temp;
+    #if HAS(THERMAL_PROTECTION)
+      start_watching(mpc_tune.h);
     #endif
-  #endif // HAS(TEMP_COOLER)
-}
+  }
 
-#define PGM_RD_W(x)   (short)pgm_read_word(&x)
-// Derived from RepRap FiveD extruder::getTemperature()
-// For hot end temperature measurement.
-static float analog2temp(int raw, uint8_t e) {
-  #if ENABLED(TEMP_SENSOR_1_AS_REDUNDANT)
-    if (e > HOTENDS)
-  #else
-    if (e >= HOTENDS)
-  #endif
-    {
-      ECHO_LVM(ER, (int)e, SERIAL_INVALID_EXTRUDER_NUM);
-      kill(PSTR(MSG_KILLED));
-      return 0.0;
-    }
+  // End the tuning, the hotend goes off unless a new target stopped it
+  static void mpc_autotune_stop(const bool keep_target = false) {
+    mpc_tune.phase = MPCTuneOff;
+    mpc_model[mpc_tune.h].ready = false;
+    fanSpeed = mpc_tune.old_fan_speed;
+    if (!keep_target) mpc_autotune_set_target(0);
+  }
 
-  #if ENABLED(HEATER_0_USES_MAX6675)
-    if (e == 0) return 0.25 * raw;
-  #endif
+  /**
+   * Fit the exponential heating curve, through three equally spaced
+   * samples, to the asymptote. This gives the heat capacity of the
+   * block and the responsiveness of the sensor.
+   */
+  static void mpc_autotune_fit(const float asymp_temp) {
+    mpc_settings_t &mpc = mpc_settings[mpc_tune.h];
+    const uint8_t n = mpc_tune.sample_count;
+    const float t1 = mpc_tune.temp_samples[0],
+                t2 = mpc_tune.temp_samples[n >> 1],
+                interval = mpc_tune.sample_distance * (n >> 1),
+                block_responsiveness = -log((t2 - asymp_temp) / (t1 - asymp_temp)) / interval;
+
+    mpc.block_heat_capacity = mpc.ambient_xfer_coeff_fan0 / block_responsiveness;
+    mpc.sensor_responsiveness = block_responsiveness / (1.0 - (mpc_tune.ambient_temp - asymp_temp) * exp(-block_responsiveness * mpc_tune.t1_time) / (t1 - asymp_temp));
+  }
 
-  if (heater_ttbl_map[e] != NULL) {
-    float celsius = 0;
-    uint8_t i;
-    short(*tt)[][2] = (short(*)[][2])(heater_ttbl_map[e]);
+  /**
+   * End of the heating: fit the curve and start holding
+   * MPC_AUTOTUNE_TEMP with the model. False if the curve is not usable.
+   */
+  static bool mpc_autotune_heated(const millis_t ms) {
+    mpc_settings_t &mpc = mpc_settings[mpc_tune.h];
+
+    if (mpc_tune.sample_count < 3) return false;
+    // Odd count, for the middle sample
+    if (!(mpc_tune.sample_count & 1)) mpc_tune.sample_count--;
+    const uint8_t n = mpc_tune.sample_count;
+    const float t1 = mpc_tune.temp_samples[0],
+                t2 = mpc_tune.temp_samples[n >> 1],
+                t3 = mpc_tune.temp_samples[n - 1];
+    if (2 * t2 - t1 - t3 <= 0) return false;
+
+    const float asymp_temp = (t2 * t2 - t1 * t3) / (2 * t2 - t1 - t3);
+    mpc.ambient_xfer_coeff_fan0 = mpc_tune.heat_power / (asymp_temp - mpc_tune.ambient_temp);
+    mpc.fan255_adjustment = 0.0;
+    mpc_autotune_fit(asymp_temp);
+
+    // Run the model from the measured ambient
+    mpc_model_t &model = mpc_model[mpc_tune.h];
+    model.block_temp = model.sensor_temp = *heaters[mpc_tune.h].current;
+    model.ambient_temp = mpc_tune.ambient_temp;
+    model.ready = true;
+
+    ECHO_LM(DB, SERIAL_MPC_MEASURING);
+    mpc_tune.phase = MPCTuneHold;
+    mpc_tune.total_power = mpc_tune.total_temp = 0.0;
+    mpc_tune.count = 0;
+    mpc_tune.measure_ms = ms + MPC_AUTOTUNE_HOLD_MS;
+    mpc_tune.deadline = mpc_tune.measure_ms + MPC_AUTOTUNE_HOLD_MS;
+    return true;
+  }
 
-    for (i = 1; i < heater_ttbllen_map[e]; i++) {
-      if (PGM_RD_W((*tt)[i][0]) > raw) {
-        celsius = PGM_RD_W((*tt)[i - 1][1]) +
-                  (raw - PGM_RD_W((*tt)[i - 1][0])) *
-                  (float)(PGM_RD_W((*tt)[i][1]) - PGM_RD_W((*tt)[i - 1][1])) /
-                  (float)(PGM_RD_W((*tt)[i][0]) - PGM_RD_W((*tt)[i - 1][0]));
-        break;
-      }
+  // Report the measured model, M500 saves it
+  static void mpc_autotune_finish() {
+    const mpc_settings_t &mpc = mpc_settings[mpc_tune.h];
+    ECHO_LM(DB, SERIAL_MPC_AUTOTUNE_FINISHED);
+    ECHO_SMV(DB, "  M307 H", (int)mpc_tune.h);
+    ECHO_MV(" P", mpc.heater_power);
+    ECHO_MV(" C", mpc.block_heat_capacity);
+    ECHO_MV(" R", mpc.sensor_responsiveness, 4);
+    ECHO_MV(" A", mpc.ambient_xfer_coeff_fan0, 4);
+    ECHO_EMV(" F", mpc.ambient_xfer_coeff_fan0 + mpc.fan255_adjustment, 4);
+  }
+
+  /**
+   * Measure the model of a hotend (M307 T)
+   *
+   *  - Cool to the ambient temperature with the fan on.
+   *  - Heat at full power to MPC_AUTOTUNE_TEMP, sampling the temperature.
+   *    Three equally spaced samples fit the exponential heating curve,
+   *    which gives the heat capacity and the sensor responsiveness.
+   *  - Hold the temperature with the model and measure the power lost
+   *    to the ambient, with the fan off and at full speed.
+   *    Then fit the curve again with the measured loss.
+   *
+   * The tuning runs in the background like M303, advanced by
+   * manage_temp_controller with the thermal protection on. A new
+   * target (M104 etc.) stops it. The results are applied, M500 saves them.
+   */
+  void MPC_autotune(const uint8_t h) {
+    if (mpc_tune.phase != MPCTuneOff) {
+      ECHO_SMV(DB, SERIAL_MPC_AUTOTUNE " ", (int)mpc_tune.h);
+      ECHO_EM(SERIAL_PID_AUTOTUNE_STOPPED);
+      mpc_autotune_stop();
     }
 
-    // Overflow: Set to last value in the table
-    if (i == heater_ttbllen_map[e]) celsius = PGM_RD_W((*tt)[i - 1][1]);
+    ECHO_LMV(DB, SERIAL_MPC_AUTOTUNE_START, (int)h);
+
+    disable_all_heaters(); // switch off all heaters.
 
-    return celsius;
+    // Cool down until the temperature stops falling
+    ECHO_LM(DB, SERIAL_MPC_COOLING);
+    mpc_tune.h = h;
+    mpc_tune.old_fan_speed = fanSpeed;
+    fanSpeed = 255;
+    mpc_tune.last_temp = current_temperature[h];
+    mpc_tune.deadline = millis() + MPC_AUTOTUNE_PHASE_MS;
+    mpc_tune.next_test_ms = millis() + 10000UL;
+    mpc_tune.phase = MPCTuneCooling;
+    mpc_autotune_set_target(0);
   }
 
-  #if HEATER_USES_AD595
-    #ifdef __SAM3X8E__
-      return ((raw * ((3.3 * 100.0) / 1024.0) / OVERSAMPLENR) * ad595_gain[e]) + ad595_offset[e];
-    #else
-      return ((raw * ((5.0 * 100.0) / 1024.0) / OVERSAMPLENR) * ad595_gain[e]) + ad595_offset[e];
-    #endif
-  #else
-    return 0;
-  #endif
-}
+  /**
+   * One step of the model measure, at each temperature reading.
+   * Return the output of the hotend.
+   */
+  static int mpc_autotune_output(const uint8_t h) {
+    heater_t &ht = heaters[h];
+    mpc_settings_t &mpc = mpc_settings[h];
+    const float temp = *ht.current;
+    const millis_t ms = millis();
+
+    // Stopped by a new target
+    if (*ht.target != mpc_tune.target) {
+      ECHO_SMV(DB, SERIAL_MPC_AUTOTUNE " ", (int)h);
+      ECHO_EM(SERIAL_PID_AUTOTUNE_STOPPED);
+      mpc_autotune_stop(true);
+      return 0;
+    }
 
-// Derived from RepRap FiveD extruder::getTemperature()
-// For bed temperature measurement.
-static float analog2tempBed(int raw) {
-  #if ENABLED(BED_USES_THERMISTOR)
-    float celsius = 0;
-    byte i;
-
-    for (i = 1; i < BEDTEMPTABLE_LEN; i++) {
-      if (PGM_RD_W(BEDTEMPTABLE[i][0]) > raw) {
-        celsius  = PGM_RD_W(BEDTEMPTABLE[i - 1][1]) +
-                   (raw - PGM_RD_W(BEDTEMPTABLE[i - 1][0])) *
-                   (float)(PGM_RD_W(BEDTEMPTABLE[i][1]) - PGM_RD_W(BEDTEMPTABLE[i - 1][1])) /
-                   (float)(PGM_RD_W(BEDTEMPTABLE[i][0]) - PGM_RD_W(BEDTEMPTABLE[i - 1][0]));
-        break;
-      }
+    if (temp > MPC_AUTOTUNE_TEMP + MAX_OVERSHOOT_PID_AUTOTUNE) {
+      ECHO_LM(ER, SERIAL_MPC_TEMP_TOO_HIGH);
+      mpc_autotune_stop();
+      return 0;
     }
 
-    // Overflow: Set to last value in the table
-    if (i == BEDTEMPTABLE_LEN) celsius = PGM_RD_W(BEDTEMPTABLE[i - 1][1]);
+    if (ELAPSED(ms, mpc_tune.deadline) && mpc_tune.phase <= MPCTuneHeating) {
+      ECHO_LM(ER, SERIAL_MPC_TIMEOUT);
+      mpc_autotune_stop();
+      return 0;
+    }
 
-    return celsius;
+    switch (mpc_tune.phase) {
+      case MPCTuneCooling:
+        if (PENDING(ms, mpc_tune.next_test_ms)) return 0;
+        if (temp < mpc_tune.last_temp - 0.1) {
+          mpc_tune.last_temp = temp;
+          mpc_tune.next_test_ms += 10000UL;
+          return 0;
+        }
 
-  #elif ENABLED(BED_USES_AD595)
-    #ifdef __SAM3X8E__
-      return ((raw * ((3.3 * 100.0) / 1024.0) / OVERSAMPLENR) * TEMP_SENSOR_AD595_GAIN) + TEMP_SENSOR_AD595_OFFSET;
-    #else
-      return ((raw * ((5.0 * 100.0) / 1024.0) / OVERSAMPLENR) * TEMP_SENSOR_AD595_GAIN) + TEMP_SENSOR_AD595_OFFSET;
-    #endif
-  #else
-    UNUSED(raw);
-    return 0;
+        // Heat at full power. Sample from half way to the end,
+        // spacing the samples wider when the buffer is full.
+        fanSpeed = 0;
+        mpc_tune.ambient_temp = temp;
+        mpc_tune.heat_power = mpc.heater_power * ht.max_power / 255.0;
+        mpc_tune.sample_count = 0;
+        mpc_tune.sample_distance = 1; // seconds
+        mpc_tune.t1_time = 0.0;
+        mpc_tune.heat_start_ms = mpc_tune.next_test_ms = ms;
+        mpc_tune.deadline = ms + MPC_AUTOTUNE_PHASE_MS;
+        mpc_tune.phase = MPCTuneHeating;
+        ECHO_LMV(DB, SERIAL_MPC_HEATING, MPC_AUTOTUNE_TEMP);
+        mpc_autotune_set_target(MPC_AUTOTUNE_TEMP);
+        return ht.max_power;
+
+      case MPCTuneHeating:
+        if (PENDING(ms, mpc_tune.next_test_ms)) return ht.max_power;
+        if (temp >= (mpc_tune.ambient_temp + MPC_AUTOTUNE_TEMP) / 2) {
+          if (mpc_tune.sample_count == COUNT(mpc_tune.temp_samples)) {
+            for (uint8_t i = 0; i < COUNT(mpc_tune.temp_samples) / 2; i++) mpc_tune.temp_samples[i] = mpc_tune.temp_samples[i * 2];
+            mpc_tune.sample_count /= 2;
+            mpc_tune.sample_distance *= 2;
+          }
+          if (mpc_tune.sample_count == 0) mpc_tune.t1_time = (ms - mpc_tune.heat_start_ms) / 1000.0;
+          mpc_tune.temp_samples[mpc_tune.sample_count++] = temp;
+        }
+        mpc_tune.next_test_ms += 1000UL * mpc_tune.sample_distance;
+        if (temp < MPC_AUTOTUNE_TEMP) return ht.max_power;
+        if (!mpc_autotune_heated(ms)) {
+          ECHO_LM(ER, SERIAL_MPC_BAD_CURVE);
+          mpc_autotune_stop();
+          return 0;
+        }
+        return get_mpc_output(h);
+
+      case MPCTuneHold:
+      case MPCTuneHoldFan: {
+        const int output = get_mpc_output(h);
+        if (PENDING(ms, mpc_tune.deadline)) {
+          if (ELAPSED(ms, mpc_tune.measure_ms)) {
+            mpc_tune.total_power += output * mpc.heater_power / 255.0;
+            mpc_tune.total_temp += temp;
+            mpc_tune.count++;
+          }
+          return output;
+        }
 
-  #endif
-}
+        // Power lost per degree above the ambient
+        const float coeff = mpc_tune.count ? mpc_tune.total_power / (mpc_tune.total_temp - mpc_tune.ambient_temp * mpc_tune.count) : 0.0;
+        if (coeff <= 0) {
+          ECHO_LM(ER, SERIAL_MPC_BAD_CURVE);
+          mpc_autotune_stop();
+          return 0;
+        }
+
+        if (mpc_tune.phase == MPCTuneHold) {
+          mpc.ambient_xfer_coeff_fan0 = coeff;
+          #if HAS(FAN)
+            ECHO_LM(DB, SERIAL_MPC_MEASURING_FAN);
+            fanSpeed = 255;
+            mpc_tune.phase = MPCTuneHoldFan;
+            mpc_tune.total_power = mpc_tune.total_temp = 0.0;
+            mpc_tune.count = 0;
+            mpc_tune.measure_ms = ms + MPC_AUTOTUNE_HOLD_MS;
+            mpc_tune.deadline = mpc_tune.measure_ms + MPC_AUTOTUNE_HOLD_MS;
+            return output;
+          #endif
+        }
+        else
+          mpc.fan255_adjustment = coeff - mpc.ambient_xfer_coeff_fan0;
+
+        // The asymptote from the measured loss is more accurate than the fit
+        const float asymp_temp = mpc_tune.ambient_temp + mpc_tune.heat_power / mpc.ambient_xfer_coeff_fan0;
+        if (asymp_temp > mpc_tune.temp_samples[mpc_tune.sample_count - 1]) mpc_autotune_fit(asymp_temp);
 
-static float analog2tempChamber(int raw) { 
-  #if ENABLED(CHAMBER_USES_THERMISTOR)
-    float celsius = 0;
-    byte i;
-
-    for (i = 1; i < CHAMBERTEMPTABLE_LEN; i++) {
-      if (PGM_RD_W(CHAMBERTEMPTABLE[i][0]) > raw) {
-        celsius  = PGM_RD_W(CHAMBERTEMPTABLE[i - 1][1]) +
-                   (raw - PGM_RD_W(CHAMBERTEMPTABLE[i - 1][0])) *
-                   (float)(PGM_RD_W(CHAMBERTEMPTABLE[i][1]) - PGM_RD_W(CHAMBERTEMPTABLE[i - 1][1])) /
-                   (float)(PGM_RD_W(CHAMBERTEMPTABLE[i][0]) - PGM_RD_W(CHAMBERTEMPTABLE[i - 1][0]));
-        break;
+        mpc_autotune_finish();
+        mpc_autotune_stop();
+        return 0;
       }
+
+      default: break;
     }
+    return 0;
+  }
 
-    // Overflow: Set to last value in the table
-    if (i == CHAMBERTEMPTABLE_LEN) celsius = PGM_RD_W(CHAMBERTEMPTABLE[i - 1][1]);
+#endif // MPCTEMP
 
-    return celsius;
+/**
+ * Manage heating activities for hotends, bed, chamber and cooler
+ *  - Acquire updated temperature readings
+ *  - Invoke thermal runaway protection and the heating watch
+ *  - Update the output of every controller
+ *  - Manage extruder auto-fan
+ *  - Apply filament width to the extrusion rate (may move)
+ */
+void manage_temp_controller() {
 
-  #elif ENABLED(CHAMBER_USES_AD595)
-    #ifdef __SAM3X8E__
-      return ((raw * ((3.3 * 100.0) / 1024.0) / OVERSAMPLENR) * TEMP_SENSOR_AD595_GAIN) + TEMP_SENSOR_AD595_OFFSET;
-    #else
-      return ((raw * ((5.0 * 100.0) / 1024.0) / OVERSAMPLENR) * TEMP_SENSOR_AD595_GAIN) + TEMP_SENSOR_AD595_OFFSET;
-    #endif
-  #else
-    UNUSED(raw);
-    return 0;
+  if (!temp_meas_ready) return;
+
+  updateTemperaturesFromRawValues();
+
+  #if ENABLED(HEATER_0_USES_MAX6675)
+    float ct = current_temperature[0];
+    if (ct > min(HEATER_0_MAXTEMP, 1023)) max_temp_error(0);
+    if (ct < max(HEATER_0_MINTEMP, 0.01)) min_temp_error(0);
   #endif
-}
 
-static float analog2tempCooler(int raw) { 
-  #if ENABLED(COOLER_USES_THERMISTOR)
-    float celsius = 0;
-    byte i;
-
-    for (i = 1; i < COOLERTEMPTABLE_LEN; i++) {
-      if (PGM_RD_W(COOLERTEMPTABLE[i][0]) > raw) {
-        celsius  = PGM_RD_W(COOLERTEMPTABLE[i - 1][1]) +
-                   (raw - PGM_RD_W(COOLERTEMPTABLE[i - 1][0])) *
-                   (float)(PGM_RD_W(COOLERTEMPTABLE[i][1]) - PGM_RD_W(COOLERTEMPTABLE[i - 1][1])) /
-                   (float)(PGM_RD_W(COOLERTEMPTABLE[i][0]) - PGM_RD_W(COOLERTEMPTABLE[i - 1][0]));
-        break;
+  millis_t ms = millis();
+
+  // Loop through all the controllers
+  for (uint8_t tc = 0; tc < HEATER_COUNT; tc++) {
+    heater_t &ht = heaters[tc];
+    if (ht.sensor == SENSOR_NONE) continue;
+
+    #if HAS(THERMAL_PROTECTION)
+      if (ht.protect) {
+        thermal_runaway_protection(tc);
+
+        // Is it time to check if the temperature is failing to move?
+        if (ht.watch_next_ms && ELAPSED(ms, ht.watch_next_ms)) {
+          if (ht.cooling ? *ht.current > ht.watch_target : *ht.current < ht.watch_target)
+            _temp_error(ht.id, PSTR(SERIAL_T_HEATING_FAILED), PSTR(MSG_HEATING_FAILED_LCD));
+          else
+            start_watching(tc); // Start again if the target is still far off
+        }
       }
+    #endif
+
+    // Bang-bang controllers are only updated every check interval
+    if (ht.check_interval) {
+      if (PENDING(ms, ht.next_check_ms)) continue;
+      ht.next_check_ms = ms + ht.check_interval;
     }
 
-    // Overflow: Set to last value in the table
-    if (i == COOLERTEMPTABLE_LEN) celsius = PGM_RD_W(COOLERTEMPTABLE[i - 1][1]);
+    // Check if temperature is within the correct range
+    const float temp = *ht.current;
+    set_heater_output(tc, temp > ht.mintemp && temp < ht.maxtemp ? get_heater_output(tc) : 0);
+  }
 
-    return celsius;
+  #if ENABLED(TEMP_SENSOR_1_AS_REDUNDANT)
+    if (fabs(current_temperature[0] - redundant_temperature) > MAX_REDUNDANT_TEMP_SENSOR_DIFF) {
+      _temp_error(0, PSTR(SERIAL_REDUNDANCY), PSTR(MSG_ERR_REDUNDANT_TEMP));
+    }
+  #endif
 
-  #elif ENABLED(COOLER_USES_AD595)
-    #ifdef __SAM3X8E__
-      return ((raw * ((3.3 * 100.0) / 1024.0) / OVERSAMPLENR) * TEMP_SENSOR_AD595_GAIN) + TEMP_SENSOR_AD595_OFFSET;
-    #else
-      return ((raw * ((5.0 * 100.0) / 1024.0) / OVERSAMPLENR) * TEMP_SENSOR_AD595_GAIN) + TEMP_SENSOR_AD595_OFFSET;
-    #endif
-  #else
-    UNUSED(raw);
-    return 0;
+  #if HAS(AUTO_FAN)
+    if (ms > next_auto_fan_check_ms) { // only need to check fan state very infrequently
+      checkExtruderAutoFans();
+      next_auto_fan_check_ms = ms + 2500;
+    }
   #endif
+
+  // Control the extruder rate based on the width sensor
+  #if ENABLED(FILAMENT_SENSOR)
+    if (filament_sensor) {
+      meas_shift_index = filwidth_delay_index1 - meas_delay_cm;
+      if (meas_shift_index < 0) meas_shift_index += MAX_MEASUREMENT_DELAY + 1;  // loop around buffer if needed
+
+      // Get the delayed info and add 100 to reconstitute to a percent of
+      // the nominal filament diameter then square it to get an area
+      meas_shift_index = constrain(meas_shift_index, 0, MAX_MEASUREMENT_DELAY);
+      float vm = pow((measurement_delay[meas_shift_index] + 100.0) / 100.0, 2);
+      NOLESS(vm, 0.01);
+      volumetric_multiplier[FILAMENT_SENSOR_EXTRUDER_NUM] = vm;
+    }
+  #endif // FILAMENT_SENSOR
+}
+
+#define PGM_RD_W(x)   (short)pgm_read_word(&x)
+// Derived from RepRap FiveD extruder::getTemperature()
+// Interpolate a thermistor table
+static float analog2temp_table(const int raw, const short (*tt)[2], const uint8_t len) {
+  float celsius = 0;
+  uint8_t i;
+
+  for (i = 1; i < len; i++) {
+    if (PGM_RD_W(tt[i][0]) > raw) {
+      celsius = PGM_RD_W(tt[i - 1][1]) +
+                (raw - PGM_RD_W(tt[i - 1][0])) *
+                (float)(PGM_RD_W(tt[i][1]) - PGM_RD_W(tt[i - 1][1])) /
+                (float)(PGM_RD_W(tt[i][0]) - PGM_RD_W(tt[i - 1][0]));
+      break;
+    }
+  }
+
+  // Overflow: Set to last value in the table
+  if (i == len) celsius = PGM_RD_W(tt[i - 1][1]);
+
+  return celsius;
 }
 
+// Temperature of a controller from its raw ADC sum
+static float analog2temp(const int raw, const uint8_t tc) {
+  const heater_t &ht = heaters[tc];
+
+  switch (ht.sensor) {
+    case SENSOR_THERMISTOR:
+      return analog2temp_table(raw, ht.table, ht.table_len);
+    case SENSOR_AD595: {
+      #if HEATER_USES_AD595
+        if (tc < HOTENDS)
+          return ((raw * ((AD595_VREF * 100.0) / 1024.0) / OVERSAMPLENR) * ad595_gain[tc]) + ad595_offset[tc];
+      #endif
+      return ((raw * ((AD595_VREF * 100.0) / 1024.0) / OVERSAMPLENR) * TEMP_SENSOR_AD595_GAIN) + TEMP_SENSOR_AD595_OFFSET;
+    }
+    case SENSOR_MAX6675:
+      return 0.25 * raw;
+  }
+  return 0;
+}
 
 /* Called to get the raw values into the the actual temperatures. The raw values are created in interrupt context,
     and this function is called from normal context as it is too slow to run in interrupts and will block the stepper routine otherwise */
@@ -1309,17 +1516,13 @@ static void updateTemperaturesFromRawValues() {
     current_temperature_raw[0] = read_max6675();
   #endif
 
-  for (uint8_t e = 0; e < HOTENDS; e++)
-    current_temperature[e] = analog2temp(current_temperature_raw[e], e);
-
-  current_temperature_bed = analog2tempBed(current_temperature_bed_raw);
-
-  current_temperature_chamber = analog2tempChamber(current_temperature_chamber_raw);
-
-  current_temperature_cooler = analog2tempCooler(current_temperature_cooler_raw);
+  for (uint8_t tc = 0; tc < HEATER_COUNT; tc++) {
+    heater_t &ht = heaters[tc];
+    if (ht.sensor != SENSOR_NONE) *ht.current = analog2temp(*ht.raw, tc);
+  }
 
   #if ENABLED(TEMP_SENSOR_1_AS_REDUNDANT)
-    redundant_temperature = analog2temp(redundant_temperature_raw, 1);
+    redundant_temperature = analog2temp_table(redundant_temperature_raw, HEATER_1_TEMPTABLE, HEATER_1_TEMPTABLE_LEN);
   #endif
   #if HAS(FILAMENT_SENSOR)
     filament_width_meas = analog2widthFil();
@@ -1391,18 +1594,171 @@ static void updateTemperaturesFromRawValues() {
     return (analog2current() * POWER_VOLTAGE * 100) /  POWER_EFFICIENCY;
   }
 
-  float analog2error(float current) {
-    float temp1 = (analog2voltage() / POWER_SENSITIVITY - POWER_OFFSET) * POWER_VOLTAGE;
-    if(temp1 <= 0) return 0.0;
-    float temp2 = (current) * POWER_VOLTAGE;
-    if(temp2 <= 0) return 0.0;
-    return ((temp2/temp1) - 1) * 100;
-  }
+  float analog2error(float current) {
+    float temp1 = (analog2voltage() / POWER_SENSITIVITY - POWER_OFFSET) * POWER_VOLTAGE;
+    if(temp1 <= 0) return 0.0;
+    float temp2 = (current) * POWER_VOLTAGE;
+    if(temp2 <= 0) return 0.0;
+    return ((temp2/temp1) - 1) * 100;
+  }
+
+  float analog2efficiency(float watt) {
+    return (analog2current() * POWER_VOLTAGE * 100) / watt;
+  }
+#endif
+
+/**
+ * Describe a controller, all limits open. The working
+ * range and the thermal protection are set apart.
+ */
+static void heater_init(const uint8_t tc, const uint8_t sensor, int* target, float* current, int* raw, const short (*table)[2], const uint8_t table_len, const int raw_lo, const int raw_hi, unsigned char* soft_pwm, const int max_power) {
+  heater_t &ht = heaters[tc];
+  ht.id = tc < HOTENDS ? tc : HOTENDS - 1 - tc;
+  ht.sensor = sensor;
+  ht.target = target;
+  ht.current = current;
+  ht.raw = raw;
+  ht.table = table;
+  ht.table_len = table_len;
+  ht.raw_rising = raw_lo < raw_hi;
+  ht.minttemp_raw = raw_lo;
+  ht.maxttemp_raw = raw_hi;
+  ht.mintemp = 0;
+  ht.maxtemp = 16383;
+  ht.soft_pwm = soft_pwm;
+  ht.max_power = max_power;
+}
+
+/**
+ * Set the working range of a controller and
+ * move the raw limits of the ISR to match it
+ */
+static void heater_set_limits(const uint8_t tc, const int mintemp, const int maxtemp) {
+  heater_t &ht = heaters[tc];
+  ht.mintemp = mintemp;
+  ht.maxtemp = maxtemp;
+  if (ht.sensor == SENSOR_NONE) return;
+
+  const int step = ht.raw_rising ? OVERSAMPLENR : -OVERSAMPLENR;
+  while (analog2temp(ht.minttemp_raw, tc) < mintemp) ht.minttemp_raw += step;
+  while (analog2temp(ht.maxttemp_raw, tc) > maxtemp) ht.maxttemp_raw -= step;
+}
+
+#if HAS(THERMAL_PROTECTION)
+  static void heater_set_protection(const uint8_t tc, const uint8_t temp_hysteresis, const uint16_t tr_period, const uint8_t tr_hysteresis, const uint16_t watch_period, const uint8_t watch_increase) {
+    heater_t &ht = heaters[tc];
+    ht.protect = true;
+    ht.temp_hysteresis = temp_hysteresis;
+    ht.tr_period = tr_period;
+    ht.tr_hysteresis = tr_hysteresis;
+    ht.watch_period = watch_period;
+    ht.watch_increase = watch_increase;
+  }
+#endif
+
+/**
+ * Fill the controller table from the configuration
+ */
+static void heaters_init() {
+  heater_init(0, HEATER_0_SENSOR, &target_temperature[0], &current_temperature[0], &current_temperature_raw[0], HEATER_0_TEMPTABLE, HEATER_0_TEMPTABLE_LEN, HEATER_0_RAW_LO_TEMP, HEATER_0_RAW_HI_TEMP, &soft_pwm[0], HOTEND_MAX_POWER);
+  #if ENABLED(HEATER_0_MINTEMP) && ENABLED(HEATER_0_MAXTEMP)
+    heater_set_limits(0, HEATER_0_MINTEMP, HEATER_0_MAXTEMP);
+  #endif
+  #if HOTENDS > 1
+    heater_init(1, HEATER_1_SENSOR, &target_temperature[1], &current_temperature[1], &current_temperature_raw[1], HEATER_1_TEMPTABLE, HEATER_1_TEMPTABLE_LEN, HEATER_1_RAW_LO_TEMP, HEATER_1_RAW_HI_TEMP, &soft_pwm[1], HOTEND_MAX_POWER);
+    #if ENABLED(HEATER_1_MINTEMP) && ENABLED(HEATER_1_MAXTEMP)
+      heater_set_limits(1, HEATER_1_MINTEMP, HEATER_1_MAXTEMP);
+    #endif
+    #if HOTENDS > 2
+      heater_init(2, HEATER_2_SENSOR, &target_temperature[2], &current_temperature[2], &current_temperature_raw[2], HEATER_2_TEMPTABLE, HEATER_2_TEMPTABLE_LEN, HEATER_2_RAW_LO_TEMP, HEATER_2_RAW_HI_TEMP, &soft_pwm[2], HOTEND_MAX_POWER);
+      #if ENABLED(HEATER_2_MINTEMP) && ENABLED(HEATER_2_MAXTEMP)
+        heater_set_limits(2, HEATER_2_MINTEMP, HEATER_2_MAXTEMP);
+      #endif
+      #if HOTENDS > 3
+        heater_init(3, HEATER_3_SENSOR, &target_temperature[3], &current_temperature[3], &current_temperature_raw[3], HEATER_3_TEMPTABLE, HEATER_3_TEMPTABLE_LEN, HEATER_3_RAW_LO_TEMP, HEATER_3_RAW_HI_TEMP, &soft_pwm[3], HOTEND_MAX_POWER);
+        #if ENABLED(HEATER_3_MINTEMP) && ENABLED(HEATER_3_MAXTEMP)
+          heater_set_limits(3, HEATER_3_MINTEMP, HEATER_3_MAXTEMP);
+        #endif
+      #endif // HOTENDS > 3
+    #endif // HOTENDS > 2
+  #endif // HOTENDS > 1
+
+  heater_init(BED_INDEX, BED_SENSOR, &target_temperature_bed, &current_temperature_bed, &current_temperature_bed_raw, BEDTEMPTABLE, BEDTEMPTABLE_LEN, HEATER_BED_RAW_LO_TEMP, HEATER_BED_RAW_HI_TEMP, &soft_pwm_bed, MAX_BED_POWER);
+  #if ENABLED(BED_MINTEMP) && ENABLED(BED_MAXTEMP)
+    heater_set_limits(BED_INDEX, BED_MINTEMP, BED_MAXTEMP);
+  #endif
+
+  heater_init(CHAMBER_INDEX, CHAMBER_SENSOR, &target_temperature_chamber, &current_temperature_chamber, &current_temperature_chamber_raw, CHAMBERTEMPTABLE, CHAMBERTEMPTABLE_LEN, HEATER_CHAMBER_RAW_LO_TEMP, HEATER_CHAMBER_RAW_HI_TEMP, &soft_pwm_chamber, MAX_CHAMBER_POWER);
+  #if ENABLED(CHAMBER_MINTEMP) && ENABLED(CHAMBER_MAXTEMP)
+    heater_set_limits(CHAMBER_INDEX, CHAMBER_MINTEMP, CHAMBER_MAXTEMP);
+  #endif
+
+  heater_init(COOLER_INDEX, COOLER_SENSOR, &target_temperature_cooler, &current_temperature_cooler, &current_temperature_cooler_raw, COOLERTEMPTABLE, COOLERTEMPTABLE_LEN, COOLER_RAW_LO_TEMP, COOLER_RAW_HI_TEMP, &soft_pwm_cooler, MAX_COOLER_POWER);
+  heaters[COOLER_INDEX].cooling = true;
+  #if ENABLED(COOLER_MINTEMP) && ENABLED(COOLER_MAXTEMP)
+    heater_set_limits(COOLER_INDEX, COOLER_MINTEMP, COOLER_MAXTEMP);
+  #endif
+
+  // PID or bang-bang
+  #if ENABLED(PIDTEMP)
+    HOTEND_LOOP() {
+      heaters[h].pid = &hotend_pid[h];
+      #if ENABLED(PID_DEBUG)
+        heaters[h].pid_debug = true;
+      #endif
+    }
+  #endif
+
+  #if ENABLED(PIDTEMPBED)
+    heaters[BED_INDEX].pid = &bed_pid;
+    #if ENABLED(PID_BED_DEBUG)
+      heaters[BED_INDEX].pid_debug = true;
+    #endif
+  #else
+    heaters[BED_INDEX].check_interval = BED_CHECK_INTERVAL;
+    #if ENABLED(BED_LIMIT_SWITCHING)
+      heaters[BED_INDEX].bang_hysteresis = BED_HYSTERESIS;
+    #endif
+  #endif
+
+  #if ENABLED(PIDTEMPCHAMBER)
+    heaters[CHAMBER_INDEX].pid = &chamber_pid;
+    #if ENABLED(PID_CHAMBER_DEBUG)
+      heaters[CHAMBER_INDEX].pid_debug = true;
+    #endif
+  #else
+    heaters[CHAMBER_INDEX].check_interval = CHAMBER_CHECK_INTERVAL;
+    #if ENABLED(CHAMBER_LIMIT_SWITCHING)
+      heaters[CHAMBER_INDEX].bang_hysteresis = CHAMBER_HYSTERESIS;
+    #endif
+  #endif
+
+  #if ENABLED(PIDTEMPCOOLER)
+    heaters[COOLER_INDEX].pid = &cooler_pid;
+    #if ENABLED(PID_COOLER_DEBUG)
+      heaters[COOLER_INDEX].pid_debug = true;
+    #endif
+  #else
+    heaters[COOLER_INDEX].check_interval = COOLER_CHECK_INTERVAL;
+    #if ENABLED(COOLER_LIMIT_SWITCHING)
+      heaters[COOLER_INDEX].bang_hysteresis = COOLER_HYSTERESIS;
+    #endif
+  #endif
 
-  float analog2efficiency(float watt) {
-    return (analog2current() * POWER_VOLTAGE * 100) / watt;
-  }
-#endif
+  // Thermal protection
+  #if ENABLED(THERMAL_PROTECTION_HOTENDS)
+    HOTEND_LOOP() heater_set_protection(h, TEMP_HYSTERESIS, THERMAL_PROTECTION_PERIOD, THERMAL_PROTECTION_HYSTERESIS, WATCH_TEMP_PERIOD, WATCH_TEMP_INCREASE);
+  #endif
+  #if ENABLED(THERMAL_PROTECTION_BED)
+    heater_set_protection(BED_INDEX, TEMP_BED_HYSTERESIS, THERMAL_PROTECTION_BED_PERIOD, THERMAL_PROTECTION_BED_HYSTERESIS, WATCH_BED_TEMP_PERIOD, WATCH_BED_TEMP_INCREASE);
+  #endif
+  #if ENABLED(THERMAL_PROTECTION_CHAMBER)
+    heater_set_protection(CHAMBER_INDEX, TEMP_CHAMBER_HYSTERESIS, THERMAL_PROTECTION_CHAMBER_PERIOD, THERMAL_PROTECTION_CHAMBER_HYSTERESIS, WATCH_CHAMBER_TEMP_PERIOD, WATCH_CHAMBER_TEMP_INCREASE);
+  #endif
+  #if ENABLED(THERMAL_PROTECTION_COOLER)
+    heater_set_protection(COOLER_INDEX, TEMP_COOLER_HYSTERESIS, THERMAL_PROTECTION_COOLER_PERIOD, THERMAL_PROTECTION_COOLER_HYSTERESIS, WATCH_TEMP_COOLER_PERIOD, WATCH_TEMP_COOLER_DECREASE);
+  #endif
+}
 
 /**
  * Initialize the temperature manager
@@ -1415,34 +1771,8 @@ void tp_init() {
     MCUCR = _BV(JTD);
   #endif
 
-  // Finish init of mult hotends arrays
-  HOTEND_LOOP() {
-    // populate with the first value
-    maxttemp[h] = maxttemp[0];
-    #if ENABLED(PIDTEMP)
-      temp_iState_min[h] = 0.0;
-      temp_iState_max[h] = PID_INTEGRAL_DRIVE_MAX / PID_PARAM(Ki, h);
-    #endif //PIDTEMP
-  }
-
-  #if ENABLED(PIDTEMPBED)
-    temp_iState_min_bed = 0.0;
-    temp_iState_max_bed = PID_BED_INTEGRAL_DRIVE_MAX / bedKi;
-  #endif // PIDTEMPBED
-
-  #if ENABLED(PIDTEMPCHAMBER)
-    temp_iState_min_chamber = 0.0;
-    temp_iState_max_chamber = PID_CHAMBER_INTEGRAL_DRIVE_MAX / chamberKi;
-  #endif
-
-  #if ENABLED(PIDTEMPCOOLER)
-    temp_iState_min_cooler = 0.0;
-    temp_iState_max_cooler = PID_COOLER_INTEGRAL_DRIVE_MAX / coolerKi;
-  #endif
-
-  #if ENABLED(PID_ADD_EXTRUSION_RATE)
-    last_e_position = 0;
-  #endif
+  heaters_init();
+  updatePID();
 
   #if HAS(HEATER_0)
     SET_OUTPUT(HEATER_0_PIN);
@@ -1498,6 +1828,9 @@ void tp_init() {
 
   // Set analog inputs
   ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADIF) | 0x07;
+  #if ENABLED(ADC_INTERRUPT_SAMPLING)
+    SBI(ADCSRA, ADIE); // The first conversion completes before the first sweep and is ignored
+  #endif
   DIDR0 = 0;
   #ifdef DIDR2
     DIDR2 = 0;
@@ -1579,241 +1912,13 @@ void tp_init() {
 
   // Wait for temperature measurement to settle
   HAL::delayMilliseconds(250);
-
-  #define TEMP_MIN_ROUTINE(NR) \
-    minttemp[NR] = HEATER_ ## NR ## _MINTEMP; \
-    while(analog2temp(minttemp_raw[NR], NR) < HEATER_ ## NR ## _MINTEMP) { \
-      if (HEATER_ ## NR ## _RAW_LO_TEMP < HEATER_ ## NR ## _RAW_HI_TEMP) \
-        minttemp_raw[NR] += OVERSAMPLENR; \
-      else \
-        minttemp_raw[NR] -= OVERSAMPLENR; \
-    }
-  #define TEMP_MAX_ROUTINE(NR) \
-    maxttemp[NR] = HEATER_ ## NR ## _MAXTEMP; \
-    while(analog2temp(maxttemp_raw[NR], NR) > HEATER_ ## NR ## _MAXTEMP) { \
-      if (HEATER_ ## NR ## _RAW_LO_TEMP < HEATER_ ## NR ## _RAW_HI_TEMP) \
-        maxttemp_raw[NR] -= OVERSAMPLENR; \
-      else \
-        maxttemp_raw[NR] += OVERSAMPLENR; \
-    }
-
-  #if ENABLED(HEATER_0_MINTEMP)
-    TEMP_MIN_ROUTINE(0);
-  #endif
-  #if ENABLED(HEATER_0_MAXTEMP)
-    TEMP_MAX_ROUTINE(0);
-  #endif
-  #if HOTENDS > 1
-    #if ENABLED(HEATER_1_MINTEMP)
-      TEMP_MIN_ROUTINE(1);
-    #endif
-    #if ENABLED(HEATER_1_MAXTEMP)
-      TEMP_MAX_ROUTINE(1);
-    #endif
-    #if HOTENDS > 2
-      #if ENABLED(HEATER_2_MINTEMP)
-        TEMP_MIN_ROUTINE(2);
-      #endif
-      #if ENABLED(HEATER_2_MAXTEMP)
-        TEMP_MAX_ROUTINE(2);
-      #endif
-      #if HOTENDS > 3
-        #if ENABLED(HEATER_3_MINTEMP)
-          TEMP_MIN_ROUTINE(3);
-        #endif
-        #if ENABLED(HEATER_3_MAXTEMP)
-          TEMP_MAX_ROUTINE(3);
-        #endif
-      #endif // HOTENDS > 3
-    #endif // HOTENDS > 2
-  #endif // HOTENDS > 1
-
-  #if ENABLED(BED_MINTEMP)
-    while(analog2tempBed(bed_minttemp_raw) < BED_MINTEMP) {
-      #if HEATER_BED_RAW_LO_TEMP < HEATER_BED_RAW_HI_TEMP
-        bed_minttemp_raw += OVERSAMPLENR;
-      #else
-        bed_minttemp_raw -= OVERSAMPLENR;
-      #endif
-    }
-  #endif //BED_MINTEMP
-  #if ENABLED(BED_MAXTEMP)
-    while(analog2tempBed(bed_maxttemp_raw) > BED_MAXTEMP) {
-      #if HEATER_BED_RAW_LO_TEMP < HEATER_BED_RAW_HI_TEMP
-        bed_maxttemp_raw -= OVERSAMPLENR;
-      #else
-        bed_maxttemp_raw += OVERSAMPLENR;
-      #endif
-    }
-  #endif // BED_MAXTEMP
-
-  #if ENABLED(CHAMBER_MINTEMP)
-    while(analog2tempChamber(chamber_minttemp_raw) < CHAMBER_MINTEMP) {
-      #if CHAMBER_RAW_LO_TEMP < HEATER_CHAMBER_RAW_HI_TEMP
-        chamber_minttemp_raw += OVERSAMPLENR;
-      #else
-        chamber_minttemp_raw -= OVERSAMPLENR;
-      #endif
-    }
-  #endif // CHAMBER_MINTEMP
-  #if ENABLED(CHAMBER_MAXTEMP)
-    while(analog2tempCooler(chamber_maxttemp_raw) > CHAMBER_MAXTEMP) {
-      #if CHAMBER_RAW_LO_TEMP < CHAMBER_RAW_HI_TEMP
-        chamber_maxttemp_raw -= OVERSAMPLENR;
-      #else
-        chamber_maxttemp_raw += OVERSAMPLENR;
-      #endif
-    }
-  #endif // BED_MAXTEMP
-
-  #if ENABLED(COOLER_MINTEMP)
-    while(analog2tempCooler(cooler_minttemp_raw) < COOLER_MINTEMP) {
-      #if COOLER_RAW_LO_TEMP < HEATER_COOLER_RAW_HI_TEMP
-        cooler_minttemp_raw += OVERSAMPLENR;
-      #else
-        cooler_minttemp_raw -= OVERSAMPLENR;
-      #endif
-    }
-  #endif // COOLER_MINTEMP
-  #if ENABLED(COOLER_MAXTEMP)
-    while(analog2tempCooler(cooler_maxttemp_raw) > COOLER_MAXTEMP) {
-      #if COOLER_RAW_LO_TEMP < COOLER_RAW_HI_TEMP
-        cooler_maxttemp_raw -= OVERSAMPLENR;
-      #else
-        cooler_maxttemp_raw += OVERSAMPLENR;
-      #endif
-    }
-  #endif // COOLER_MAXTEMP
 }
 
-#if ENABLED(THERMAL_PROTECTION_HOTENDS)
-  /**
-   * Start Heating Sanity Check for hotends that are below
-   * their target temperature by a configurable margin.
-   * This is called when the temperature is set. (M104, M109)
-   */
-  void start_watching_heater(int e) {
-    if (degHotend(e) < degTargetHotend(e) - (WATCH_TEMP_INCREASE + TEMP_HYSTERESIS + 1)) {
-      watch_target_temp[e] = degHotend(e) + WATCH_TEMP_INCREASE;
-      watch_heater_next_ms[e] = millis() + WATCH_TEMP_PERIOD * 1000UL;
-    }
-    else
-      watch_heater_next_ms[e] = 0;
-  }
-#endif
-
-#if ENABLED(THERMAL_PROTECTION_BED)
-  /**
-   * Start Heating Sanity Check for bed that are below
-   * their target temperature by a configurable margin.
-   * This is called when the temperature is set. (M140, M190)
-   */
-  void start_watching_bed() {
-    if (degBed() < degTargetBed() - (WATCH_BED_TEMP_INCREASE + TEMP_BED_HYSTERESIS + 1)) {
-      watch_target_bed_temp = degBed() + WATCH_BED_TEMP_INCREASE;
-      watch_bed_next_ms = millis() + (WATCH_BED_TEMP_PERIOD) * 1000UL;
-    }
-    else
-      watch_bed_next_ms = 0;
-  }
-#endif
-
-#if ENABLED(THERMAL_PROTECTION_CHAMBER)
-  /**
-   * Start Cooling Sanity Check for chamber that are below
-   * their target temperature by a configurable margin.
-   * This is called when the temperature is set. (M141)
-   */
-  void start_watching_chamber() {
-    if (degCooler() > degTargetCooler() - (WATCH_TEMP_CHAMBER_DECREASE - TEMP_CHAMBER_HYSTERESIS - 1)) {
-      watch_target_temp_chamber = degChamber() - WATCH_CHAMBER_TEMP_DECREASE;
-      watch_chamber_next_ms = millis() + WATCH_TEMP_CHAMBER_PERIOD * 1000UL;
-    }
-    else
-      watch_chamber_next_ms = 0;
-  }
-#endif
-
-#if ENABLED(THERMAL_PROTECTION_COOLER)
-  /**
-   * Start Cooling Sanity Check for hotends that are below
-   * their target temperature by a configurable margin.
-   * This is called when the temperature is set. (M142)
-   */
-  void start_watching_cooler() {
-    if (degCooler() > degTargetCooler() - (WATCH_TEMP_COOLER_DECREASE - TEMP_COOLER_HYSTERESIS - 1)) {
-      watch_target_temp_cooler = degCooler() - WATCH_COOLER_TEMP_DECREASE;
-      watch_cooler_next_ms = millis() + WATCH_TEMP_COOLER_PERIOD * 1000UL;
-    }
-    else
-      watch_cooler_next_ms = 0;
-  }
-#endif
-
-#if ENABLED(THERMAL_PROTECTION_HOTENDS) || ENABLED(THERMAL_PROTECTION_BED) || ENABLED(THERMAL_PROTECTION_CHAMBER) || ENABLED(THERMAL_PROTECTION_COOLER)
-  void thermal_runaway_protection(TRState* state, millis_t* timer, float temperature, float target_temperature, int temp_controller_id, int period_seconds, int hysteresis_degc) {
-
-    static float tr_target_temperature[HOTENDS + 3] = { 0.0 };
-
-    /*
-        ECHO_SM(DB, "Thermal Thermal Runaway Running. Heater ID: ");
-        if (heater_id < 0) ECHO_M("bed"); else ECHO_V(heater_id);
-        ECHO_MV(" ;  State:", *state);
-        ECHO_MV(" ;  Timer:", *timer);
-        ECHO_MV(" ;  Temperature:", temperature);
-        ECHO_EMV(" ;  Target Temp:", target_temperature);
-    */
-    int temp_controller_index;
-
-    if(temp_controller_id >= 0)
-      temp_controller_index = temp_controller_id;
-    else if(temp_controller_id == -1)
-      temp_controller_index = HOTENDS; // BED
-    else if(temp_controller_id == -2)
-      temp_controller_index = HOTENDS + 1; // CHAMBER
-    else
-      temp_controller_index = HOTENDS + 2; // COOLER
-
-    // If the target temperature changes, restart
-    if (tr_target_temperature[temp_controller_index] != target_temperature)
-      tr_target_temperature[temp_controller_index] = target_temperature;
-
-    *state = target_temperature > 0 ? TRFirstRunning : TRInactive;
-
-    switch (*state) {
-      // Inactive state waits for a target temperature to be set
-      case TRInactive: break;
-      // When first heating/cooling, wait for the temperature to be reached then go to Stable state
-      case TRFirstRunning:
-        if (temperature < tr_target_temperature[temp_controller_index] && temp_controller_index > HOTENDS) break;
-        else if ((temperature > tr_target_temperature[temp_controller_index] && temp_controller_index <= HOTENDS)) break;
-        *state = TRStable;
-      // While the temperature is stable watch for a bad temperature
-      case TRStable:
-        if (temp_controller_index <= HOTENDS) { // HOTENDS
-          if (temperature < tr_target_temperature[temp_controller_index] - hysteresis_degc && ELAPSED(millis(), *timer))
-            *state = TRRunaway;
-          else {
-            *timer = millis() + period_seconds * 1000UL;
-            break;
-          }
-        }
-        else { // COOLERS
-          if (temperature > tr_target_temperature[temp_controller_index] + hysteresis_degc && ELAPSED(millis(), *timer))
-            *state = TRRunaway;
-          else {
-            *timer = millis() + period_seconds * 1000UL;
-            break;
-          }
-        }
-      case TRRunaway:
-        _temp_error(temp_controller_id, PSTR(SERIAL_T_THERMAL_RUNAWAY), PSTR(MSG_THERMAL_RUNAWAY));
-    }
-  }
-#endif // THERMAL_PROTECTION_HOTENDS || THERMAL_PROTECTION_BED || THERMAL_PROTECTION_CHAMBER || THERMAL_PROTECTION_COOLER
-
 void disable_all_heaters() {
   HOTEND_LOOP() setTargetHotend(0, h);
+  #if ENABLED(TOOL_CHANGE_PREHEAT)
+    toolchange_preheat_reset(); // No hotend to bring back from standby
+  #endif
   setTargetBed(0);
   setTargetChamber(0);
 
@@ -1944,6 +2049,16 @@ static unsigned long raw_temp_value[4] = { 0 };
 static unsigned long raw_temp_bed_value = 0;
 static unsigned long raw_temp_chamber_value = 0;
 static unsigned long raw_temp_cooler_value = 0;
+#if HAS(FILAMENT_SENSOR)
+  static unsigned long raw_filwidth_value = 0;
+#endif
+
+#define SET_ADMUX_ADCSRA(pin) ADMUX = _BV(REFS0) | (pin & 0x07); SBI(ADCSRA, ADSC)
+#ifdef MUX5
+  #define START_ADC(pin) if (pin > 7) ADCSRB = _BV(MUX5); else ADCSRB = 0; SET_ADMUX_ADCSRA(pin)
+#else
+  #define START_ADC(pin) ADCSRB = 0; SET_ADMUX_ADCSRA(pin)
+#endif
 
 static void set_current_temp_raw() {
   #if HAS(TEMP_0) && DISABLED(HEATER_0_USES_MAX6675)
@@ -1972,6 +2087,175 @@ static void set_current_temp_raw() {
   temp_meas_ready = true;
 }
 
+/**
+ * Close an OVERSAMPLENR round: hand the sums over and clear them
+ */
+static void end_temp_round() {
+  // Update the raw values if they've been read. Else we could be updating them during reading.
+  if (!temp_meas_ready) set_current_temp_raw();
+
+  // Filament Sensor - can be read any time since IIR filtering is used
+  #if HAS(FILAMENT_SENSOR)
+    current_raw_filwidth = raw_filwidth_value >> 10;  // Divide to get to 0-16384 range since we used 1/128 IIR filter approach
+  #endif
+
+  for (int i = 0; i < 4; i++) raw_temp_value[i] = 0;
+  raw_temp_bed_value = 0;
+  raw_temp_chamber_value = 0;
+  raw_temp_cooler_value = 0;
+
+  #if HAS(POWER_CONSUMPTION_SENSOR)
+    raw_powconsumption_value = 0;
+  #endif
+}
+
+#if ENABLED(ADC_INTERRUPT_SAMPLING)
+
+  // Sensors converted by each sweep, in order
+  enum ADCSensor {
+    ADC_TEMP_0, ADC_TEMP_BED, ADC_TEMP_CHAMBER, ADC_TEMP_COOLER,
+    ADC_TEMP_1, ADC_TEMP_2, ADC_TEMP_3, ADC_FILWIDTH, ADC_POWCONSUMPTION
+  };
+
+  static const uint8_t adc_sensor_id[] PROGMEM = {
+    #if HAS(TEMP_0) && DISABLED(HEATER_0_USES_MAX6675)
+      ADC_TEMP_0,
+    #endif
+    #if HAS(TEMP_BED)
+      ADC_TEMP_BED,
+    #endif
+    #if HAS(TEMP_CHAMBER)
+      ADC_TEMP_CHAMBER,
+    #endif
+    #if HAS(TEMP_COOLER)
+      ADC_TEMP_COOLER,
+    #endif
+    #if HAS(TEMP_1)
+      ADC_TEMP_1,
+    #endif
+    #if HAS(TEMP_2)
+      ADC_TEMP_2,
+    #endif
+    #if HAS(TEMP_3)
+      ADC_TEMP_3,
+    #endif
+    #if HAS(FILAMENT_SENSOR)
+      ADC_FILWIDTH,
+    #endif
+    #if HAS(POWER_CONSUMPTION_SENSOR)
+      ADC_POWCONSUMPTION,
+    #endif
+  };
+
+  #define ADC_SENSORS COUNT(adc_sensor_id)
+
+  static volatile bool adc_sweep_busy = false,
+                       adc_round_done = false;
+  static uint8_t adc_sweep_ticks = 0,
+                 adc_sensor = 0,
+                 adc_sweep_count = 0;
+
+  static void start_adc_conversion(const uint8_t id) {
+    switch (id) {
+      #if HAS(TEMP_0) && DISABLED(HEATER_0_USES_MAX6675)
+        case ADC_TEMP_0: START_ADC(TEMP_0_PIN); break;
+      #endif
+      #if HAS(TEMP_BED)
+        case ADC_TEMP_BED: START_ADC(TEMP_BED_PIN); break;
+      #endif
+      #if HAS(TEMP_CHAMBER)
+        case ADC_TEMP_CHAMBER: START_ADC(TEMP_CHAMBER_PIN); break;
+      #endif
+      #if HAS(TEMP_COOLER)
+        case ADC_TEMP_COOLER: START_ADC(TEMP_COOLER_PIN); break;
+      #endif
+      #if HAS(TEMP_1)
+        case ADC_TEMP_1: START_ADC(TEMP_1_PIN); break;
+      #endif
+      #if HAS(TEMP_2)
+        case ADC_TEMP_2: START_ADC(TEMP_2_PIN); break;
+      #endif
+      #if HAS(TEMP_3)
+        case ADC_TEMP_3: START_ADC(TEMP_3_PIN); break;
+      #endif
+      #if HAS(FILAMENT_SENSOR)
+        case ADC_FILWIDTH: START_ADC(FILWIDTH_PIN); break;
+      #endif
+      #if HAS(POWER_CONSUMPTION_SENSOR)
+        case ADC_POWCONSUMPTION: START_ADC(POWER_CONSUMPTION_PIN); break;
+      #endif
+    }
+  }
+
+  // Called by the timer ISR every ADC_SWEEP_TICKS
+  static void start_adc_sweep() {
+    if (ADC_SENSORS == 0) return;
+    adc_sweep_busy = true;
+    adc_sensor = 0;
+    start_adc_conversion(pgm_read_byte(&adc_sensor_id[0]));
+  }
+
+  /**
+   * ADC conversion complete
+   *  - Accumulate the reading of the current sensor
+   *  - Start the conversion of the next sensor in the sweep
+   *  - Close the round after OVERSAMPLENR sweeps
+   */
+  ISR(ADC_vect) {
+    if (!adc_sweep_busy) return; // Conversion started by temperature init
+
+    const uint16_t value = ADC;
+    switch (pgm_read_byte(&adc_sensor_id[adc_sensor])) {
+      #if HAS(TEMP_0) && DISABLED(HEATER_0_USES_MAX6675)
+        case ADC_TEMP_0: raw_temp_value[0] += value; break;
+      #endif
+      #if HAS(TEMP_BED)
+        case ADC_TEMP_BED: raw_temp_bed_value += value; break;
+      #endif
+      #if HAS(TEMP_CHAMBER)
+        case ADC_TEMP_CHAMBER: raw_temp_chamber_value += value; break;
+      #endif
+      #if HAS(TEMP_COOLER)
+        case ADC_TEMP_COOLER: raw_temp_cooler_value += value; break;
+      #endif
+      #if HAS(TEMP_1)
+        case ADC_TEMP_1: raw_temp_value[1] += value; break;
+      #endif
+      #if HAS(TEMP_2)
+        case ADC_TEMP_2: raw_temp_value[2] += value; break;
+      #endif
+      #if HAS(TEMP_3)
+        case ADC_TEMP_3: raw_temp_value[3] += value; break;
+      #endif
+      #if HAS(FILAMENT_SENSOR)
+        case ADC_FILWIDTH:
+          if (value > 102) { //check that ADC is reading a voltage > 0.5 volts, otherwise don't take in the data.
+            raw_filwidth_value -= (raw_filwidth_value >> 7); //multiply raw_filwidth_value by 127/128
+            raw_filwidth_value += ((unsigned long)value << 7); //add new ADC reading
+          }
+          break;
+      #endif
+      #if HAS(POWER_CONSUMPTION_SENSOR)
+        case ADC_POWCONSUMPTION: raw_powconsumption_value += value; break;
+      #endif
+    }
+
+    if (++adc_sensor < ADC_SENSORS) {
+      start_adc_conversion(pgm_read_byte(&adc_sensor_id[adc_sensor]));
+      return;
+    }
+
+    // Sweep done, the timer ISR starts the next one
+    adc_sweep_busy = false;
+    if (++adc_sweep_count >= OVERSAMPLENR) {
+      adc_sweep_count = 0;
+      end_temp_round();
+      adc_round_done = true; // MIN/MAX checks in the timer ISR
+    }
+  }
+
+#endif // ADC_INTERRUPT_SAMPLING
+
 /**
  * Timer 0 is shared with millies
  *  - Manage PWM to all the heaters, coolers and fan
@@ -1981,8 +2265,10 @@ static void set_current_temp_raw() {
  */
 ISR(TIMER0_COMPB_vect) {
 
-  static unsigned char temp_count = 0;
-  static TempState temp_state = StartupDelay;
+  #if DISABLED(ADC_INTERRUPT_SAMPLING)
+    static unsigned char temp_count = 0;
+    static TempState temp_state = StartupDelay;
+  #endif
   static unsigned char pwm_count = _BV(SOFT_PWM_SCALE);
 
   // Static members for each heater
@@ -2017,10 +2303,6 @@ ISR(TIMER0_COMPB_vect) {
     ISR_STATICS(COOLER);
   #endif
 
-  #if HAS(FILAMENT_SENSOR)
-    static unsigned long raw_filwidth_value = 0;
-  #endif
-
   #if DISABLED(SLOW_PWM_HEATERS)
     /**
      * standard PWM modulation
@@ -2304,12 +2586,17 @@ ISR(TIMER0_COMPB_vect) {
 
   #endif // SLOW_PWM_HEATERS
 
-  #define SET_ADMUX_ADCSRA(pin) ADMUX = _BV(REFS0) | (pin & 0x07); SBI(ADCSRA, ADSC)
-  #ifdef MUX5
-    #define START_ADC(pin) if (pin > 7) ADCSRB = _BV(MUX5); else ADCSRB = 0; SET_ADMUX_ADCSRA(pin)
-  #else
-    #define START_ADC(pin) ADCSRB = 0; SET_ADMUX_ADCSRA(pin)
-  #endif
+  #if ENABLED(ADC_INTERRUPT_SAMPLING)
+
+    lcd_buttons_update();
+
+    // Start a sweep of all the sensors, the ADC ISR does the rest
+    if (++adc_sweep_ticks >= ADC_SWEEP_TICKS && !adc_sweep_busy) {
+      adc_sweep_ticks = 0;
+      start_adc_sweep();
+    }
+
+  #else // !ADC_INTERRUPT_SAMPLING
 
   // Prepare or measure a sensor, each one every 14th frame
   switch (temp_state) {
@@ -2453,94 +2740,25 @@ ISR(TIMER0_COMPB_vect) {
     //  break;
   } // switch(temp_state)
 
-  if (temp_count >= OVERSAMPLENR) { // 14 * 16 * 1/(16000000/64/256)
-    // Update the raw values if they've been read. Else we could be updating them during reading.
-    if (!temp_meas_ready) set_current_temp_raw();
-
-    // Filament Sensor - can be read any time since IIR filtering is used
-    #if HAS(FILAMENT_SENSOR)
-      current_raw_filwidth = raw_filwidth_value >> 10;  // Divide to get to 0-16384 range since we used 1/128 IIR filter approach
-    #endif
-
-    temp_count = 0;
-    for (int i = 0; i < 4; i++) raw_temp_value[i] = 0;
-    raw_temp_bed_value = 0;
-    raw_temp_chamber_value = 0;
-    raw_temp_cooler_value = 0;
-
-    #if HAS(POWER_CONSUMPTION_SENSOR)
-      raw_powconsumption_value = 0;
-    #endif
-
-    #if HAS(TEMP_0) && DISABLED(HEATER_0_USES_MAX6675)
-      #if HEATER_0_RAW_LO_TEMP > HEATER_0_RAW_HI_TEMP
-        #define GE0 <=
-      #else
-        #define GE0 >=
-      #endif
-      if (current_temperature_raw[0] GE0 maxttemp_raw[0]) max_temp_error(0);
-      if (minttemp_raw[0] GE0 current_temperature_raw[0]) min_temp_error(0);
-    #endif
-
-    #if HAS(TEMP_1) && HOTENDS > 1
-      #if HEATER_1_RAW_LO_TEMP > HEATER_1_RAW_HI_TEMP
-        #define GE1 <=
-      #else
-        #define GE1 >=
-      #endif
-      if (current_temperature_raw[1] GE1 maxttemp_raw[1]) max_temp_error(1);
-      if (minttemp_raw[1] GE1 current_temperature_raw[1]) min_temp_error(1);
-    #endif // TEMP_SENSOR_1
-
-    #if HAS(TEMP_2) && HOTENDS > 2
-      #if HEATER_2_RAW_LO_TEMP > HEATER_2_RAW_HI_TEMP
-        #define GE2 <=
-      #else
-        #define GE2 >=
-      #endif
-      if (current_temperature_raw[2] GE2 maxttemp_raw[2]) max_temp_error(2);
-      if (minttemp_raw[2] GE2 current_temperature_raw[2]) min_temp_error(2);
-    #endif // TEMP_SENSOR_2
-
-    #if HAS(TEMP_3) && HOTENDS > 3
-      #if HEATER_3_RAW_LO_TEMP > HEATER_3_RAW_HI_TEMP
-        #define GE3 <=
-      #else
-        #define GE3 >=
-      #endif
-      if (current_temperature_raw[3] GE3 maxttemp_raw[3]) max_temp_error(3);
-      if (minttemp_raw[3] GE3 current_temperature_raw[3]) min_temp_error(3);
-    #endif // TEMP_SENSOR_3
-
-    #if HAS(TEMP_BED)
-      #if HEATER_BED_RAW_LO_TEMP > HEATER_BED_RAW_HI_TEMP
-        #define GEBED <=
-      #else
-        #define GEBED >=
-      #endif
-      if (current_temperature_bed_raw GEBED bed_maxttemp_raw) _temp_error(-1, SERIAL_T_MAXTEMP, PSTR(MSG_ERR_MAXTEMP_BED));
-      if (bed_minttemp_raw GEBED current_temperature_bed_raw) _temp_error(-1, SERIAL_T_MINTEMP, PSTR(MSG_ERR_MINTEMP_BED));
-    #endif
-
-    #if HAS(TEMP_CHAMBER)
-      #if HEATER_CHAMBER_RAW_LO_TEMP > HEATER_CHAMBER_RAW_HI_TEMP
-        #define GECHAMBER <=
-      #else
-        #define GECHAMBER >=
-      #endif
-      if (current_temperature_chamber_raw GECHAMBER chamber_maxttemp_raw) _temp_error(-2, SERIAL_T_MAXTEMP, PSTR(MSG_ERR_MAXTEMP_CHAMBER));
-      if (chamber_minttemp_raw GECHAMBER current_temperature_chamber_raw) _temp_error(-2, SERIAL_T_MINTEMP, PSTR(MSG_ERR_MINTEMP_CHAMBER));
-    #endif
+  #endif // !ADC_INTERRUPT_SAMPLING
 
-    #if HAS(TEMP_COOLER)
-      #if COOLER_RAW_LO_TEMP > COOLER_RAW_HI_TEMP
-        #define GECOOLER <=
-      #else
-        #define GECOOLER >=
-      #endif
-      if (current_temperature_cooler_raw GECOOLER cooler_maxttemp_raw) _temp_error(-3, SERIAL_T_MAXTEMP, PSTR(MSG_ERR_MAXTEMP_COOLER));
-      if (cooler_minttemp_raw GECOOLER current_temperature_cooler_raw) _temp_error(-3, SERIAL_T_MINTEMP, PSTR(MSG_ERR_MINTEMP_COOLER));
-    #endif
+  #if ENABLED(ADC_INTERRUPT_SAMPLING)
+    if (adc_round_done) { // ADC_SWEEP_TICKS * 16 * 1/(16000000/64/256)
+      adc_round_done = false;
+  #else
+    if (temp_count >= OVERSAMPLENR) { // 14 * 16 * 1/(16000000/64/256)
+      temp_count = 0;
+      end_temp_round();
+  #endif
+
+    // MIN/MAX checks on the raw values
+    for (uint8_t tc = 0; tc < HEATER_COUNT; tc++) {
+      const heater_t &ht = heaters[tc];
+      if (ht.sensor != SENSOR_THERMISTOR && ht.sensor != SENSOR_AD595) continue;
+      const int raw = *ht.raw;
+      if (ht.raw_rising ? raw >= ht.maxttemp_raw : raw <= ht.maxttemp_raw) max_temp_error(tc);
+      if (ht.raw_rising ? raw <= ht.minttemp_raw : raw >= ht.minttemp_raw) min_temp_error(tc);
+    }
 
   } // temp_count >= OVERSAMPLENR
 
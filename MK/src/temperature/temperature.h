@@ -106,6 +106,18 @@ extern float current_temperature_cooler;
   #define PID_PARAM(param, h) param[h] // use macro to point to array value
 #endif
 
+#if ENABLED(MPCTEMP)
+  typedef struct {
+    float heater_power,                 // W
+          block_heat_capacity,          // J/K
+          sensor_responsiveness,        // K/s per K
+          ambient_xfer_coeff_fan0,      // W/K
+          fan255_adjustment,            // W/K, added with the fan at 255
+          filament_heat_capacity_permm; // J/K/mm
+  } mpc_settings_t;
+  extern mpc_settings_t mpc_settings[HOTENDS];
+#endif
+
 #if ENABLED(PIDTEMPBED)
   extern float bedKp, bedKi, bedKd;
 #endif
@@ -281,10 +293,14 @@ void disable_all_heaters();
 void disable_all_coolers();
 void updatePID();
 
-#if HAS(PID_HEATING) || HAS(PID_COOLING)
+#if ENABLED(PIDTEMP) || ENABLED(PIDTEMPBED) || ENABLED(PIDTEMPCHAMBER) || ENABLED(PIDTEMPCOOLER)
   void PID_autotune(float temp, int temp_controller, int ncycles, bool set_result = false);
 #endif
 
+#if ENABLED(MPCTEMP)
+  void MPC_autotune(const uint8_t h);
+#endif
+
 void checkExtruderAutoFans();
 extern void autotempShutdown();
 
@@ -1248,6 +1248,9 @@
 #else
   #ifdef BED_USES_THERMISTOR
     #error No bed thermistor table specified
+  #else  // BED_USES_THERMISTOR
+    #define BEDTEMPTABLE NULL
+    #define BEDTEMPTABLE_LEN 0
   #endif // BED_USES_THERMISTOR
 #endif
 
@@ -1268,6 +1271,9 @@
 #else
   #ifdef CHAMBER_USES_THERMISTOR
     #error No chamber thermistor table specified
+  #else  // CHAMBER_USES_THERMISTOR
+    #define CHAMBERTEMPTABLE NULL
+    #define CHAMBERTEMPTABLE_LEN 0
   #endif // CHAMBER_USES_THERMISTOR
 #endif
 
@@ -1287,6 +1293,9 @@
 #else
   #ifdef COOLER_USES_THERMISTOR
     #error No Cooler thermistor table specified
+  #else  // COOLER_USES_THERMISTOR
+    #define COOLERTEMPTABLE NULL
+    #define COOLERTEMPTABLE_LEN 0
   #endif // COOLER_USES_THERMISTOR
 #endif
 